@@ -0,0 +1,177 @@
+// AutoFileSyncBuffers.cpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <new>
+#include <cstdlib>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#include "AutoFileSyncBuffers.hpp"
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Page and huge page sizes (buffers are aligned to them)
+	constexpr size_t _afsync_buffer_page = 4096;
+	constexpr size_t _afsync_buffer_hugepage = 2 * 1024 * 1024;
+
+	// Constructor
+	AutoFileSyncBufferPool::AutoFileSyncBufferPool(size_t maxsize, size_t minsize, bool hugepages) noexcept
+	{
+		this->_minsize = minsize < _afsync_buffer_page ? _afsync_buffer_page : minsize;
+		this->_maxsize = maxsize < this->_minsize ? this->_minsize : maxsize;
+		this->_hugepages = hugepages;
+	}
+
+	// Destructor (releases the buffers given back, borrowed ones must be given back before)
+	AutoFileSyncBufferPool::~AutoFileSyncBufferPool() noexcept
+	{
+		for (AutoFileSyncBuffer& buffer : this->_free)
+		{
+			this->_release(buffer);
+		}
+		this->_free.clear();
+	}
+
+	// Borrow a buffer fit for reading a file of sizehint bytes, data is nullptr if out of memory
+	AutoFileSyncBuffer AutoFileSyncBufferPool::borrow(unsigned long long sizehint) noexcept
+	{
+		size_t size = this->fitsize(sizehint);
+		AutoFileSyncBuffer buffer;
+
+		// Take the smallest free buffer that is large enough, or else the largest one to regrow
+		this->_mutex.lock();
+		if (this->_free.empty() == false)
+		{
+			size_t pick = 0;
+			for (size_t i = 1; i < this->_free.size(); ++i)
+			{
+				bool fits = this->_free[i].size >= size;
+				bool pickfits = this->_free[pick].size >= size;
+				if ((fits == true && (pickfits == false || this->_free[i].size < this->_free[pick].size)) ||
+					(fits == false && pickfits == false && this->_free[i].size > this->_free[pick].size))
+				{
+					pick = i;
+				}
+			}
+			buffer = this->_free[pick];
+			this->_free[pick] = this->_free.back();
+			this->_free.pop_back();
+		}
+		this->_mutex.unlock();
+
+		// Regrow (the old contents are not kept)
+		if (buffer.data != nullptr && buffer.size < size)
+		{
+			this->_release(buffer);
+		}
+		if (buffer.data == nullptr)
+		{
+			this->_allocate(buffer, size);
+		}
+		return buffer;
+	}
+
+	// Give back a borrowed buffer
+	void AutoFileSyncBufferPool::giveback(AutoFileSyncBuffer& buffer) noexcept
+	{
+		if (buffer.data == nullptr)
+		{
+			return;
+		}
+		this->_mutex.lock();
+		this->_free.push_back(buffer);
+		this->_mutex.unlock();
+		buffer = AutoFileSyncBuffer();
+	}
+
+	// Buffer size fit for reading a file of sizehint bytes
+	size_t AutoFileSyncBufferPool::fitsize(unsigned long long sizehint) const noexcept
+	{
+		if (sizehint >= this->_maxsize)
+		{
+			return this->_maxsize;
+		}
+		size_t size = this->_minsize;
+		while (size < sizehint && size < this->_maxsize)
+		{
+			size <<= 1;
+		}
+		return size < this->_maxsize ? size : this->_maxsize;
+	}
+
+	// Largest buffer size
+	size_t AutoFileSyncBufferPool::maxsize() const noexcept
+	{
+		return this->_maxsize;
+	}
+
+	// Allocate the memory of a buffer
+	bool AutoFileSyncBufferPool::_allocate(AutoFileSyncBuffer& buffer, size_t size) noexcept
+	{
+		buffer = AutoFileSyncBuffer();
+		bool huge = this->_hugepages == true && size >= _afsync_buffer_hugepage;
+
+#if defined(_WIN32)
+		// Large pages need SeLockMemoryPrivilege, so fall back to normal pages silently
+		size_t largepage = huge == true ? GetLargePageMinimum() : 0;
+		if (largepage != 0 && size % largepage == 0)
+		{
+			buffer.data = (unsigned char*)VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+			buffer.huge = buffer.data != nullptr;
+		}
+		if (buffer.data == nullptr)
+		{
+			buffer.data = (unsigned char*)VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+		}
+#elif defined(__linux__)
+		// Transparent huge pages need the memory aligned to them
+		void* data = nullptr;
+		if (posix_memalign(&data, huge == true ? _afsync_buffer_hugepage : _afsync_buffer_page, size) != 0)
+		{
+			data = nullptr;
+		}
+		if (data != nullptr && huge == true)
+		{
+			buffer.huge = madvise(data, size, MADV_HUGEPAGE) == 0;
+		}
+		buffer.data = (unsigned char*)data;
+#else
+		buffer.data = (unsigned char*)::operator new(size, std::align_val_t(_afsync_buffer_page), std::nothrow);
+#endif
+
+		if (buffer.data == nullptr)
+		{
+			buffer.huge = false;
+			return false;
+		}
+		buffer.size = size;
+		return true;
+	}
+
+	// Release the memory of a buffer
+	void AutoFileSyncBufferPool::_release(AutoFileSyncBuffer& buffer) noexcept
+	{
+		if (buffer.data != nullptr)
+		{
+#if defined(_WIN32)
+			VirtualFree(buffer.data, 0, MEM_RELEASE);
+#elif defined(__linux__)
+			free(buffer.data);
+#else
+			::operator delete(buffer.data, std::align_val_t(_afsync_buffer_page));
+#endif
+		}
+		buffer = AutoFileSyncBuffer();
+	}
+
+}
+// Namespace AutoFileSync ends
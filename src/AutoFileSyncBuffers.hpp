@@ -0,0 +1,91 @@
+// AutoFileSyncBuffers.hpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <mutex>
+#include <vector>
+#include <cstddef>
+
+#pragma once
+
+#pragma warning (disable: 4018)
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4251)
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4661)
+#pragma warning (disable: 4715)
+#pragma warning (disable: 4804)
+#pragma warning (disable: 4819)
+#pragma warning (disable: 4919)
+#pragma warning (disable: 4996)
+#pragma warning (disable: 6031)
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// struct AutoFileSyncBuffer
+	// A page-aligned I/O buffer borrowed from a pool (contents are undefined)
+	struct AutoFileSyncBuffer
+	{
+		unsigned char* data = nullptr;
+		size_t size = 0;
+		bool huge = false;   // aligned to and advised as huge pages
+	};
+
+	// class AutoFileSyncBufferPool
+	// Reusable I/O buffers shared by the workers of a threadpool
+	// 
+	// Every worker borrows one buffer per read in flight and gives it back when done,
+	// so the pool holds at most (readahead depth) buffers per worker and no read path
+	// allocates per file.
+	// Buffers are sized to the file (a power of two between the minimum and the
+	// maximum) and only regrown when a larger file comes; buffers of 2 MiB or more
+	// are huge page backed where the system allows it.
+	class AutoFileSyncBufferPool
+	{
+	private:
+		// Minimum and maximum buffer sizes
+		size_t _minsize = 0;
+		size_t _maxsize = 0;
+
+		// Whether to use huge pages for large buffers
+		bool _hugepages = true;
+
+		// Buffers given back and ready to be borrowed again
+		std::mutex _mutex;
+		std::vector<AutoFileSyncBuffer> _free;
+
+	public:
+		// Constructor
+		AutoFileSyncBufferPool(size_t maxsize = 4 * 1024 * 1024, size_t minsize = 64 * 1024, bool hugepages = true) noexcept;
+
+		// Destructor (releases the buffers given back, borrowed ones must be given back before)
+		~AutoFileSyncBufferPool() noexcept;
+
+		// Copy constructor = delete
+		AutoFileSyncBufferPool(const AutoFileSyncBufferPool& y) noexcept = delete;
+		AutoFileSyncBufferPool& operator=(const AutoFileSyncBufferPool& y) noexcept = delete;
+
+		// Borrow a buffer fit for reading a file of sizehint bytes, data is nullptr if out of memory
+		AutoFileSyncBuffer borrow(unsigned long long sizehint) noexcept;
+
+		// Give back a borrowed buffer
+		void giveback(AutoFileSyncBuffer& buffer) noexcept;
+
+		// Buffer size fit for reading a file of sizehint bytes
+		size_t fitsize(unsigned long long sizehint) const noexcept;
+
+		// Largest buffer size
+		size_t maxsize() const noexcept;
+
+	private:
+		// Allocate and release the memory of a buffer
+		bool _allocate(AutoFileSyncBuffer& buffer, size_t size) noexcept;
+		void _release(AutoFileSyncBuffer& buffer) noexcept;
+	};
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,656 @@
+// AutoFileSyncChunks.cpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <cstring>
+#include <chrono>
+#include <filesystem>
+
+#include "AutoFileSyncReader.hpp"
+#include "AutoFileSyncChunks.hpp"
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Chunk store format constants
+	constexpr char _afsync_chunks_magic[8] = { 'A', 'F', 'S', 'Y', 'N', 'C', 'C', 'K' };
+	constexpr unsigned int _afsync_chunks_version = 1;
+	constexpr size_t _afsync_chunks_headsize = 16;
+	constexpr size_t _afsync_chunks_entrysize = 1 + 32 + 4 + 8 + 4 + 4;
+	constexpr unsigned long long _afsync_chunks_packsize = 256ULL * 1024 * 1024;
+
+	// Manifest format constants
+	constexpr char _afsync_manifest_magic[8] = { 'A', 'F', 'S', 'Y', 'N', 'C', 'M', 'F' };
+	constexpr unsigned int _afsync_manifest_version = 1;
+
+	// FastCDC chunk sizes
+	constexpr size_t _afsync_cdc_minsize = 16 * 1024;
+	constexpr size_t _afsync_cdc_avgsize = 64 * 1024;
+	constexpr size_t _afsync_cdc_maxsize = 256 * 1024;
+
+	// Utils (not headerable)
+	// Kernel - FNV-1a checksum of an entry
+	inline unsigned int _afsync_util_chunks_checksum(const unsigned char* data, size_t len) noexcept
+	{
+		unsigned int h = 2166136261U;
+		for (size_t i = 0; i < len; ++i)
+		{
+			h ^= data[i];
+			h *= 16777619U;
+		}
+		return h;
+	}
+
+	// Utils (not headerable)
+	// Kernel - key of a chunk (hash algorithm and digest)
+	inline std::string _afsync_util_chunks_key(const AutoFileSyncDigest& digest) noexcept
+	{
+		std::string key(33, '\0');
+		key[0] = (char)digest.algo;
+		memcpy(key.data() + 1, digest.bytes, 32);
+		return key;
+	}
+
+	// Utils (not headerable)
+	// Kernel - FastCDC gear table and normalized masks
+	// Note the masks spread their bits over the top 48 bits of the fingerprint, as every byte
+	// only reaches the top bits after shifting through the window; the small-chunk mask has
+	// 2 bits more than log2(avgsize) and the large-chunk mask 2 bits less (normalization level 2)
+	struct _afsync_cdc_tables
+	{
+		unsigned long long gear[256] = {};
+		unsigned long long masks = 0;
+		unsigned long long maskl = 0;
+
+		_afsync_cdc_tables() noexcept
+		{
+			unsigned long long seed = 0x4146535943444331ULL;
+			for (int i = 0; i < 256; ++i)
+			{
+				// splitmix64
+				unsigned long long z = (seed += 0x9e3779b97f4a7c15ULL);
+				z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+				z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+				gear[i] = z ^ (z >> 31);
+			}
+
+			int bits = 0;
+			for (size_t avg = _afsync_cdc_avgsize; avg > 1; avg >>= 1)
+			{
+				++bits;
+			}
+			auto spread = [](int ones) -> unsigned long long
+			{
+				unsigned long long mask = 0;
+				for (int i = 0; i < ones; ++i)
+				{
+					mask |= 1ULL << (63 - i * 48 / ones);
+				}
+				return mask;
+			};
+			masks = spread(bits + 2);
+			maskl = spread(bits - 2);
+		}
+
+		static const _afsync_cdc_tables& get() noexcept
+		{
+			static const _afsync_cdc_tables tables;
+			return tables;
+		}
+	};
+
+	// Utils (not headerable)
+	// Kernel - streaming FastCDC chunker, fed in file order, calling emit on every chunk
+	// Note bytes are kept until their chunk is cut (at most maxsize), the fingerprint and the
+	// scanned length of the current chunk survive between feeds so no byte is scanned twice
+	struct _afsync_cdc_chunker
+	{
+		const _afsync_cdc_tables& tables = _afsync_cdc_tables::get();
+		std::string pending;
+		size_t scanned = 0;
+		unsigned long long fp = 0;
+
+		template <class Emit>
+		bool feed(const unsigned char* data, size_t len, bool last, Emit& emit) noexcept
+		{
+			pending.append((const char*)data, len);
+			const unsigned char* base = (const unsigned char*)pending.data();
+			size_t start = 0;
+			bool ok = true;
+
+			while (ok == true)
+			{
+				size_t avail = pending.size() - start;
+				size_t cut = 0;
+
+				// skip the minimum size, then look for a cut point
+				if (this->scanned < _afsync_cdc_minsize)
+				{
+					this->scanned = (avail < _afsync_cdc_minsize ? avail : _afsync_cdc_minsize);
+				}
+				size_t end = (avail < _afsync_cdc_maxsize ? avail : _afsync_cdc_maxsize);
+				const size_t normal = (end < _afsync_cdc_avgsize ? end : _afsync_cdc_avgsize);
+				const unsigned char* p = base + start;
+				size_t i = this->scanned;
+				unsigned long long h = this->fp;
+				for (; i < normal; ++i)
+				{
+					h = (h << 1) + this->tables.gear[p[i]];
+					if ((h & this->tables.masks) == 0)
+					{
+						cut = i + 1;
+						break;
+					}
+				}
+				if (cut == 0)
+				{
+					for (; i < end; ++i)
+					{
+						h = (h << 1) + this->tables.gear[p[i]];
+						if ((h & this->tables.maskl) == 0)
+						{
+							cut = i + 1;
+							break;
+						}
+					}
+				}
+				if (cut == 0 && end == _afsync_cdc_maxsize)
+				{
+					cut = end;
+				}
+				if (cut == 0 && last == true && avail > 0)
+				{
+					cut = avail;
+				}
+
+				// need more bytes
+				if (cut == 0)
+				{
+					this->scanned = i;
+					this->fp = h;
+					break;
+				}
+
+				ok = emit(p, cut);
+				start += cut;
+				this->scanned = 0;
+				this->fp = 0;
+			}
+
+			pending.erase(0, start);
+			return ok;
+		}
+	};
+
+	// Constructor, creates the folder or loads the existing store
+	AutoFileSyncChunkStore::AutoFileSyncChunkStore(const std::string& root) noexcept
+	{
+		this->_root = root;
+		this->_algo = hash_strongest();
+
+		std::error_code ec;
+		std::filesystem::create_directories(root, ec);
+		if (std::filesystem::is_directory(root, ec) == false)
+		{
+			return;
+		}
+
+		// Read the index
+		const std::string indexpath = root + "/chunks.afsidx";
+		std::string data;
+		{
+			std::ifstream ifs(indexpath, std::ios::binary);
+			if (ifs.is_open() == true)
+			{
+				data.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+			}
+		}
+		bool usable = data.size() >= _afsync_chunks_headsize &&
+			memcmp(data.data(), _afsync_chunks_magic, 8) == 0;
+		if (usable == true)
+		{
+			unsigned int version = 0;
+			memcpy(&version, data.data() + 8, 4);
+			usable = version == _afsync_chunks_version;
+		}
+		bool rewrite = usable == false;
+
+		// Replay the entries until the first torn one, dropping those past the end of their pack
+		std::unordered_map<unsigned int, unsigned long long> packsizes;
+		size_t pos = _afsync_chunks_headsize;
+		while (usable == true && data.size() - pos >= _afsync_chunks_entrysize)
+		{
+			const unsigned char* entry = (const unsigned char*)data.data() + pos;
+			unsigned int checksum = 0;
+			memcpy(&checksum, entry + _afsync_chunks_entrysize - 4, 4);
+			if (checksum != _afsync_util_chunks_checksum(entry, _afsync_chunks_entrysize - 4))
+			{
+				break;
+			}
+			_location location;
+			memcpy(&location.pack, entry + 33, 4);
+			memcpy(&location.offset, entry + 37, 8);
+			memcpy(&location.length, entry + 45, 4);
+
+			auto packsize = packsizes.find(location.pack);
+			if (packsize == packsizes.end())
+			{
+				std::error_code fec;
+				unsigned long long size = std::filesystem::file_size(this->_pack_path(location.pack), fec);
+				packsize = packsizes.emplace(location.pack, fec ? 0 : size).first;
+			}
+			if (location.offset + location.length <= packsize->second)
+			{
+				this->_chunks[std::string((const char*)entry, 33)] = location;
+			}
+			else
+			{
+				rewrite = true;
+			}
+			pos += _afsync_chunks_entrysize;
+		}
+		rewrite = rewrite || (usable == true && pos != data.size());
+
+		// Append to the last pack
+		for (const auto& it : packsizes)
+		{
+			if (it.first >= this->_pack)
+			{
+				this->_pack = it.first;
+				this->_packsize = it.second;
+			}
+		}
+
+		// Rewrite the index with the usable entries if it was torn, then keep it open for appends
+		if (rewrite == true)
+		{
+			std::string index;
+			index.append(_afsync_chunks_magic, 8);
+			unsigned int version = _afsync_chunks_version;
+			unsigned int reserved = 0;
+			index.append((const char*)&version, 4);
+			index.append((const char*)&reserved, 4);
+			for (const auto& it : this->_chunks)
+			{
+				size_t start = index.size();
+				index.append(it.first);
+				index.append((const char*)&it.second.pack, 4);
+				index.append((const char*)&it.second.offset, 8);
+				index.append((const char*)&it.second.length, 4);
+				unsigned int checksum = _afsync_util_chunks_checksum((const unsigned char*)index.data() + start, index.size() - start);
+				index.append((const char*)&checksum, 4);
+			}
+			std::ofstream ofs(indexpath + ".tmp", std::ios::binary | std::ios::trunc);
+			ofs.write(index.data(), index.size());
+			ofs.close();
+			if (ofs.fail())
+			{
+				return;
+			}
+			std::filesystem::rename(indexpath + ".tmp", indexpath, ec);
+			if (ec)
+			{
+				return;
+			}
+		}
+		this->_indexout.open(indexpath, std::ios::binary | std::ios::app);
+		if (this->_indexout.is_open() == false)
+		{
+			return;
+		}
+
+		this->_valid = true;
+		return;
+	}
+
+	// Destructor
+	AutoFileSyncChunkStore::~AutoFileSyncChunkStore() noexcept
+	{
+		this->flush();
+		return;
+	}
+
+	// Validity
+	bool AutoFileSyncChunkStore::valid() const noexcept
+	{
+		return this->_valid;
+	}
+
+	// Chunks stored
+	size_t AutoFileSyncChunkStore::count() noexcept
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		return this->_chunks.size();
+	}
+
+	// Chunk a file and store its new chunks, false if it cannot be read or stored
+	bool AutoFileSyncChunkStore::put_file(const std::string& filepath, std::vector<AutoFileSyncDigest>& chunks, AutoFileSyncBufferPool* buffers,
+		unsigned long long& size, unsigned long long& stored) noexcept
+	{
+		chunks.clear();
+		size = 0;
+		stored = 0;
+		if (this->_valid == false)
+		{
+			return false;
+		}
+
+		static AutoFileSyncBufferPool fallback;
+		AutoFileSyncBufferPool& pool = (buffers != nullptr ? *buffers : fallback);
+
+		// Lambda to hash and store a chunk
+		bool ok = true;
+		auto emit = [&](const unsigned char* data, size_t len) -> bool
+		{
+			AutoFileSyncDigest digest;
+			if (hash_buffer(this->_algo, data, len, digest) == false || this->_put_chunk(digest, data, len, stored) == false)
+			{
+				return false;
+			}
+			chunks.push_back(digest);
+			size += len;
+			return true;
+		};
+
+		// Cut while reading, the last (short) chunk is cut once the file ends
+		_afsync_cdc_chunker chunker;
+		if (read_file(filepath, pool, ~0ULL, 1, [&](unsigned char* data, size_t len) -> void
+			{
+				if (ok == true)
+				{
+					ok = chunker.feed(data, len, false, emit);
+				}
+			}) == false)
+		{
+			return false;
+		}
+		if (ok == true)
+		{
+			ok = chunker.feed(nullptr, 0, true, emit);
+		}
+		return ok;
+	}
+
+	// Flush the packs and the index (call before writing a manifest referring to them)
+	bool AutoFileSyncChunkStore::flush() noexcept
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		if (this->_packout.is_open() == true)
+		{
+			this->_packout.flush();
+		}
+		if (this->_indexout.is_open() == true)
+		{
+			this->_indexout.flush();
+		}
+		return this->_packout.fail() == false && this->_indexout.fail() == false;
+	}
+
+	// Restore the files of a manifest into a folder, checking every chunk, false if any failed
+	bool AutoFileSyncChunkStore::restore(const std::vector<AutoFileSyncManifestFile>& files, const std::string& target) noexcept
+	{
+		if (this->_valid == false)
+		{
+			return false;
+		}
+		this->flush();
+
+		std::unordered_map<unsigned int, std::ifstream> packs;
+		std::string chunk;
+		bool restored = true;
+		for (const AutoFileSyncManifestFile& file : files)
+		{
+			std::filesystem::path to = std::filesystem::path(target) / file.path;
+			std::error_code ec;
+			std::filesystem::create_directories(to.parent_path(), ec);
+			std::ofstream ofs(to, std::ios::binary | std::ios::trunc);
+			bool ok = ofs.is_open();
+
+			for (size_t i = 0; ok == true && i < file.chunks.size(); ++i)
+			{
+				// locate
+				_location location;
+				{
+					std::lock_guard<std::mutex> lock(this->_mutex);
+					auto found = this->_chunks.find(_afsync_util_chunks_key(file.chunks[i]));
+					ok = found != this->_chunks.end();
+					if (ok == true)
+					{
+						location = found->second;
+					}
+				}
+				if (ok == false)
+				{
+					break;
+				}
+
+				// read and check
+				std::ifstream& pack = packs[location.pack];
+				if (pack.is_open() == false)
+				{
+					pack.open(this->_pack_path(location.pack), std::ios::binary);
+				}
+				chunk.resize(location.length);
+				pack.clear();
+				pack.seekg((std::streamoff)location.offset);
+				pack.read(chunk.data(), location.length);
+				AutoFileSyncDigest digest;
+				ok = pack.fail() == false &&
+					hash_buffer((AutoFileSyncHashAlgo)file.chunks[i].algo, (const unsigned char*)chunk.data(), chunk.size(), digest) == true &&
+					digest == file.chunks[i];
+				if (ok == true)
+				{
+					ofs.write(chunk.data(), chunk.size());
+				}
+			}
+			ofs.close();
+			ok = ok && ofs.fail() == false;
+
+			// keep the mtime
+			if (ok == true)
+			{
+				auto mtime = std::chrono::sys_time<std::chrono::nanoseconds>(std::chrono::nanoseconds(file.mtime));
+			#if defined(_WIN32)
+				std::filesystem::last_write_time(to, std::chrono::clock_cast<std::chrono::file_clock>(mtime), ec);
+			#else
+				std::filesystem::last_write_time(to, std::chrono::file_clock::from_sys(mtime), ec);
+			#endif
+			}
+			restored = restored && ok;
+		}
+		return restored;
+	}
+
+	// Store a chunk unless it is already stored, adding its length to stored if new
+	bool AutoFileSyncChunkStore::_put_chunk(const AutoFileSyncDigest& digest, const unsigned char* data, size_t len, unsigned long long& stored) noexcept
+	{
+		std::string key = _afsync_util_chunks_key(digest);
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		if (this->_chunks.find(key) != this->_chunks.end())
+		{
+			return true;
+		}
+		if (this->_open_pack(len) == false)
+		{
+			return false;
+		}
+
+		// Data first, then its entry
+		_location location;
+		location.pack = this->_pack;
+		location.offset = this->_packsize;
+		location.length = (unsigned int)len;
+		this->_packout.write((const char*)data, len);
+		this->_packout.flush();
+		if (this->_packout.fail())
+		{
+			this->_packout.close();
+			return false;
+		}
+		this->_packsize += len;
+
+		std::string entry = key;
+		entry.append((const char*)&location.pack, 4);
+		entry.append((const char*)&location.offset, 8);
+		entry.append((const char*)&location.length, 4);
+		unsigned int checksum = _afsync_util_chunks_checksum((const unsigned char*)entry.data(), entry.size());
+		entry.append((const char*)&checksum, 4);
+		this->_indexout.write(entry.data(), entry.size());
+		if (this->_indexout.fail())
+		{
+			return false;
+		}
+
+		this->_chunks[key] = location;
+		stored += len;
+		return true;
+	}
+
+	// Open the pack to append to, rolling over to a new one when full
+	bool AutoFileSyncChunkStore::_open_pack(size_t len) noexcept
+	{
+		if (this->_packsize > 0 && this->_packsize + len > _afsync_chunks_packsize)
+		{
+			this->_packout.close();
+			this->_pack++;
+			this->_packsize = 0;
+		}
+		if (this->_packout.is_open() == false)
+		{
+			this->_packout.clear();
+			this->_packout.open(this->_pack_path(this->_pack), std::ios::binary | std::ios::app);
+
+			// whatever follows the last usable chunk is kept, appends go after it
+			std::error_code ec;
+			unsigned long long size = std::filesystem::file_size(this->_pack_path(this->_pack), ec);
+			this->_packsize = (ec ? 0 : size);
+		}
+		return this->_packout.is_open();
+	}
+
+	// Path of a pack
+	std::string AutoFileSyncChunkStore::_pack_path(unsigned int pack) const noexcept
+	{
+		return this->_root + "/pack-" + std::to_string(pack) + ".afspack";
+	}
+
+	// Write a manifest snapshot (aside, then renamed), false if failed
+	//
+	// The file is binary:
+	//   header  "AFSYNCMF" u32 version u32 count
+	//   file    u32 pathlen, path, u64 size, i64 mtime, u32 chunks, chunks * (u8 hash algorithm, 32 bytes digest)
+	//   tail    u32 checksum of all the above
+	bool write_manifest(const std::string& path, const std::vector<AutoFileSyncManifestFile>& files) noexcept
+	{
+		std::string manifest;
+		manifest.append(_afsync_manifest_magic, 8);
+		unsigned int version = _afsync_manifest_version;
+		unsigned int count = (unsigned int)files.size();
+		manifest.append((const char*)&version, 4);
+		manifest.append((const char*)&count, 4);
+		for (const AutoFileSyncManifestFile& file : files)
+		{
+			unsigned int pathlen = (unsigned int)file.path.size();
+			unsigned int chunks = (unsigned int)file.chunks.size();
+			manifest.append((const char*)&pathlen, 4);
+			manifest.append(file.path);
+			manifest.append((const char*)&file.size, 8);
+			manifest.append((const char*)&file.mtime, 8);
+			manifest.append((const char*)&chunks, 4);
+			for (const AutoFileSyncDigest& chunk : file.chunks)
+			{
+				manifest.push_back((char)chunk.algo);
+				manifest.append((const char*)chunk.bytes, 32);
+			}
+		}
+		unsigned int checksum = _afsync_util_chunks_checksum((const unsigned char*)manifest.data(), manifest.size());
+		manifest.append((const char*)&checksum, 4);
+
+		const std::string tmppath = path + ".tmp";
+		std::ofstream ofs(tmppath, std::ios::binary | std::ios::trunc);
+		ofs.write(manifest.data(), manifest.size());
+		ofs.close();
+		if (ofs.fail())
+		{
+			return false;
+		}
+		std::error_code ec;
+		std::filesystem::rename(tmppath, path, ec);
+		return !ec;
+	}
+
+	// Read a manifest snapshot, false if missing or corrupted
+	bool read_manifest(const std::string& path, std::vector<AutoFileSyncManifestFile>& files) noexcept
+	{
+		files.clear();
+
+		std::ifstream ifs(path, std::ios::binary);
+		if (ifs.is_open() == false)
+		{
+			return false;
+		}
+		std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+		if (data.size() < 20 || memcmp(data.data(), _afsync_manifest_magic, 8) != 0)
+		{
+			return false;
+		}
+		unsigned int version = 0;
+		unsigned int count = 0;
+		unsigned int checksum = 0;
+		memcpy(&version, data.data() + 8, 4);
+		memcpy(&count, data.data() + 12, 4);
+		memcpy(&checksum, data.data() + data.size() - 4, 4);
+		if (version != _afsync_manifest_version ||
+			checksum != _afsync_util_chunks_checksum((const unsigned char*)data.data(), data.size() - 4))
+		{
+			return false;
+		}
+
+		// Lambda to take a field, false if past the end
+		const size_t len = data.size() - 4;
+		size_t pos = 16;
+		auto take = [&](void* field, size_t size) -> bool
+		{
+			if (len - pos < size)
+			{
+				return false;
+			}
+			memcpy(field, data.data() + pos, size);
+			pos += size;
+			return true;
+		};
+
+		files.resize(count);
+		for (AutoFileSyncManifestFile& file : files)
+		{
+			unsigned int pathlen = 0;
+			unsigned int chunks = 0;
+			if (take(&pathlen, 4) == false || len - pos < pathlen)
+			{
+				files.clear();
+				return false;
+			}
+			file.path.assign(data.data() + pos, pathlen);
+			pos += pathlen;
+			if (take(&file.size, 8) == false || take(&file.mtime, 8) == false || take(&chunks, 4) == false ||
+				len - pos < (size_t)chunks * 33)
+			{
+				files.clear();
+				return false;
+			}
+			file.chunks.resize(chunks);
+			for (AutoFileSyncDigest& chunk : file.chunks)
+			{
+				chunk.algo = (unsigned char)data[pos];
+				memcpy(chunk.bytes, data.data() + pos + 1, 32);
+				pos += 33;
+			}
+		}
+		return pos == len;
+	}
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,131 @@
+// AutoFileSyncChunks.hpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <unordered_map>
+
+#include "AutoFileSyncBuffers.hpp"
+#include "AutoFileSyncHasher.hpp"
+
+#pragma once
+
+#pragma warning (disable: 4018)
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4251)
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4661)
+#pragma warning (disable: 4715)
+#pragma warning (disable: 4804)
+#pragma warning (disable: 4819)
+#pragma warning (disable: 4919)
+#pragma warning (disable: 4996)
+#pragma warning (disable: 6031)
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// struct AutoFileSyncManifestFile
+	// A file of a manifest snapshot (path relative to the src) and its chunks in order
+	struct AutoFileSyncManifestFile
+	{
+		std::string path = "";
+		unsigned long long size = 0;
+		long long mtime = 0;                     // ns since the unix epoch
+		std::vector<AutoFileSyncDigest> chunks;
+	};
+
+	// class AutoFileSyncChunkStore
+	// Deduplicating store of content-defined chunks, kept in a folder next to the snapshots
+	//
+	// Files are cut with FastCDC (gear rolling hash, normalized chunking, 16 KiB to 256 KiB,
+	// 64 KiB on average) so an insertion only changes the chunks around it, and every chunk
+	// is addressed by its strong hash (blake3, otherwise sha256) and stored once:
+	//   pack-N.afspack  chunk data appended back to back, a new pack every 256 MiB
+	//   chunks.afsidx   header "AFSYNCCK" u32 version u32 reserved, then append-only entries
+	//                   u8 hash algorithm, 32 bytes digest, u32 pack, u64 offset, u32 length, u32 checksum
+	// Pack data is flushed before its entry, and entries that are torn or point past the end
+	// of their pack are dropped when loading, so a crash only leaves unreferenced bytes.
+	class AutoFileSyncChunkStore
+	{
+	private:
+		// Chunk location in the packs
+		struct _location
+		{
+			unsigned int pack = 0;
+			unsigned long long offset = 0;
+			unsigned int length = 0;
+		};
+
+		// Store folder and hash algorithm of new chunks
+		std::string _root = "";
+		AutoFileSyncHashAlgo _algo = AFSYNC_HASH_SHA256;
+
+		// Chunks (hash algorithm and digest, 33 bytes) and their locations
+		std::unordered_map<std::string, _location> _chunks;
+
+		// Pack being appended, its size, and the open pack and index files
+		unsigned int _pack = 0;
+		unsigned long long _packsize = 0;
+		std::ofstream _packout;
+		std::ofstream _indexout;
+
+		// Guards the chunks and the appends (chunking itself runs in parallel)
+		std::mutex _mutex;
+
+		// Validity
+		bool _valid = false;
+
+	public:
+		// Constructor, creates the folder or loads the existing store
+		AutoFileSyncChunkStore(const std::string& root) noexcept;
+
+		// Destructor
+		~AutoFileSyncChunkStore() noexcept;
+
+		// Copy constructor = delete
+		AutoFileSyncChunkStore(const AutoFileSyncChunkStore& y) noexcept = delete;
+		AutoFileSyncChunkStore& operator=(const AutoFileSyncChunkStore& y) noexcept = delete;
+
+		// Validity
+		bool valid() const noexcept;
+
+		// Chunks stored
+		size_t count() noexcept;
+
+		// Chunk a file and store its new chunks, false if it cannot be read or stored
+		// size gets the bytes read and stored the bytes of the chunks not stored before
+		bool put_file(const std::string& filepath, std::vector<AutoFileSyncDigest>& chunks, AutoFileSyncBufferPool* buffers,
+			unsigned long long& size, unsigned long long& stored) noexcept;
+
+		// Flush the packs and the index (call before writing a manifest referring to them)
+		bool flush() noexcept;
+
+		// Restore the files of a manifest into a folder, checking every chunk, false if any failed
+		bool restore(const std::vector<AutoFileSyncManifestFile>& files, const std::string& target) noexcept;
+
+	private:
+		// Store a chunk unless it is already stored, adding its length to stored if new
+		bool _put_chunk(const AutoFileSyncDigest& digest, const unsigned char* data, size_t len, unsigned long long& stored) noexcept;
+
+		// Open the pack to append to, rolling over to a new one when full
+		bool _open_pack(size_t len) noexcept;
+
+		// Path of a pack
+		std::string _pack_path(unsigned int pack) const noexcept;
+	};
+
+	// Write a manifest snapshot (aside, then renamed), false if failed
+	bool write_manifest(const std::string& path, const std::vector<AutoFileSyncManifestFile>& files) noexcept;
+
+	// Read a manifest snapshot, false if missing or corrupted
+	bool read_manifest(const std::string& path, std::vector<AutoFileSyncManifestFile>& files) noexcept;
+
+}
+// Namespace AutoFileSync ends
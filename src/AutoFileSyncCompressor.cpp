@@ -0,0 +1,670 @@
+// AutoFileSyncCompressor.cpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <map>
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+#include <condition_variable>
+
+// Optional compression libraries, compiled in when present
+#if __has_include("Libs/zstd.h")
+#include "Libs/zstd.h"
+#define AFSYNC_COMPRESS_WITH_ZSTD 1
+#endif
+#if __has_include("Libs/lz4frame.h")
+#include "Libs/lz4frame.h"
+#define AFSYNC_COMPRESS_WITH_LZ4 1
+#endif
+
+#include "AutoFileSyncCopier.hpp"
+#include "AutoFileSyncReader.hpp"
+#include "AutoFileSyncCompressor.hpp"
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Block of a file compressed as an independent frame
+	constexpr size_t _afsync_compress_blocksize = 4 * 1024 * 1024;
+
+	// Codec manifest format constants
+	constexpr char _afsync_codecs_magic[8] = { 'A', 'F', 'S', 'Y', 'N', 'C', 'C', 'Z' };
+	constexpr unsigned int _afsync_codecs_version = 1;
+
+	// Utils (not headerable)
+	// Kernel - signature of an already compressed format, len bytes at offset
+	struct _afsync_compress_signature
+	{
+		size_t offset;
+		size_t len;
+		const char* bytes;
+	};
+
+	// Utils (not headerable)
+	// Kernel - signatures of formats not worth compressing again
+	constexpr _afsync_compress_signature _afsync_compress_signatures[] =
+	{
+		{ 0, 2, "\x1F\x8B" },                         // gzip
+		{ 0, 4, "PK\x03\x04" },                       // zip (docx, xlsx, jar, apk, ...)
+		{ 0, 6, "7z\xBC\xAF\x27\x1C" },               // 7z
+		{ 0, 6, "\xFD" "7zXZ\x00" },                  // xz
+		{ 0, 3, "BZh" },                              // bzip2
+		{ 0, 4, "\x28\xB5\x2F\xFD" },                 // zstd
+		{ 0, 4, "\x04\x22\x4D\x18" },                 // lz4
+		{ 0, 6, "Rar!\x1A\x07" },                     // rar
+		{ 0, 8, "\x89PNG\r\n\x1A\n" },                // png
+		{ 0, 3, "\xFF\xD8\xFF" },                     // jpeg
+		{ 0, 4, "GIF8" },                             // gif
+		{ 8, 4, "WEBP" },                             // webp (RIFF)
+		{ 4, 4, "ftyp" },                             // mp4, mov, m4a, heic, avif
+		{ 0, 4, "\x1A\x45\xDF\xA3" },                 // mkv, webm
+		{ 0, 4, "OggS" },                             // ogg, opus
+		{ 0, 4, "fLaC" },                             // flac
+		{ 0, 3, "ID3" },                              // mp3 with tags
+		{ 0, 2, "\xFF\xFB" },                         // mp3
+	};
+
+	// Utils (not headerable)
+	// Kernel - FNV-1a checksum of a codec manifest
+	inline unsigned int _afsync_util_codecs_checksum(const unsigned char* data, size_t len) noexcept
+	{
+		unsigned int h = 2166136261U;
+		for (size_t i = 0; i < len; ++i)
+		{
+			h ^= data[i];
+			h *= 16777619U;
+		}
+		return h;
+	}
+
+	// Utils (not headerable)
+	// Kernel - keep the mode and times of a file on another
+	inline void _afsync_util_compress_keep(const std::string& from, const std::string& to) noexcept
+	{
+		std::error_code ec;
+		std::filesystem::permissions(to, std::filesystem::status(from, ec).permissions(), ec);
+		std::filesystem::last_write_time(to, std::filesystem::last_write_time(from, ec), ec);
+	}
+
+	// Utils (not headerable)
+	// Kernel - compressor of the blocks of one worker, as independent frames
+	struct _afsync_compress_engine
+	{
+		AutoFileSyncCodec codec = AFSYNC_CODEC_NONE;
+		int level = 0;
+	#if defined(AFSYNC_COMPRESS_WITH_ZSTD)
+		ZSTD_CCtx* zstd = nullptr;
+	#endif
+
+		~_afsync_compress_engine() noexcept
+		{
+		#if defined(AFSYNC_COMPRESS_WITH_ZSTD)
+			if (zstd != nullptr)
+			{
+				ZSTD_freeCCtx(zstd);
+			}
+		#endif
+		}
+
+		bool compress(const std::vector<unsigned char>& data, std::vector<unsigned char>& out) noexcept
+		{
+			switch (codec)
+			{
+		#if defined(AFSYNC_COMPRESS_WITH_ZSTD)
+			case AFSYNC_CODEC_ZSTD:
+			{
+				if (zstd == nullptr && (zstd = ZSTD_createCCtx()) == nullptr)
+				{
+					return false;
+				}
+				out.resize(ZSTD_compressBound(data.size()));
+				size_t len = ZSTD_compressCCtx(zstd, out.data(), out.size(), data.data(), data.size(), level);
+				if (ZSTD_isError(len))
+				{
+					return false;
+				}
+				out.resize(len);
+				return true;
+			}
+		#endif
+		#if defined(AFSYNC_COMPRESS_WITH_LZ4)
+			case AFSYNC_CODEC_LZ4:
+			{
+				LZ4F_preferences_t prefs;
+				memset(&prefs, 0, sizeof(prefs));
+				prefs.frameInfo.contentSize = data.size();
+				prefs.compressionLevel = level;
+				out.resize(LZ4F_compressFrameBound(data.size(), &prefs));
+				size_t len = LZ4F_compressFrame(out.data(), out.size(), data.data(), data.size(), &prefs);
+				if (LZ4F_isError(len))
+				{
+					return false;
+				}
+				out.resize(len);
+				return true;
+			}
+		#endif
+			default:
+				(void)data;
+				(void)out;
+				return false;
+			}
+		}
+	};
+
+	// Utils (not headerable)
+	// Kernel - blocks of a file on their way from the reader to the workers and back to the writer
+	// Note the reading thread also writes, in order, so at most limit blocks are held at once
+	struct _afsync_compress_pipeline
+	{
+		std::ofstream* out = nullptr;
+		size_t limit = 0;
+
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::deque<std::pair<size_t, std::vector<unsigned char>>> todo;
+		std::map<size_t, std::vector<unsigned char>> done;
+		size_t pushed = 0;
+		size_t written = 0;
+		bool closed = false;
+		bool failed = false;
+
+		// A worker, compressing blocks until closed and none is left
+		void work(_afsync_compress_engine& engine) noexcept
+		{
+			std::vector<unsigned char> compressed;
+			std::unique_lock<std::mutex> lock(mutex);
+			while (true)
+			{
+				cv.wait(lock, [this]() { return todo.empty() == false || closed == true; });
+				if (todo.empty() == true)
+				{
+					return;
+				}
+				std::pair<size_t, std::vector<unsigned char>> block = std::move(todo.front());
+				todo.pop_front();
+				lock.unlock();
+				bool compressed_ok = engine.compress(block.second, compressed);
+				lock.lock();
+				failed = failed || compressed_ok == false;
+				done[block.first] = std::move(compressed);
+				compressed.clear();
+				cv.notify_all();
+			}
+		}
+
+		// Queue a block, then write the blocks done in order, waiting while too many are held
+		void push(std::vector<unsigned char>&& block) noexcept
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			todo.emplace_back(pushed++, std::move(block));
+			cv.notify_all();
+			drain(lock, limit);
+		}
+
+		// Write the blocks done in order until fewer than held are left
+		void drain(std::unique_lock<std::mutex>& lock, size_t held) noexcept
+		{
+			while (true)
+			{
+				auto next = done.find(written);
+				if (next != done.end())
+				{
+					std::vector<unsigned char> compressed = std::move(next->second);
+					done.erase(next);
+					lock.unlock();
+					out->write((const char*)compressed.data(), compressed.size());
+					lock.lock();
+					++written;
+					continue;
+				}
+				if (pushed - written < held)
+				{
+					return;
+				}
+				cv.wait(lock);
+			}
+		}
+	};
+
+	// Name of a codec ("zstd", "lz4", "none")
+	const char* codec_name(AutoFileSyncCodec codec) noexcept
+	{
+		switch (codec)
+		{
+		case AFSYNC_CODEC_ZSTD:
+			return "zstd";
+		case AFSYNC_CODEC_LZ4:
+			return "lz4";
+		default:
+			return "none";
+		}
+	}
+
+	// Codec of a name, AFSYNC_CODEC_NONE if unknown
+	AutoFileSyncCodec codec_parse(const std::string& name) noexcept
+	{
+		if (name == "zstd" || name == "zst")
+		{
+			return AFSYNC_CODEC_ZSTD;
+		}
+		else if (name == "lz4")
+		{
+			return AFSYNC_CODEC_LZ4;
+		}
+		return AFSYNC_CODEC_NONE;
+	}
+
+	// Whether a codec is compiled in (zstd and lz4 need Libs/zstd.h and Libs/lz4frame.h)
+	bool codec_available(AutoFileSyncCodec codec) noexcept
+	{
+		switch (codec)
+		{
+	#if defined(AFSYNC_COMPRESS_WITH_ZSTD)
+		case AFSYNC_CODEC_ZSTD:
+			return true;
+	#endif
+	#if defined(AFSYNC_COMPRESS_WITH_LZ4)
+		case AFSYNC_CODEC_LZ4:
+			return true;
+	#endif
+		default:
+			return false;
+		}
+	}
+
+	// Whether a file is in an already compressed format, sniffed from its first bytes
+	bool compressed_format(const std::string& filepath) noexcept
+	{
+		std::ifstream ifs(filepath, std::ios::binary);
+		char head[16] = {};
+		ifs.read(head, sizeof(head));
+		size_t len = (size_t)ifs.gcount();
+		for (const _afsync_compress_signature& signature : _afsync_compress_signatures)
+		{
+			if (signature.offset + signature.len <= len && memcmp(head + signature.offset, signature.bytes, signature.len) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Compress a file (overwritten if existing) keeping its mode and times, false if failed
+	bool compress_file(const std::string& from, const std::string& to, AutoFileSyncCodec codec, int level, int threads,
+		AutoFileSyncBufferPool& buffers, unsigned long long& size) noexcept
+	{
+		size = 0;
+		if (codec_available(codec) == false)
+		{
+			return false;
+		}
+	#if defined(AFSYNC_COMPRESS_WITH_ZSTD)
+		if (codec == AFSYNC_CODEC_ZSTD)
+		{
+			level = (level < ZSTD_minCLevel() ? ZSTD_minCLevel() : (level > ZSTD_maxCLevel() ? ZSTD_maxCLevel() : level));
+		}
+	#endif
+		if (codec == AFSYNC_CODEC_LZ4 && level > 12)
+		{
+			level = 12;
+		}
+
+		std::error_code ec;
+		unsigned long long sizehint = std::filesystem::file_size(from, ec);
+		std::ofstream ofs(to, std::ios::binary | std::ios::trunc);
+		if (ofs.is_open() == false)
+		{
+			return false;
+		}
+
+		// Workers, no more than blocks, none for a single block (compressed while reading)
+		size_t blocks = (size_t)((sizehint + _afsync_compress_blocksize - 1) / _afsync_compress_blocksize);
+		size_t workers = (threads < 1 ? 1 : (size_t)threads);
+		workers = (workers < blocks ? workers : blocks);
+		_afsync_compress_pipeline pipeline;
+		pipeline.out = &ofs;
+		pipeline.limit = workers * 2;
+		std::vector<_afsync_compress_engine> engines(workers < 1 ? 1 : workers);
+		for (_afsync_compress_engine& engine : engines)
+		{
+			engine.codec = codec;
+			engine.level = level;
+		}
+		std::vector<std::thread> pool;
+		for (size_t k = 0; workers > 1 && k < workers; ++k)
+		{
+			pool.emplace_back([&pipeline, &engines, k]() { pipeline.work(engines[k]); });
+		}
+
+		// Lambda to hand a full block over, or compress it here without workers
+		std::vector<unsigned char> block;
+		std::vector<unsigned char> compressed;
+		bool inlined = true;
+		auto flush = [&]() -> void
+		{
+			if (pool.empty() == false)
+			{
+				pipeline.push(std::move(block));
+				block = std::vector<unsigned char>();
+			}
+			else
+			{
+				inlined = inlined && engines[0].compress(block, compressed) == true;
+				ofs.write((const char*)compressed.data(), compressed.size());
+				block.clear();
+			}
+			block.reserve(_afsync_compress_blocksize);
+		};
+
+		block.reserve(sizehint < _afsync_compress_blocksize ? (size_t)sizehint : _afsync_compress_blocksize);
+		bool read = read_file(from, buffers, sizehint, 2, [&](unsigned char* data, size_t len)
+			{
+				size += len;
+				while (len > 0)
+				{
+					size_t take = _afsync_compress_blocksize - block.size();
+					take = (take < len ? take : len);
+					block.insert(block.end(), data, data + take);
+					data += take;
+					len -= take;
+					if (block.size() == _afsync_compress_blocksize)
+					{
+						flush();
+					}
+				}
+			});
+		if (block.empty() == false)
+		{
+			flush();
+		}
+
+		// Close the pipeline, write the rest
+		{
+			std::unique_lock<std::mutex> lock(pipeline.mutex);
+			pipeline.closed = true;
+			pipeline.cv.notify_all();
+			pipeline.drain(lock, 1);
+		}
+		for (std::thread& worker : pool)
+		{
+			worker.join();
+		}
+
+		ofs.close();
+		if (read == false || inlined == false || pipeline.failed == true || ofs.fail() == true)
+		{
+			return false;
+		}
+		_afsync_util_compress_keep(from, to);
+		return true;
+	}
+
+	// Decompress a file (overwritten if existing) keeping its mode and times, false if failed or truncated
+	bool decompress_file(const std::string& from, const std::string& to, AutoFileSyncCodec codec,
+		AutoFileSyncBufferPool& buffers, unsigned long long& size) noexcept
+	{
+		size = 0;
+		if (codec_available(codec) == false)
+		{
+			return false;
+		}
+		std::error_code ec;
+		unsigned long long sizehint = std::filesystem::file_size(from, ec);
+		std::ofstream ofs(to, std::ios::binary | std::ios::trunc);
+		AutoFileSyncBuffer buffer = buffers.borrow(_afsync_compress_blocksize);
+		if (ofs.is_open() == false || buffer.data == nullptr)
+		{
+			buffers.giveback(buffer);
+			return false;
+		}
+
+		// Lambda to write a decompressed piece
+		auto emit = [&](size_t len) -> void
+		{
+			ofs.write((const char*)buffer.data, len);
+			size += len;
+		};
+
+		// Streamed through one output buffer, frame after frame, left is nonzero inside a frame
+		// Note once the input is used up the decoder is called again only while it may hold output,
+		// a call past the end of a frame would start waiting for the header of the next one
+		bool decoded = true;
+		size_t left = 0;
+		bool read = false;
+		switch (codec)
+		{
+	#if defined(AFSYNC_COMPRESS_WITH_ZSTD)
+		case AFSYNC_CODEC_ZSTD:
+		{
+			ZSTD_DCtx* zstd = ZSTD_createDCtx();
+			decoded = zstd != nullptr;
+			read = decoded == true && read_file(from, buffers, sizehint, 2, [&](unsigned char* data, size_t len)
+				{
+					ZSTD_inBuffer in = { data, len, 0 };
+					while (decoded == true)
+					{
+						ZSTD_outBuffer out = { buffer.data, buffer.size, 0 };
+						size_t got = ZSTD_decompressStream(zstd, &out, &in);
+						if (ZSTD_isError(got))
+						{
+							decoded = false;
+							break;
+						}
+						left = got;
+						emit(out.pos);
+						if (in.pos == in.size && (out.pos < out.size || got == 0))
+						{
+							break;
+						}
+					}
+				});
+			if (zstd != nullptr)
+			{
+				ZSTD_freeDCtx(zstd);
+			}
+			break;
+		}
+	#endif
+	#if defined(AFSYNC_COMPRESS_WITH_LZ4)
+		case AFSYNC_CODEC_LZ4:
+		{
+			LZ4F_dctx* lz4 = nullptr;
+			decoded = LZ4F_isError(LZ4F_createDecompressionContext(&lz4, LZ4F_VERSION)) == false;
+			read = decoded == true && read_file(from, buffers, sizehint, 2, [&](unsigned char* data, size_t len)
+				{
+					size_t pos = 0;
+					while (decoded == true)
+					{
+						size_t outlen = buffer.size;
+						size_t inlen = len - pos;
+						size_t got = LZ4F_decompress(lz4, buffer.data, &outlen, data + pos, &inlen, nullptr);
+						if (LZ4F_isError(got))
+						{
+							decoded = false;
+							break;
+						}
+						left = got;
+						pos += inlen;
+						emit(outlen);
+						if (pos == len && (outlen < buffer.size || got == 0))
+						{
+							break;
+						}
+					}
+				});
+			if (lz4 != nullptr)
+			{
+				LZ4F_freeDecompressionContext(lz4);
+			}
+			break;
+		}
+	#endif
+		default:
+			(void)sizehint;
+			(void)emit;
+			break;
+		}
+		buffers.giveback(buffer);
+
+		ofs.close();
+		if (read == false || decoded == false || left != 0 || ofs.fail() == true)
+		{
+			return false;
+		}
+		_afsync_util_compress_keep(from, to);
+		return true;
+	}
+
+	// Write the codec manifest of a snapshot folder (aside, then renamed), false if failed
+	bool write_codecs(const std::string& path, const std::vector<AutoFileSyncCompressedFile>& files) noexcept
+	{
+		std::string manifest;
+		manifest.append(_afsync_codecs_magic, 8);
+		unsigned int version = _afsync_codecs_version;
+		unsigned int count = (unsigned int)files.size();
+		manifest.append((const char*)&version, 4);
+		manifest.append((const char*)&count, 4);
+		for (const AutoFileSyncCompressedFile& file : files)
+		{
+			unsigned int pathlen = (unsigned int)file.path.size();
+			manifest.append((const char*)&pathlen, 4);
+			manifest.append(file.path);
+			manifest.push_back((char)file.codec);
+			manifest.append((const char*)&file.size, 8);
+		}
+		unsigned int checksum = _afsync_util_codecs_checksum((const unsigned char*)manifest.data(), manifest.size());
+		manifest.append((const char*)&checksum, 4);
+
+		const std::string tmppath = path + ".tmp";
+		std::ofstream ofs(tmppath, std::ios::binary | std::ios::trunc);
+		ofs.write(manifest.data(), manifest.size());
+		ofs.close();
+		if (ofs.fail())
+		{
+			return false;
+		}
+		std::error_code ec;
+		std::filesystem::rename(tmppath, path, ec);
+		return !ec;
+	}
+
+	// Read the codec manifest of a snapshot folder, false if missing or corrupted
+	bool read_codecs(const std::string& path, std::vector<AutoFileSyncCompressedFile>& files) noexcept
+	{
+		files.clear();
+
+		std::ifstream ifs(path, std::ios::binary);
+		if (ifs.is_open() == false)
+		{
+			return false;
+		}
+		std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+		if (data.size() < 20 || memcmp(data.data(), _afsync_codecs_magic, 8) != 0)
+		{
+			return false;
+		}
+		unsigned int version = 0;
+		unsigned int count = 0;
+		unsigned int checksum = 0;
+		memcpy(&version, data.data() + 8, 4);
+		memcpy(&count, data.data() + 12, 4);
+		memcpy(&checksum, data.data() + data.size() - 4, 4);
+		if (version != _afsync_codecs_version ||
+			checksum != _afsync_util_codecs_checksum((const unsigned char*)data.data(), data.size() - 4))
+		{
+			return false;
+		}
+
+		// Lambda to take a field, false if past the end
+		const size_t len = data.size() - 4;
+		size_t pos = 16;
+		auto take = [&](void* field, size_t size) -> bool
+		{
+			if (len - pos < size)
+			{
+				return false;
+			}
+			memcpy(field, data.data() + pos, size);
+			pos += size;
+			return true;
+		};
+
+		files.resize(count);
+		for (AutoFileSyncCompressedFile& file : files)
+		{
+			unsigned int pathlen = 0;
+			if (take(&pathlen, 4) == false || len - pos < pathlen)
+			{
+				files.clear();
+				return false;
+			}
+			file.path.assign(data.data() + pos, pathlen);
+			pos += pathlen;
+			if (take(&file.codec, 1) == false || take(&file.size, 8) == false)
+			{
+				files.clear();
+				return false;
+			}
+		}
+		return pos == len;
+	}
+
+	// Restore a snapshot folder into a folder, decompressing the files of its codec manifest, false if any failed
+	bool restore_compressed(const std::string& folder, const std::vector<AutoFileSyncCompressedFile>& files,
+		const std::string& target, AutoFileSyncBufferPool& buffers) noexcept
+	{
+		std::unordered_map<std::string, const AutoFileSyncCompressedFile*> compressed;
+		for (const AutoFileSyncCompressedFile& file : files)
+		{
+			compressed[file.path] = &file;
+		}
+
+		std::error_code ec;
+		if (std::filesystem::is_directory(folder, ec) == false)
+		{
+			return false;
+		}
+		bool restored = true;
+		for (std::filesystem::recursive_directory_iterator it(folder, ec), end; !ec && it != end; it.increment(ec))
+		{
+			std::error_code tec;
+			std::string relpath = it->path().lexically_relative(folder).generic_string();
+			std::filesystem::path to = std::filesystem::path(target) / relpath;
+			if (it->is_directory(tec) == true)
+			{
+				std::filesystem::create_directories(to, tec);
+				continue;
+			}
+			if (it->is_regular_file(tec) == false)
+			{
+				continue;
+			}
+			std::filesystem::create_directories(to.parent_path(), tec);
+
+			// compressed, or stored as it is
+			auto found = compressed.find(relpath);
+			if (found != compressed.end() && found->second->codec != AFSYNC_CODEC_NONE)
+			{
+				unsigned long long size = 0;
+				restored = decompress_file(it->path().string(), to.string(), (AutoFileSyncCodec)found->second->codec, buffers, size) == true &&
+					size == found->second->size && restored == true;
+			}
+			else
+			{
+				restored = copy_file(it->path().string(), to.string(), &buffers) != AFSYNC_COPY_FAILED && restored == true;
+			}
+		}
+		return restored == true && !ec;
+	}
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,85 @@
+// AutoFileSyncCompressor.hpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <string>
+#include <vector>
+
+#include "AutoFileSyncBuffers.hpp"
+
+#pragma once
+
+#pragma warning (disable: 4018)
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4251)
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4661)
+#pragma warning (disable: 4715)
+#pragma warning (disable: 4804)
+#pragma warning (disable: 4819)
+#pragma warning (disable: 4919)
+#pragma warning (disable: 4996)
+#pragma warning (disable: 6031)
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Compression codecs of snapshot files (values are persisted in codec manifests, never reuse them)
+	enum AutoFileSyncCodec : unsigned char
+	{
+		AFSYNC_CODEC_NONE = 0,
+		AFSYNC_CODEC_ZSTD = 1,     // zstd frames, levels 1 to 19 (negative for faster), 3 by default
+		AFSYNC_CODEC_LZ4 = 2,      // lz4 frames, level 0 (fast) to 12 (hc)
+	};
+
+	// struct AutoFileSyncCompressedFile
+	// A compressed file of a snapshot folder (path relative to it), its codec and its size once decompressed
+	struct AutoFileSyncCompressedFile
+	{
+		std::string path = "";
+		unsigned char codec = AFSYNC_CODEC_NONE;
+		unsigned long long size = 0;
+	};
+
+	// Name of a codec ("zstd", "lz4", "none")
+	const char* codec_name(AutoFileSyncCodec codec) noexcept;
+
+	// Codec of a name, AFSYNC_CODEC_NONE if unknown
+	AutoFileSyncCodec codec_parse(const std::string& name) noexcept;
+
+	// Whether a codec is compiled in (zstd and lz4 need Libs/zstd.h and Libs/lz4frame.h)
+	bool codec_available(AutoFileSyncCodec codec) noexcept;
+
+	// Whether a file is in an already compressed format (archives, images, audio, video), sniffed from its first bytes
+	bool compressed_format(const std::string& filepath) noexcept;
+
+	// Compress a file (overwritten if existing) keeping its mode and times, false if failed
+	// size gets the bytes read
+	//
+	// The file is cut into 4 MiB blocks compressed as independent frames by up to threads workers
+	// while it is being read, then written in order, so the result is a plain .zst or .lz4 stream
+	// (concatenated frames) that any zstd or lz4 tool decompresses as well.
+	bool compress_file(const std::string& from, const std::string& to, AutoFileSyncCodec codec, int level, int threads,
+		AutoFileSyncBufferPool& buffers, unsigned long long& size) noexcept;
+
+	// Decompress a file (overwritten if existing) keeping its mode and times, false if failed or truncated
+	// size gets the bytes written
+	bool decompress_file(const std::string& from, const std::string& to, AutoFileSyncCodec codec,
+		AutoFileSyncBufferPool& buffers, unsigned long long& size) noexcept;
+
+	// Write the codec manifest of a snapshot folder (aside, then renamed), false if failed
+	// Note files not listed are stored as they are
+	bool write_codecs(const std::string& path, const std::vector<AutoFileSyncCompressedFile>& files) noexcept;
+
+	// Read the codec manifest of a snapshot folder, false if missing or corrupted
+	bool read_codecs(const std::string& path, std::vector<AutoFileSyncCompressedFile>& files) noexcept;
+
+	// Restore a snapshot folder into a folder, decompressing the files of its codec manifest, false if any failed
+	bool restore_compressed(const std::string& folder, const std::vector<AutoFileSyncCompressedFile>& files,
+		const std::string& target, AutoFileSyncBufferPool& buffers) noexcept;
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,257 @@
+// AutoFileSyncControl.cpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#if defined(__linux__)
+#include <poll.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#define AFSYNC_WITH_CONTROL 1
+#endif
+
+#include <cerrno>
+#include <cstring>
+
+#include "AutoFileSyncControl.hpp"
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Longest command line taken, a connection sending a longer one is closed
+	constexpr size_t _afsync_control_maxline = 4096;
+
+	// Constructor
+	AutoFileSyncControl::AutoFileSyncControl(const std::string& path, const AutoFileSyncCommand& handler) noexcept
+	{
+		this->_path = path;
+		this->_handler = handler;
+	}
+
+	// Destructor
+	AutoFileSyncControl::~AutoFileSyncControl() noexcept
+	{
+		this->stop();
+	}
+
+	// Start listening, false if the socket cannot be made
+	bool AutoFileSyncControl::start() noexcept
+	{
+		if (this->_thread != nullptr)
+		{
+			return false;
+		}
+		this->_tostop = false;
+
+#if defined(AFSYNC_WITH_CONTROL)
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		if (this->_path == "" || this->_path.size() >= sizeof(address.sun_path))
+		{
+			return false;
+		}
+		strcpy(address.sun_path, this->_path.c_str());
+
+		// A stale socket is replaced, anything else at the path is left alone
+		struct stat st;
+		if (lstat(this->_path.c_str(), &st) == 0)
+		{
+			if (S_ISSOCK(st.st_mode) == false)
+			{
+				return false;
+			}
+			unlink(this->_path.c_str());
+		}
+
+		// For the owner only, from its creation on
+		this->_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (this->_fd < 0)
+		{
+			return false;
+		}
+		mode_t mask = umask(0177);
+		int bound = bind(this->_fd, (sockaddr*)&address, sizeof(address));
+		umask(mask);
+		this->_wakefd = eventfd(0, EFD_CLOEXEC);
+		if (bound < 0 || listen(this->_fd, 16) < 0 || this->_wakefd < 0)
+		{
+			if (bound == 0)
+			{
+				unlink(this->_path.c_str());
+			}
+			close(this->_fd);
+			if (this->_wakefd >= 0)
+			{
+				close(this->_wakefd);
+			}
+			this->_fd = -1;
+			this->_wakefd = -1;
+			return false;
+		}
+
+		this->_thread = new std::thread([this]() { this->_loop_accept(); });
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	// Stop listening, closing the connections (the socket is removed)
+	void AutoFileSyncControl::stop() noexcept
+	{
+		if (this->_thread == nullptr)
+		{
+			return;
+		}
+
+#if defined(AFSYNC_WITH_CONTROL)
+		// Wake the accepting thread up and wait for it
+		this->_tostop = true;
+		unsigned long long one = 1;
+		write(this->_wakefd, &one, sizeof(one));
+		this->_thread->join();
+		close(this->_fd);
+		close(this->_wakefd);
+		unlink(this->_path.c_str());
+		this->_fd = -1;
+		this->_wakefd = -1;
+
+		// Then the connections, their reads ended (a command being handled is answered first)
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		for (std::unique_ptr<_client>& client : this->_clients)
+		{
+			shutdown(client->fd, SHUT_RDWR);
+		}
+		for (std::unique_ptr<_client>& client : this->_clients)
+		{
+			client->thread.join();
+			close(client->fd);
+		}
+		this->_clients.clear();
+#endif
+
+		delete this->_thread;
+		this->_thread = nullptr;
+	}
+
+	// Accepting thread loop
+	void AutoFileSyncControl::_loop_accept() noexcept
+	{
+#if defined(AFSYNC_WITH_CONTROL)
+		while (this->_tostop == false)
+		{
+			pollfd fds[2] = { { this->_fd, POLLIN, 0 }, { this->_wakefd, POLLIN, 0 } };
+			if (poll(fds, 2, -1) < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return;
+			}
+			if ((fds[1].revents & POLLIN) != 0)
+			{
+				return;
+			}
+			if ((fds[0].revents & POLLIN) == 0)
+			{
+				continue;
+			}
+			int fd = accept4(this->_fd, nullptr, nullptr, SOCK_CLOEXEC);
+			if (fd < 0)
+			{
+				continue;
+			}
+
+			// Reap the connections done, then serve the new one
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			for (auto it = this->_clients.begin(); it != this->_clients.end();)
+			{
+				if ((*it)->done == true)
+				{
+					(*it)->thread.join();
+					close((*it)->fd);
+					it = this->_clients.erase(it);
+					continue;
+				}
+				++it;
+			}
+			this->_clients.push_back(std::make_unique<_client>());
+			_client* client = this->_clients.back().get();
+			client->fd = fd;
+			client->thread = std::thread([this, client]() { this->_loop_client(client); });
+		}
+#endif
+		return;
+	}
+
+	// Connection thread loop, a reply per command line
+	void AutoFileSyncControl::_loop_client(_client* client) noexcept
+	{
+#if defined(AFSYNC_WITH_CONTROL)
+		std::string pending = "";
+		char chunk[1024];
+		while (this->_tostop == false)
+		{
+			ssize_t got = recv(client->fd, chunk, sizeof(chunk), 0);
+			if (got < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (got <= 0)
+			{
+				break;
+			}
+			pending.append(chunk, (size_t)got);
+
+			// Every whole line, answered in order
+			size_t begin = 0;
+			size_t end = 0;
+			bool closing = false;
+			while ((end = pending.find('\n', begin)) != std::string::npos)
+			{
+				std::string line = pending.substr(begin, end - begin);
+				begin = end + 1;
+				if (line.empty() == false && line.back() == '\r')
+				{
+					line.pop_back();
+				}
+				std::string reply = this->_handler(line) + "\n";
+				for (size_t sent = 0; sent < reply.size();)
+				{
+					ssize_t put = send(client->fd, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+					if (put < 0 && errno == EINTR)
+					{
+						continue;
+					}
+					if (put <= 0)
+					{
+						closing = true;
+						break;
+					}
+					sent += (size_t)put;
+				}
+				if (closing == true)
+				{
+					break;
+				}
+			}
+			pending.erase(0, begin);
+			if (closing == true || pending.size() > _afsync_control_maxline)
+			{
+				break;
+			}
+		}
+		shutdown(client->fd, SHUT_RDWR);
+#endif
+		client->done = true;
+		return;
+	}
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,93 @@
+// AutoFileSyncControl.hpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <functional>
+
+#pragma once
+
+#pragma warning (disable: 4018)
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4251)
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4661)
+#pragma warning (disable: 4715)
+#pragma warning (disable: 4804)
+#pragma warning (disable: 4819)
+#pragma warning (disable: 4919)
+#pragma warning (disable: 6031)
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Handler of a command (a line, without its newline), its reply (lines, without the last newline)
+	typedef std::function<std::string(const std::string&)> AutoFileSyncCommand;
+
+	// class AutoFileSyncControl
+	// Control socket of a running service, a unix domain socket taking commands line by line
+	//
+	// Every connection has a thread of its own, so a command waiting (for a snapshot to end) holds
+	// its connection only, and the handler is called on these threads, never on the working ones.
+	// The socket is made for the owner only (0600), and a stale one left by a crash is replaced.
+	// Linux only, elsewhere start() is false.
+	class AutoFileSyncControl
+	{
+	private:
+		// Socket path and the handler of the commands
+		std::string _path = "";
+		AutoFileSyncCommand _handler;
+
+		// Listening socket, and an eventfd to wake the accepting thread up
+		int _fd = -1;
+		int _wakefd = -1;
+
+		// Accepting thread and its stop signal
+		std::thread* _thread = nullptr;
+		std::atomic<bool> _tostop = false;
+
+		// Connections, each with its thread (reaped once done)
+		struct _client
+		{
+			int fd = -1;
+			std::thread thread;
+			std::atomic<bool> done = false;
+		};
+		std::mutex _mutex;
+		std::list<std::unique_ptr<_client>> _clients;
+
+	public:
+		// Constructor
+		AutoFileSyncControl(const std::string& path, const AutoFileSyncCommand& handler) noexcept;
+
+		// Destructor
+		~AutoFileSyncControl() noexcept;
+
+		// Copy constructor = delete
+		AutoFileSyncControl(const AutoFileSyncControl& y) noexcept = delete;
+		AutoFileSyncControl& operator=(const AutoFileSyncControl& y) noexcept = delete;
+
+		// Start listening, false if the socket cannot be made
+		bool start() noexcept;
+
+		// Stop listening, closing the connections (the socket is removed)
+		void stop() noexcept;
+
+	private:
+		// Accepting thread loop
+		void _loop_accept() noexcept;
+
+		// Connection thread loop, a reply per command line
+		void _loop_client(_client* client) noexcept;
+	};
+
+}
+// Namespace AutoFileSync ends
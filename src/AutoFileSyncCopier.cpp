@@ -0,0 +1,383 @@
+// AutoFileSyncCopier.cpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <cerrno>
+#include <filesystem>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#elif defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#endif
+
+#include "AutoFileSyncCopier.hpp"
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+#if defined(__linux__)
+	// Utils (not headerable)
+	// Kernel - copy a range at the same offset, in kernel if possible, false if failed
+	bool _afsync_copy_range(int in, int out, unsigned long long offset, unsigned long long len, AutoFileSyncBufferPool& buffers) noexcept
+	{
+		unsigned long long copied = 0;
+		while (copied < len)
+		{
+			off_t inoffset = (off_t)(offset + copied);
+			off_t outoffset = inoffset;
+			ssize_t n = copy_file_range(in, &inoffset, out, &outoffset, (size_t)(len - copied), 0);
+			if (n <= 0)
+			{
+				break;
+			}
+			copied += (unsigned long long)n;
+		}
+		if (copied >= len)
+		{
+			return true;
+		}
+
+		AutoFileSyncBuffer buffer = buffers.borrow(len - copied);
+		if (buffer.data == nullptr)
+		{
+			return false;
+		}
+		while (copied < len)
+		{
+			size_t want = (size_t)(len - copied < buffer.size ? len - copied : buffer.size);
+			ssize_t n = pread(in, buffer.data, want, (off_t)(offset + copied));
+			if (n <= 0 || pwrite(out, buffer.data, (size_t)n, (off_t)(offset + copied)) != n)
+			{
+				break;
+			}
+			copied += (unsigned long long)n;
+		}
+		buffers.giveback(buffer);
+		return copied >= len;
+	}
+
+	// Utils (not headerable)
+	// Kernel - copy with copy_file_range, sendfile or a buffer, from the first that works
+	// Note a later path takes over where the former stopped, and a file shrunk meanwhile ends early
+	AutoFileSyncCopyPath _afsync_copy_fds(int in, int out, unsigned long long size, AutoFileSyncBufferPool& buffers) noexcept
+	{
+		unsigned long long copied = 0;
+		int err = 0;
+
+		// copy_file_range (linux 4.5+, cross filesystem since 5.3)
+		while (copied < size)
+		{
+			ssize_t n = copy_file_range(in, nullptr, out, nullptr, (size_t)(size - copied), 0);
+			if (n == 0)
+			{
+				size = copied;
+			}
+			if (n <= 0)
+			{
+				err = (n < 0 ? errno : 0);
+				break;
+			}
+			copied += (unsigned long long)n;
+		}
+		if (copied >= size)
+		{
+			return AFSYNC_COPY_RANGE;
+		}
+		if (err != EXDEV && err != ENOSYS && err != EOPNOTSUPP && err != EINVAL)
+		{
+			return AFSYNC_COPY_FAILED;
+		}
+
+		// sendfile, from where copy_file_range stopped
+		AutoFileSyncCopyPath path = (copied > 0 ? AFSYNC_COPY_RANGE : AFSYNC_COPY_SENDFILE);
+		while (copied < size)
+		{
+			off_t offset = (off_t)copied;
+			ssize_t n = sendfile(out, in, &offset, (size_t)(size - copied));
+			if (n == 0)
+			{
+				size = copied;
+			}
+			if (n <= 0)
+			{
+				break;
+			}
+			copied += (unsigned long long)n;
+		}
+		if (copied >= size)
+		{
+			return path;
+		}
+
+		// Buffered
+		AutoFileSyncBuffer buffer = buffers.borrow(size - copied);
+		if (buffer.data == nullptr)
+		{
+			return AFSYNC_COPY_FAILED;
+		}
+		while (copied < size)
+		{
+			ssize_t n = pread(in, buffer.data, buffer.size, (off_t)copied);
+			if (n == 0)
+			{
+				size = copied;
+			}
+			if (n <= 0)
+			{
+				break;
+			}
+			ssize_t written = 0;
+			while (written < n)
+			{
+				ssize_t w = pwrite(out, buffer.data + written, (size_t)(n - written), (off_t)(copied + written));
+				if (w <= 0)
+				{
+					buffers.giveback(buffer);
+					return AFSYNC_COPY_FAILED;
+				}
+				written += w;
+			}
+			copied += (unsigned long long)n;
+		}
+		buffers.giveback(buffer);
+		return copied >= size ? AFSYNC_COPY_BUFFERED : AFSYNC_COPY_FAILED;
+	}
+#endif
+
+	// Constructor
+	AutoFileSyncCopyGate::AutoFileSyncCopyGate(long long cap) noexcept
+	{
+		this->_cap = cap;
+	}
+
+	// Wait for a free write on a device, and take it
+	void AutoFileSyncCopyGate::enter(unsigned long long dev) noexcept
+	{
+		std::unique_lock<std::mutex> lock(this->_mutex);
+		this->_cv.wait(lock, [&]() { return this->_cap <= 0 || this->_writes[dev] < this->_cap; });
+		++this->_writes[dev];
+	}
+
+	// Give back a write on a device
+	void AutoFileSyncCopyGate::leave(unsigned long long dev) noexcept
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			--this->_writes[dev];
+		}
+		this->_cv.notify_all();
+	}
+
+	// Name of a copy path ("reflink", "copy_file_range", ...)
+	const char* copy_name(AutoFileSyncCopyPath path) noexcept
+	{
+		switch (path)
+		{
+		case AFSYNC_COPY_REFLINK:
+			return "reflink";
+		case AFSYNC_COPY_RANGE:
+			return "copy_file_range";
+		case AFSYNC_COPY_SENDFILE:
+			return "sendfile";
+		case AFSYNC_COPY_BUFFERED:
+			return "buffered";
+		case AFSYNC_COPY_SYSTEM:
+			return "system";
+		case AFSYNC_COPY_DELTA:
+			return "delta";
+		case AFSYNC_COPY_COMPRESSED:
+			return "compressed";
+		case AFSYNC_COPY_STAGED:
+			return "staged";
+		case AFSYNC_COPY_FANOUT:
+			return "fanout";
+		default:
+			return "failed";
+		}
+	}
+
+	// Copy a file (overwritten if existing) with the cheapest path that works, keeping its mode and times
+	AutoFileSyncCopyPath copy_file(const std::string& from, const std::string& to, AutoFileSyncBufferPool* buffers) noexcept
+	{
+		static AutoFileSyncBufferPool shared;
+		AutoFileSyncBufferPool& pool = (buffers != nullptr ? *buffers : shared);
+
+#if defined(_WIN32)
+		(void)pool;
+		if (CopyFileExA(from.c_str(), to.c_str(), NULL, NULL, NULL, 0) == FALSE)
+		{
+			return AFSYNC_COPY_FAILED;
+		}
+		return AFSYNC_COPY_SYSTEM;
+
+#elif defined(__linux__)
+		int in = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+		if (in < 0)
+		{
+			return AFSYNC_COPY_FAILED;
+		}
+		struct stat st;
+		if (fstat(in, &st) != 0 || S_ISREG(st.st_mode) == false)
+		{
+			close(in);
+			return AFSYNC_COPY_FAILED;
+		}
+		int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 07777);
+		if (out < 0)
+		{
+			close(in);
+			return AFSYNC_COPY_FAILED;
+		}
+
+		// Reflink first, then the in kernel copies, then a buffer
+		AutoFileSyncCopyPath path = AFSYNC_COPY_FAILED;
+		if (ioctl(out, FICLONE, in) == 0)
+		{
+			path = AFSYNC_COPY_REFLINK;
+		}
+		else
+		{
+			path = _afsync_copy_fds(in, out, (unsigned long long)st.st_size, pool);
+		}
+
+		// Keep the times (the mode is already kept unless the target existed)
+		if (path != AFSYNC_COPY_FAILED)
+		{
+			struct timespec times[2] = { st.st_atim, st.st_mtim };
+			futimens(out, times);
+			fchmod(out, st.st_mode & 07777);
+		}
+		close(in);
+		if (close(out) != 0)
+		{
+			path = AFSYNC_COPY_FAILED;
+		}
+		return path;
+
+#else
+		(void)pool;
+		std::error_code ec;
+		std::filesystem::copy_file(from, to, std::filesystem::copy_options::overwrite_existing, ec);
+		if (ec)
+		{
+			return AFSYNC_COPY_FAILED;
+		}
+		std::filesystem::last_write_time(to, std::filesystem::last_write_time(from, ec), ec);
+		return AFSYNC_COPY_SYSTEM;
+
+#endif
+	}
+
+
+	// Copy a file as a reflink of its last version (base) patched with the changed blocks
+	AutoFileSyncCopyPath copy_delta(const std::string& from, const std::string& to, const std::string& base,
+		const AutoFileSyncDelta& delta, AutoFileSyncBufferPool* buffers) noexcept
+	{
+		static AutoFileSyncBufferPool shared;
+		AutoFileSyncBufferPool& pool = (buffers != nullptr ? *buffers : shared);
+
+#if defined(__linux__)
+		if (delta.blocksize == 0)
+		{
+			return AFSYNC_COPY_FAILED;
+		}
+
+		// The base has to be the version the blocks were compared with
+		int baseio = open(base.c_str(), O_RDONLY | O_CLOEXEC);
+		if (baseio < 0)
+		{
+			return AFSYNC_COPY_FAILED;
+		}
+		struct stat basest;
+		if (fstat(baseio, &basest) != 0 || (unsigned long long)basest.st_size != delta.basesize ||
+			(long long)basest.st_mtim.tv_sec * 1000000000LL + basest.st_mtim.tv_nsec != delta.basemtime)
+		{
+			close(baseio);
+			return AFSYNC_COPY_FAILED;
+		}
+
+		// Lambda to tell whether the file is still the version the blocks were computed from
+		auto compared = [&delta](const struct stat& st) -> bool
+		{
+			return (unsigned long long)st.st_size == delta.size &&
+				(long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec == delta.mtime;
+		};
+
+		int in = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+		struct stat st;
+		if (in < 0 || fstat(in, &st) != 0 || S_ISREG(st.st_mode) == false || compared(st) == false)
+		{
+			if (in >= 0)
+			{
+				close(in);
+			}
+			close(baseio);
+			return AFSYNC_COPY_FAILED;
+		}
+		int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 07777);
+		if (out < 0)
+		{
+			close(in);
+			close(baseio);
+			return AFSYNC_COPY_FAILED;
+		}
+
+		// Share the extents of the base, then overwrite the changed blocks and fit the size
+		bool succeeded = ioctl(out, FICLONE, baseio) == 0;
+		close(baseio);
+		unsigned long long size = (unsigned long long)st.st_size;
+		for (size_t i = 0; succeeded == true && i < delta.blocks.size(); ++i)
+		{
+			unsigned long long offset = delta.blocks[i] * delta.blocksize;
+			if (offset >= size)
+			{
+				break;
+			}
+			unsigned long long len = (size - offset < delta.blocksize ? size - offset : delta.blocksize);
+			succeeded = _afsync_copy_range(in, out, offset, len, pool);
+		}
+		if (succeeded == true)
+		{
+			succeeded = ftruncate(out, (off_t)size) == 0;
+		}
+
+		// Modified meanwhile, the blocks may not be the changed ones anymore
+		struct stat after;
+		if (succeeded == true && (fstat(in, &after) != 0 || compared(after) == false))
+		{
+			succeeded = false;
+		}
+
+		// Keep the times and mode
+		if (succeeded == true)
+		{
+			struct timespec times[2] = { st.st_atim, st.st_mtim };
+			futimens(out, times);
+			fchmod(out, st.st_mode & 07777);
+		}
+		close(in);
+		if (close(out) != 0)
+		{
+			succeeded = false;
+		}
+		return succeeded == true ? AFSYNC_COPY_DELTA : AFSYNC_COPY_FAILED;
+
+#else
+		// Block cloning (FSCTL_DUPLICATE_EXTENTS_TO_FILE) is not used here yet, copy it whole
+		(void)pool;
+		return AFSYNC_COPY_FAILED;
+
+#endif
+	}
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,98 @@
+// AutoFileSyncCopier.hpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <condition_variable>
+
+#include "AutoFileSyncBuffers.hpp"
+
+#pragma once
+
+#pragma warning (disable: 4018)
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4251)
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4661)
+#pragma warning (disable: 4715)
+#pragma warning (disable: 4804)
+#pragma warning (disable: 4819)
+#pragma warning (disable: 4919)
+#pragma warning (disable: 4996)
+#pragma warning (disable: 6031)
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Copy paths, from the cheapest
+	enum AutoFileSyncCopyPath : unsigned char
+	{
+		AFSYNC_COPY_FAILED = 0,
+		AFSYNC_COPY_REFLINK = 1,     // linux FICLONE, shares the extents (btrfs, xfs, ...), no data moved
+		AFSYNC_COPY_RANGE = 2,       // linux copy_file_range, in kernel (server-side on nfs/smb)
+		AFSYNC_COPY_SENDFILE = 3,    // linux sendfile, in kernel
+		AFSYNC_COPY_BUFFERED = 4,    // read and write through a pooled buffer
+		AFSYNC_COPY_SYSTEM = 5,      // the system copy (windows CopyFileEx, block cloning on ReFS)
+		AFSYNC_COPY_DELTA = 6,       // reflink of the last version, then only the changed blocks written
+		AFSYNC_COPY_COMPRESSED = 7,  // read, compressed (zstd or lz4) and written, see compress_file
+		AFSYNC_COPY_STAGED = 8,      // copied while hashed (hash_copy_file), then only moved in place
+		AFSYNC_COPY_FANOUT = 9,      // read once and written to every destination at once, see AutoFileSyncFanout
+		AFSYNC_COPY_PATHS = 10,
+	};
+
+	// class AutoFileSyncCopyGate
+	// Caps the copies writing to the same device at once (0 for no cap)
+	class AutoFileSyncCopyGate
+	{
+	private:
+		// Cap and copies writing per device
+		long long _cap = 0;
+		std::mutex _mutex;
+		std::condition_variable _cv;
+		std::unordered_map<unsigned long long, long long> _writes;
+
+	public:
+		// Constructor
+		AutoFileSyncCopyGate(long long cap = 0) noexcept;
+
+		// Wait for a free write on a device, and take it
+		void enter(unsigned long long dev) noexcept;
+
+		// Give back a write on a device
+		void leave(unsigned long long dev) noexcept;
+	};
+
+	// struct AutoFileSyncDelta
+	// Changed blocks of a file since its last version; both the file and its last version
+	// must still have the sizes and mtimes they had when the blocks were compared
+	struct AutoFileSyncDelta
+	{
+		unsigned int blocksize = 0;
+		std::vector<unsigned long long> blocks;
+		unsigned long long size = 0;
+		long long mtime = 0;
+		unsigned long long basesize = 0;
+		long long basemtime = 0;
+	};
+
+	// Name of a copy path ("reflink", "copy_file_range", ...)
+	const char* copy_name(AutoFileSyncCopyPath path) noexcept;
+
+	// Copy a file (overwritten if existing) with the cheapest path that works, keeping its mode and times
+	// Buffered copies go through a buffer borrowed from buffers (a process-wide pool if nullptr)
+	AutoFileSyncCopyPath copy_file(const std::string& from, const std::string& to,
+		AutoFileSyncBufferPool* buffers = nullptr) noexcept;
+
+	// Copy a file as a reflink of its last version (base) patched with the changed blocks,
+	// AFSYNC_COPY_FAILED if the base cannot be reflinked or is not the one compared (then copy it whole)
+	AutoFileSyncCopyPath copy_delta(const std::string& from, const std::string& to, const std::string& base,
+		const AutoFileSyncDelta& delta, AutoFileSyncBufferPool* buffers = nullptr) noexcept;
+
+}
+// Namespace AutoFileSync ends
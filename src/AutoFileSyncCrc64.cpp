@@ -0,0 +1,448 @@
+// AutoFileSyncCrc64.cpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <mutex>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define AFSYNC_CRC64_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+#endif
+
+// Per-function instruction sets (msvc does not need them)
+#if defined(AFSYNC_CRC64_X86) && !defined(_MSC_VER)
+#define AFSYNC_CRC64_TARGET(isa) __attribute__((target(isa)))
+#else
+#define AFSYNC_CRC64_TARGET(isa)
+#endif
+
+#include "Libs/CRC.hpp"
+
+#include "AutoFileSyncCrc64.hpp"
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Kernel - the selected crc64 variant, its tables and folding constants
+	// Note all in the reflected bit order: bit i of a word is the coefficient of x^(63-i)
+	struct _afsync_crc64_kernel
+	{
+		bool ready = false;
+		const char* name = "reference";
+		unsigned long long init = 0;
+		unsigned long long xorout = 0;
+		unsigned long long poly = 0;
+		unsigned long long table[16][256] = {};
+		unsigned long long k128[2] = {};     // fold 16 bytes forward (low, high qword)
+		unsigned long long k512[2] = {};     // fold 64 bytes forward
+		unsigned long long k2048[2] = {};    // fold 256 bytes forward
+		unsigned long long x2n[64] = {};     // x^(2^k) mod P, to shift a crc over any length
+		unsigned long long (*update)(unsigned long long, const unsigned char*, size_t) = nullptr;
+	};
+	_afsync_crc64_kernel _afsync_crc64;
+	std::once_flag _afsync_crc64_once;
+
+	// Utils (not headerable)
+	// Kernel - x^k mod P (reflected), P given by its reflected low 64 coefficients
+	inline unsigned long long _afsync_crc64_xpow(unsigned long long poly, unsigned int k) noexcept
+	{
+		unsigned long long v = 0x8000000000000000ULL;
+		for (unsigned int i = 0; i < k; ++i)
+		{
+			v = (v >> 1) ^ ((v & 1) ? poly : 0);
+		}
+		return v;
+	}
+
+	// Utils (not headerable)
+	// Kernel - a * b mod P (reflected), P given by its reflected low 64 coefficients
+	inline unsigned long long _afsync_crc64_mulmod(unsigned long long poly, unsigned long long a, unsigned long long b) noexcept
+	{
+		unsigned long long product = 0;
+		for (unsigned long long m = 0x8000000000000000ULL; m != 0 && a != 0; m >>= 1)
+		{
+			if ((a & m) != 0)
+			{
+				product ^= b;
+				a ^= m;
+			}
+			b = (b >> 1) ^ ((b & 1) ? poly : 0);
+		}
+		return product;
+	}
+
+	// Utils (not headerable)
+	// Kernel - build the tables and folding constants of a reflected polynomial
+	inline void _afsync_crc64_build(unsigned long long poly) noexcept
+	{
+		for (unsigned int b = 0; b < 256; ++b)
+		{
+			unsigned long long v = b;
+			for (int i = 0; i < 8; ++i)
+			{
+				v = (v >> 1) ^ ((v & 1) ? poly : 0);
+			}
+			_afsync_crc64.table[0][b] = v;
+		}
+		for (unsigned int t = 1; t < 16; ++t)
+		{
+			for (unsigned int b = 0; b < 256; ++b)
+			{
+				unsigned long long v = _afsync_crc64.table[t - 1][b];
+				_afsync_crc64.table[t][b] = (v >> 8) ^ _afsync_crc64.table[0][v & 0xff];
+			}
+		}
+
+		// Folding a 128-bit block (low qword L, high qword H) forward by N bits:
+		//   L * x^(N+64) + H * x^N  =  clmul(L, x^(N+63)) ^ clmul(H, x^(N-1))
+		// since a carry-less multiply of reflected operands carries an extra factor x
+		_afsync_crc64.k128[0] = _afsync_crc64_xpow(poly, 128 + 63);
+		_afsync_crc64.k128[1] = _afsync_crc64_xpow(poly, 128 - 1);
+		_afsync_crc64.k512[0] = _afsync_crc64_xpow(poly, 512 + 63);
+		_afsync_crc64.k512[1] = _afsync_crc64_xpow(poly, 512 - 1);
+		_afsync_crc64.k2048[0] = _afsync_crc64_xpow(poly, 2048 + 63);
+		_afsync_crc64.k2048[1] = _afsync_crc64_xpow(poly, 2048 - 1);
+
+		// Shifting a crc over n zero bits multiplies it by x^n, made of the squares x^(2^k)
+		_afsync_crc64.x2n[0] = _afsync_crc64_xpow(poly, 1);
+		for (unsigned int k = 1; k < 64; ++k)
+		{
+			_afsync_crc64.x2n[k] = _afsync_crc64_mulmod(poly, _afsync_crc64.x2n[k - 1], _afsync_crc64.x2n[k - 1]);
+		}
+		_afsync_crc64.poly = poly;
+	}
+
+	// Utils (not headerable)
+	// Kernel - portable slice-by-16 (little-endian loads)
+	inline unsigned long long _afsync_crc64_slice16(unsigned long long crc, const unsigned char* p, size_t len) noexcept
+	{
+		const unsigned long long(*t)[256] = _afsync_crc64.table;
+		while (len >= 16)
+		{
+			unsigned long long a, b;
+			memcpy(&a, p, 8);
+			memcpy(&b, p + 8, 8);
+			a ^= crc;
+			crc = t[15][a & 0xff] ^ t[14][(a >> 8) & 0xff] ^ t[13][(a >> 16) & 0xff] ^ t[12][(a >> 24) & 0xff] ^
+				t[11][(a >> 32) & 0xff] ^ t[10][(a >> 40) & 0xff] ^ t[9][(a >> 48) & 0xff] ^ t[8][a >> 56] ^
+				t[7][b & 0xff] ^ t[6][(b >> 8) & 0xff] ^ t[5][(b >> 16) & 0xff] ^ t[4][(b >> 24) & 0xff] ^
+				t[3][(b >> 32) & 0xff] ^ t[2][(b >> 40) & 0xff] ^ t[1][(b >> 48) & 0xff] ^ t[0][b >> 56];
+			p += 16;
+			len -= 16;
+		}
+		while (len > 0)
+		{
+			crc = t[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+			p++;
+			len--;
+		}
+		return crc;
+	}
+
+#if defined(AFSYNC_CRC64_X86)
+	// Utils (not headerable)
+	// Kernel - fold a 128-bit block forward and add the next one
+	AFSYNC_CRC64_TARGET("pclmul,sse4.1")
+	inline __m128i _afsync_crc64_fold(__m128i x, __m128i k, __m128i next) noexcept
+	{
+		return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11)), next);
+	}
+
+	// Utils (not headerable)
+	// Kernel - finish a folded 128-bit block: 16-byte folds, then tables for the block and the tail
+	AFSYNC_CRC64_TARGET("pclmul,sse4.1")
+	inline unsigned long long _afsync_crc64_finish(__m128i x, const unsigned char* p, size_t len) noexcept
+	{
+		const __m128i k128 = _mm_set_epi64x((long long)_afsync_crc64.k128[1], (long long)_afsync_crc64.k128[0]);
+		while (len >= 16)
+		{
+			x = _afsync_crc64_fold(x, k128, _mm_loadu_si128((const __m128i*)p));
+			p += 16;
+			len -= 16;
+		}
+
+		// The folded block is a 16-byte message that leaves the same crc from a zero state
+		alignas(16) unsigned char block[16];
+		_mm_store_si128((__m128i*)block, x);
+		unsigned long long crc = _afsync_crc64_slice16(0, block, 16);
+		return _afsync_crc64_slice16(crc, p, len);
+	}
+
+	// Utils (not headerable)
+	// Kernel - pclmulqdq, four 128-bit accumulators
+	AFSYNC_CRC64_TARGET("pclmul,sse4.1")
+	unsigned long long _afsync_crc64_pclmul(unsigned long long crc, const unsigned char* p, size_t len) noexcept
+	{
+		if (len < 64)
+		{
+			return _afsync_crc64_slice16(crc, p, len);
+		}
+
+		const __m128i k128 = _mm_set_epi64x((long long)_afsync_crc64.k128[1], (long long)_afsync_crc64.k128[0]);
+		const __m128i k512 = _mm_set_epi64x((long long)_afsync_crc64.k512[1], (long long)_afsync_crc64.k512[0]);
+
+		// The state joins the first 8 bytes of the message
+		__m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)p), _mm_set_epi64x(0, (long long)crc));
+		__m128i x1 = _mm_loadu_si128((const __m128i*)(p + 16));
+		__m128i x2 = _mm_loadu_si128((const __m128i*)(p + 32));
+		__m128i x3 = _mm_loadu_si128((const __m128i*)(p + 48));
+		p += 64;
+		len -= 64;
+
+		while (len >= 64)
+		{
+			x0 = _afsync_crc64_fold(x0, k512, _mm_loadu_si128((const __m128i*)p));
+			x1 = _afsync_crc64_fold(x1, k512, _mm_loadu_si128((const __m128i*)(p + 16)));
+			x2 = _afsync_crc64_fold(x2, k512, _mm_loadu_si128((const __m128i*)(p + 32)));
+			x3 = _afsync_crc64_fold(x3, k512, _mm_loadu_si128((const __m128i*)(p + 48)));
+			p += 64;
+			len -= 64;
+		}
+
+		// Four accumulators into one
+		__m128i x = _afsync_crc64_fold(x0, k128, x1);
+		x = _afsync_crc64_fold(x, k128, x2);
+		x = _afsync_crc64_fold(x, k128, x3);
+		return _afsync_crc64_finish(x, p, len);
+	}
+
+	// Utils (not headerable)
+	// Kernel - fold four 128-bit blocks forward and add the next ones
+	AFSYNC_CRC64_TARGET("avx512f,vpclmulqdq")
+	inline __m512i _afsync_crc64_fold512(__m512i z, __m512i k, __m512i next) noexcept
+	{
+		return _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(z, k, 0x00), _mm512_clmulepi64_epi128(z, k, 0x11), next, 0x96);
+	}
+
+	// Utils (not headerable)
+	// Kernel - vpclmulqdq, four 512-bit accumulators
+	AFSYNC_CRC64_TARGET("avx512f,vpclmulqdq,pclmul,sse4.1")
+	unsigned long long _afsync_crc64_vpclmul(unsigned long long crc, const unsigned char* p, size_t len) noexcept
+	{
+		if (len < 256)
+		{
+			return _afsync_crc64_pclmul(crc, p, len);
+		}
+
+		const __m512i k512 = _mm512_broadcast_i32x4(_mm_set_epi64x((long long)_afsync_crc64.k512[1], (long long)_afsync_crc64.k512[0]));
+		const __m512i k2048 = _mm512_broadcast_i32x4(_mm_set_epi64x((long long)_afsync_crc64.k2048[1], (long long)_afsync_crc64.k2048[0]));
+
+		// The state joins the first 8 bytes of the message
+		__m512i z0 = _mm512_xor_si512(_mm512_loadu_si512((const void*)p), _mm512_zextsi128_si512(_mm_set_epi64x(0, (long long)crc)));
+		__m512i z1 = _mm512_loadu_si512((const void*)(p + 64));
+		__m512i z2 = _mm512_loadu_si512((const void*)(p + 128));
+		__m512i z3 = _mm512_loadu_si512((const void*)(p + 192));
+		p += 256;
+		len -= 256;
+
+		while (len >= 256)
+		{
+			z0 = _afsync_crc64_fold512(z0, k2048, _mm512_loadu_si512((const void*)p));
+			z1 = _afsync_crc64_fold512(z1, k2048, _mm512_loadu_si512((const void*)(p + 64)));
+			z2 = _afsync_crc64_fold512(z2, k2048, _mm512_loadu_si512((const void*)(p + 128)));
+			z3 = _afsync_crc64_fold512(z3, k2048, _mm512_loadu_si512((const void*)(p + 192)));
+			p += 256;
+			len -= 256;
+		}
+
+		// Four accumulators into one, then 64 bytes at a time
+		__m512i z = _afsync_crc64_fold512(z0, k512, z1);
+		z = _afsync_crc64_fold512(z, k512, z2);
+		z = _afsync_crc64_fold512(z, k512, z3);
+		while (len >= 64)
+		{
+			z = _afsync_crc64_fold512(z, k512, _mm512_loadu_si512((const void*)p));
+			p += 64;
+			len -= 64;
+		}
+
+		// Four lanes into one
+		const __m128i k128 = _mm_set_epi64x((long long)_afsync_crc64.k128[1], (long long)_afsync_crc64.k128[0]);
+		__m128i x = _afsync_crc64_fold(_mm512_extracti32x4_epi32(z, 0), k128, _mm512_extracti32x4_epi32(z, 1));
+		x = _afsync_crc64_fold(x, k128, _mm512_extracti32x4_epi32(z, 2));
+		x = _afsync_crc64_fold(x, k128, _mm512_extracti32x4_epi32(z, 3));
+		return _afsync_crc64_finish(x, p, len);
+	}
+
+	// Utils (not headerable)
+	// Kernel - cpu features (and os support of the AVX-512 state)
+	inline void _afsync_crc64_cpu(bool& pclmul, bool& vpclmul) noexcept
+	{
+		unsigned int regs1[4] = {}, regs7[4] = {};
+	#if defined(_MSC_VER)
+		__cpuid((int*)regs1, 1);
+		__cpuidex((int*)regs7, 7, 0);
+	#else
+		__cpuid(1, regs1[0], regs1[1], regs1[2], regs1[3]);
+		__cpuid_count(7, 0, regs7[0], regs7[1], regs7[2], regs7[3]);
+	#endif
+		pclmul = (regs1[2] & (1U << 1)) != 0 && (regs1[2] & (1U << 19)) != 0;
+		vpclmul = false;
+
+		// AVX-512F and VPCLMULQDQ, with opmask/zmm states enabled by the os
+		bool osxsave = (regs1[2] & (1U << 27)) != 0;
+		if (pclmul && osxsave && (regs7[1] & (1U << 16)) != 0 && (regs7[2] & (1U << 10)) != 0)
+		{
+		#if defined(_MSC_VER)
+			unsigned long long xcr0 = _xgetbv(0);
+		#else
+			unsigned int eax = 0, edx = 0;
+			__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+			unsigned long long xcr0 = ((unsigned long long)edx << 32) | eax;
+		#endif
+			vpclmul = (xcr0 & 0xe6) == 0xe6;
+		}
+	}
+#endif
+
+	// Utils (not headerable)
+	// Kernel - find the crc64 variant of the reference and select the fastest kernel
+	inline void _afsync_crc64_select() noexcept
+	{
+		// Test message: pseudo-random bytes, several lengths and offsets
+		constexpr size_t testsize = 4096 + 77;
+		static unsigned char test[testsize];
+		unsigned long long seed = 0x9E3779B97F4A7C15ULL;
+		for (size_t i = 0; i < testsize; ++i)
+		{
+			seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+			test[i] = (unsigned char)(seed >> 56);
+		}
+		const size_t lengths[] = { 0, 1, 7, 8, 15, 16, 17, 63, 64, 65, 255, 256, 257, 1000, 4096 };
+		const size_t offsets[] = { 0, 1, 13, 77 };
+
+		// Known reflected crc64 variants (polynomial, init, xorout)
+		const unsigned long long variants[][3] =
+		{
+			{ 0xC96C5795D7870F42ULL, ~0ULL, ~0ULL },  // ECMA-182 (xz, go-ecma)
+			{ 0xC96C5795D7870F42ULL, 0ULL, 0ULL },
+			{ 0x95AC9329AC4BC9B5ULL, 0ULL, 0ULL },    // Jones (redis)
+			{ 0x95AC9329AC4BC9B5ULL, ~0ULL, ~0ULL },
+			{ 0xD800000000000000ULL, ~0ULL, ~0ULL },  // ISO (go-iso)
+			{ 0xD800000000000000ULL, 0ULL, 0ULL },
+		};
+
+		// Match the reference, also when fed in two pieces
+		for (const auto& variant : variants)
+		{
+			_afsync_crc64_build(variant[0]);
+			bool same = true;
+			for (size_t offset : offsets)
+			{
+				for (size_t len : lengths)
+				{
+					crc64_table state = crc64_init();
+					crc64_update(test + offset, len / 3, &state);
+					crc64_update(test + offset + len / 3, len - len / 3, &state);
+					unsigned long long expected = crc64_final(&state);
+					unsigned long long crc = _afsync_crc64_slice16(variant[1], test + offset, len);
+					same = same && (crc ^ variant[2]) == expected;
+				}
+			}
+			if (same == true)
+			{
+				_afsync_crc64.init = variant[1];
+				_afsync_crc64.xorout = variant[2];
+				_afsync_crc64.update = _afsync_crc64_slice16;
+				_afsync_crc64.name = "slice16";
+				_afsync_crc64.ready = true;
+				break;
+			}
+		}
+		if (_afsync_crc64.ready == false)
+		{
+			return;
+		}
+
+	#if defined(AFSYNC_CRC64_X86)
+		// Faster kernels, only if they agree with the portable one
+		auto agree = [&](unsigned long long (*kernel)(unsigned long long, const unsigned char*, size_t)) -> bool
+		{
+			for (size_t offset : offsets)
+			{
+				for (size_t len = 0; len + offset <= testsize; len += (len < 1100 ? 1 : 509))
+				{
+					if (kernel(_afsync_crc64.init, test + offset, len) != _afsync_crc64_slice16(_afsync_crc64.init, test + offset, len))
+					{
+						return false;
+					}
+				}
+			}
+			return true;
+		};
+		bool pclmul = false, vpclmul = false;
+		_afsync_crc64_cpu(pclmul, vpclmul);
+		if (pclmul == true && agree(_afsync_crc64_pclmul) == true)
+		{
+			_afsync_crc64.update = _afsync_crc64_pclmul;
+			_afsync_crc64.name = "pclmulqdq";
+
+			if (vpclmul == true && agree(_afsync_crc64_vpclmul) == true)
+			{
+				_afsync_crc64.update = _afsync_crc64_vpclmul;
+				_afsync_crc64.name = "vpclmulqdq";
+			}
+		}
+	#endif
+	}
+
+	// Whether the fast kernels reproduce the reference crc64
+	bool crc64_fast_ready() noexcept
+	{
+		std::call_once(_afsync_crc64_once, _afsync_crc64_select);
+		return _afsync_crc64.ready;
+	}
+
+	// Name of the selected kernel
+	const char* crc64_fast_kernel() noexcept
+	{
+		std::call_once(_afsync_crc64_once, _afsync_crc64_select);
+		return _afsync_crc64.name;
+	}
+
+	// Initial crc64 state
+	unsigned long long crc64_fast_init() noexcept
+	{
+		std::call_once(_afsync_crc64_once, _afsync_crc64_select);
+		return _afsync_crc64.init;
+	}
+
+	// Update a crc64 state with some bytes
+	void crc64_fast_update(unsigned long long& state, const void* data, size_t len) noexcept
+	{
+		state = _afsync_crc64.update(state, (const unsigned char*)data, len);
+	}
+
+	// Final crc64 of a state
+	unsigned long long crc64_fast_final(unsigned long long state) noexcept
+	{
+		return state ^ _afsync_crc64.xorout;
+	}
+
+	// State after a range of len bytes, given the state before it and the range's own state from zero
+	unsigned long long crc64_fast_combine(unsigned long long state, unsigned long long range, unsigned long long len) noexcept
+	{
+		// crc is linear: update(state, range) = update(state, zeros) ^ update(0, range),
+		// and feeding len zero bytes multiplies the state by x^(8 len)
+		unsigned long long bits = len * 8;
+		for (unsigned int k = 0; bits != 0 && state != 0; ++k, bits >>= 1)
+		{
+			if ((bits & 1) != 0)
+			{
+				state = _afsync_crc64_mulmod(_afsync_crc64.poly, state, _afsync_crc64.x2n[k]);
+			}
+		}
+		return state ^ range;
+	}
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,59 @@
+// AutoFileSyncCrc64.hpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <cstddef>
+
+#pragma once
+
+#pragma warning (disable: 4018)
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4251)
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4661)
+#pragma warning (disable: 4715)
+#pragma warning (disable: 4804)
+#pragma warning (disable: 4819)
+#pragma warning (disable: 4919)
+#pragma warning (disable: 4996)
+#pragma warning (disable: 6031)
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Fast crc64 kernels, selected at runtime
+	// 
+	// Kernels (fastest first, each one checked against the portable one before use):
+	//   vpclmulqdq  AVX-512 carry-less multiply, folding 256 bytes at a time
+	//   pclmulqdq   SSE carry-less multiply, folding 64 bytes at a time
+	//   slice16     portable, 16 table lookups per 16 bytes
+	// The crc parameters are taken from the reference crc64_init/crc64_update/crc64_final
+	// (Libs/CRC.hpp) by a self-test on first use, so results are bit-identical to it.
+	// If the reference is none of the known reflected crc64 variants, crc64_fast_ready()
+	// is false and the reference has to be used instead.
+
+	// Whether the fast kernels reproduce the reference crc64
+	bool crc64_fast_ready() noexcept;
+
+	// Name of the selected kernel
+	const char* crc64_fast_kernel() noexcept;
+
+	// Initial crc64 state
+	unsigned long long crc64_fast_init() noexcept;
+
+	// Update a crc64 state with some bytes
+	void crc64_fast_update(unsigned long long& state, const void* data, size_t len) noexcept;
+
+	// Final crc64 of a state
+	unsigned long long crc64_fast_final(unsigned long long state) noexcept;
+
+	// State after a range of len bytes, given the state before it and the range's own state from zero
+	// Note ranges hashed apart (each from crc64_fast_update on a zero state) chain back into the
+	// state of the whole, so a large file can be hashed in parallel to the same crc
+	unsigned long long crc64_fast_combine(unsigned long long state, unsigned long long range, unsigned long long len) noexcept;
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,355 @@
+// AutoFileSyncExcluder.cpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <cstring>
+#include <fstream>
+
+#include "AutoFileSyncExcluder.hpp"
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Program tokens, a byte (0 to 255) matches itself
+	constexpr int _afsync_glob_any = -1;          // ?, a character but a slash
+	constexpr int _afsync_glob_star = -2;         // *, any characters but slashes
+	constexpr int _afsync_glob_dirs = -3;         // **/, zero or more folders
+	constexpr int _afsync_glob_inside = -4;       // /** at the end, anything inside
+	constexpr int _afsync_glob_class = -100;      // [...], _afsync_glob_class - its index
+
+	// Add a rule, false if the line holds no rule (blank or a comment)
+	bool AutoFileSyncExcluder::add(const std::string& line) noexcept
+	{
+		std::string pattern = line;
+		while (pattern.empty() == false && (pattern.back() == '\r' || pattern.back() == '\n'))
+		{
+			pattern.pop_back();
+		}
+
+		// Trailing spaces are dropped unless escaped
+		while (pattern.empty() == false && pattern.back() == ' ' &&
+			(pattern.size() < 2 || pattern[pattern.size() - 2] != '\\'))
+		{
+			pattern.pop_back();
+		}
+		if (pattern.empty() == true || pattern[0] == '#')
+		{
+			return false;
+		}
+
+		_rule rule;
+		if (pattern[0] == '!')
+		{
+			rule.negated = true;
+			pattern.erase(0, 1);
+		}
+		if (pattern.empty() == false && pattern.back() == '/')
+		{
+			rule.dironly = true;
+			while (pattern.empty() == false && pattern.back() == '/')
+			{
+				pattern.pop_back();
+			}
+		}
+		rule.anchored = pattern.find('/') != std::string::npos;
+		if (pattern.empty() == false && pattern[0] == '/')
+		{
+			pattern.erase(0, 1);
+		}
+		if (pattern.empty() == true)
+		{
+			return false;
+		}
+
+		// Compile
+		bool plain = true;
+		for (size_t i = 0; i < pattern.size(); ++i)
+		{
+			char c = pattern[i];
+			if (c == '\\' && i + 1 < pattern.size())
+			{
+				rule.program.push_back((unsigned char)pattern[++i]);
+			}
+			else if (c == '?')
+			{
+				rule.program.push_back(_afsync_glob_any);
+				plain = false;
+			}
+			else if (c == '*')
+			{
+				size_t stars = 1;
+				while (i + 1 < pattern.size() && pattern[i + 1] == '*')
+				{
+					++stars;
+					++i;
+				}
+				bool segment = (i + 1 - stars == 0 || pattern[i - stars] == '/');
+				if (stars >= 2 && segment == true && i + 1 < pattern.size() && pattern[i + 1] == '/')
+				{
+					rule.program.push_back(_afsync_glob_dirs);
+					++i;
+				}
+				else if (stars >= 2 && segment == true && i + 1 == pattern.size() && rule.program.empty() == false)
+				{
+					rule.program.back() = _afsync_glob_inside;
+				}
+				else
+				{
+					rule.program.push_back(_afsync_glob_star);
+				}
+				plain = false;
+			}
+			else if (c == '[' && pattern.find(']', i + 2) != std::string::npos)
+			{
+				// [!...] or [^...] negates, a ] first is a member, a-z a range
+				std::bitset<256> members;
+				size_t j = i + 1;
+				bool negated = (pattern[j] == '!' || pattern[j] == '^');
+				if (negated == true)
+				{
+					++j;
+				}
+				size_t first = j;
+				for (; j < pattern.size() && (pattern[j] != ']' || j == first); ++j)
+				{
+					unsigned char lo = (unsigned char)pattern[j];
+					if (lo == '\\' && j + 1 < pattern.size())
+					{
+						lo = (unsigned char)pattern[++j];
+					}
+					unsigned char hi = lo;
+					if (j + 2 < pattern.size() && pattern[j + 1] == '-' && pattern[j + 2] != ']')
+					{
+						hi = (unsigned char)pattern[j + 2];
+						j += 2;
+					}
+					for (unsigned int k = lo; k <= hi; ++k)
+					{
+						members.set(k);
+					}
+				}
+				if (j >= pattern.size())
+				{
+					rule.program.push_back((unsigned char)c);
+					continue;
+				}
+				if (negated == true)
+				{
+					members.flip();
+				}
+				members.reset('/');
+				rule.program.push_back(_afsync_glob_class - (int)this->_classes.size());
+				this->_classes.push_back(members);
+				i = j;
+				plain = false;
+			}
+			else
+			{
+				rule.program.push_back((unsigned char)c);
+			}
+		}
+
+		// File it by its shape
+		unsigned int index = (unsigned int)this->_rules.size();
+		std::string literal;
+		for (int token : rule.program)
+		{
+			if (token >= 0)
+			{
+				literal.push_back((char)token);
+			}
+		}
+		if (plain == true && rule.anchored == false)
+		{
+			this->_byname[literal].push_back(index);
+		}
+		else if (plain == true)
+		{
+			this->_bypath[literal].push_back(index);
+		}
+		else if (rule.anchored == false && rule.program.size() >= 2 && rule.program[0] == _afsync_glob_star &&
+			literal.size() + 1 == rule.program.size() && literal[0] == '.' && literal.find('.', 1) == std::string::npos)
+		{
+			this->_byextension[literal].push_back(index);
+		}
+		else
+		{
+			this->_wildcards.push_back(index);
+		}
+		this->_rules.emplace_back(std::move(rule));
+		return true;
+	}
+
+	// Add the rules of a file, a rule per line, false if it cannot be read
+	bool AutoFileSyncExcluder::load(const std::string& path) noexcept
+	{
+		std::ifstream in(path, std::ios::binary);
+		if (!in)
+		{
+			return false;
+		}
+		std::string line;
+		while (std::getline(in, line))
+		{
+			this->add(line);
+		}
+		return true;
+	}
+
+	// Whether there is no rule
+	bool AutoFileSyncExcluder::empty() const noexcept
+	{
+		return this->_rules.empty();
+	}
+
+	// Whether a path relative to the src (forward slashes) is excluded
+	bool AutoFileSyncExcluder::excluded(std::string_view relpath, bool isdir) const noexcept
+	{
+		if (this->_rules.empty() == true)
+		{
+			return false;
+		}
+		size_t slash = relpath.find_last_of('/');
+		std::string_view name = (slash == std::string_view::npos ? relpath : relpath.substr(slash + 1));
+		size_t dot = name.find_last_of('.');
+
+		// Candidates, each list in rule order
+		const std::vector<unsigned int>* lists[4] = { &this->_wildcards, nullptr, nullptr, nullptr };
+		auto found = this->_byname.find(std::string(name));
+		if (found != this->_byname.end())
+		{
+			lists[1] = &found->second;
+		}
+		found = this->_bypath.find(std::string(relpath));
+		if (found != this->_bypath.end())
+		{
+			lists[2] = &found->second;
+		}
+		if (dot != std::string_view::npos && this->_byextension.empty() == false)
+		{
+			found = this->_byextension.find(std::string(name.substr(dot)));
+			if (found != this->_byextension.end())
+			{
+				lists[3] = &found->second;
+			}
+		}
+
+		// The last matching rule decides, so walk the candidates backwards
+		size_t left[4] = { 0, 0, 0, 0 };
+		for (int k = 0; k < 4; ++k)
+		{
+			left[k] = (lists[k] != nullptr ? lists[k]->size() : 0);
+		}
+		while (true)
+		{
+			int best = -1;
+			for (int k = 0; k < 4; ++k)
+			{
+				if (left[k] > 0 && (best < 0 || (*lists[k])[left[k] - 1] > (*lists[best])[left[best] - 1]))
+				{
+					best = k;
+				}
+			}
+			if (best < 0)
+			{
+				return false;
+			}
+			const _rule& rule = this->_rules[(*lists[best])[--left[best]]];
+			if (rule.dironly == true && isdir == false)
+			{
+				continue;
+			}
+
+			// Only wildcards have to run, the others matched by their lookup
+			if (best == 0)
+			{
+				std::string_view text = (rule.anchored ? relpath : name);
+				if (this->_match(rule.program.data(), rule.program.data() + rule.program.size(), text.data(), text.data() + text.size()) == false)
+				{
+					continue;
+				}
+			}
+			return rule.negated == false;
+		}
+	}
+
+	// Whether a rule program matches a text
+	bool AutoFileSyncExcluder::_match(const int* program, const int* end, const char* text, const char* textend) const noexcept
+	{
+		while (program < end)
+		{
+			int token = *program;
+			if (token >= 0)
+			{
+				if (text == textend || (unsigned char)*text != token)
+				{
+					return false;
+				}
+				++text;
+			}
+			else if (token == _afsync_glob_any)
+			{
+				if (text == textend || *text == '/')
+				{
+					return false;
+				}
+				++text;
+			}
+			else if (token == _afsync_glob_star)
+			{
+				// Try every length within the current folder name
+				if (program + 1 == end)
+				{
+					return std::memchr(text, '/', textend - text) == nullptr;
+				}
+				for (;; ++text)
+				{
+					if (this->_match(program + 1, end, text, textend) == true)
+					{
+						return true;
+					}
+					if (text == textend || *text == '/')
+					{
+						return false;
+					}
+				}
+			}
+			else if (token == _afsync_glob_dirs)
+			{
+				// Try zero folders, then after every slash
+				for (;;)
+				{
+					if (this->_match(program + 1, end, text, textend) == true)
+					{
+						return true;
+					}
+					const char* slash = (const char*)std::memchr(text, '/', textend - text);
+					if (slash == nullptr)
+					{
+						return false;
+					}
+					text = slash + 1;
+				}
+			}
+			else if (token == _afsync_glob_inside)
+			{
+				return textend - text >= 2 && *text == '/';
+			}
+			else
+			{
+				if (text == textend || this->_classes[_afsync_glob_class - token].test((unsigned char)*text) == false)
+				{
+					return false;
+				}
+				++text;
+			}
+			++program;
+		}
+		return text == textend;
+	}
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,85 @@
+// AutoFileSyncExcluder.hpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <bitset>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+
+#pragma once
+
+#pragma warning (disable: 4018)
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4251)
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4661)
+#pragma warning (disable: 4715)
+#pragma warning (disable: 4804)
+#pragma warning (disable: 4819)
+#pragma warning (disable: 4919)
+#pragma warning (disable: 4996)
+#pragma warning (disable: 6031)
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// class AutoFileSyncExcluder
+	// Exclusion rules with the gitignore syntax, matched against paths relative to the src
+	//
+	//   node_modules/   a folder of this name at any depth (trailing slash, folders only)
+	//   *.tmp           a file or folder whose name matches, at any depth (no slash)
+	//   /build          build at the top level only (leading or middle slash, whole path)
+	//   build/**        everything inside build, docs/**/tmp any depth between
+	//   !keep.tmp       re-includes what an earlier rule excluded (the last matching rule wins)
+	//
+	// Every rule is compiled once into a small program (* and ? stop at slashes, [a-z] classes,
+	// backslash escapes). Rules that are a plain name, a plain path or a plain extension (*.ext)
+	// are looked up by hashing, so a path costs a few lookups plus the rules with real wildcards.
+	// A folder excluded while walking is never opened, so nothing inside can be re-included.
+	class AutoFileSyncExcluder
+	{
+	private:
+		// A compiled rule
+		struct _rule
+		{
+			std::vector<int> program;
+			bool negated = false;
+			bool dironly = false;
+			bool anchored = false;   // matched against the whole path, otherwise against the name
+		};
+
+		// Rules in order and the character classes of their programs
+		std::vector<_rule> _rules;
+		std::vector<std::bitset<256>> _classes;
+
+		// Rules (in order) by plain name, by plain path, by plain extension, and the others
+		std::unordered_map<std::string, std::vector<unsigned int>> _byname;
+		std::unordered_map<std::string, std::vector<unsigned int>> _bypath;
+		std::unordered_map<std::string, std::vector<unsigned int>> _byextension;
+		std::vector<unsigned int> _wildcards;
+
+	public:
+		// Add a rule, false if the line holds no rule (blank or a comment)
+		bool add(const std::string& line) noexcept;
+
+		// Add the rules of a file, a rule per line, false if it cannot be read
+		bool load(const std::string& path) noexcept;
+
+		// Whether there is no rule
+		bool empty() const noexcept;
+
+		// Whether a path relative to the src (forward slashes) is excluded
+		bool excluded(std::string_view relpath, bool isdir) const noexcept;
+
+	private:
+		// Whether a rule program matches a text
+		bool _match(const int* program, const int* end, const char* text, const char* textend) const noexcept;
+	};
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,258 @@
+// AutoFileSyncFanout.cpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <filesystem>
+
+#include "AutoFileSyncReader.hpp"
+#include "AutoFileSyncFanout.hpp"
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Utils (not headerable)
+	// Kernel - keep the mode and times of a file on another
+	inline void _afsync_util_fanout_keep(const std::string& from, const std::string& to) noexcept
+	{
+		std::error_code ec;
+		std::filesystem::permissions(to, std::filesystem::status(from, ec).permissions(), ec);
+		std::filesystem::last_write_time(to, std::filesystem::last_write_time(from, ec), ec);
+	}
+
+	// Constructor, writers per destination and bytes queued per destination at most (at least a chunk)
+	AutoFileSyncFanout::AutoFileSyncFanout(size_t destinations, size_t writers, unsigned long long budget) noexcept
+	{
+		writers = (writers < 1 ? 1 : writers);
+		this->_budget = budget;
+		for (size_t d = 0; d < destinations; ++d)
+		{
+			this->_destinations.push_back(std::make_unique<_destination>());
+			for (size_t w = 0; w < writers; ++w)
+			{
+				this->_destinations[d]->writers.push_back(std::make_unique<_writer>());
+			}
+		}
+		for (size_t d = 0; d < destinations; ++d)
+		{
+			for (size_t w = 0; w < writers; ++w)
+			{
+				this->_destinations[d]->writers[w]->thread = std::thread([this, d, w]() { this->_work(d, w); });
+			}
+		}
+	}
+
+	// Destructor, stops the writers once their queues are written
+	AutoFileSyncFanout::~AutoFileSyncFanout() noexcept
+	{
+		for (auto& destination : this->_destinations)
+		{
+			for (auto& writer : destination->writers)
+			{
+				std::lock_guard<std::mutex> lock(writer->mutex);
+				this->_stop = true;
+				writer->cv.notify_all();
+			}
+		}
+		for (auto& destination : this->_destinations)
+		{
+			for (auto& writer : destination->writers)
+			{
+				if (writer->thread.joinable() == true)
+				{
+					writer->thread.join();
+				}
+			}
+		}
+	}
+
+	// Destinations
+	size_t AutoFileSyncFanout::destinations() const noexcept
+	{
+		return this->_destinations.size();
+	}
+
+	// Copy a file to a target per destination ("" to skip one, overwritten if existing) keeping its mode and times,
+	// false if it cannot be read; written gets whether each target was written whole
+	bool AutoFileSyncFanout::copy(const std::string& from, const std::vector<std::string>& targets,
+		AutoFileSyncBufferPool& buffers, std::vector<char>& written) noexcept
+	{
+		const size_t count = this->_destinations.size();
+		written.assign(count, 0);
+
+		// Targets, all written by the same writer of their destinations
+		std::vector<std::shared_ptr<_target>> files(count);
+		const size_t turn = this->_turn.fetch_add(1);
+		size_t active = 0;
+		for (size_t d = 0; d < count && d < targets.size(); ++d)
+		{
+			if (targets[d] != "")
+			{
+				files[d] = std::make_shared<_target>();
+				files[d]->path = targets[d];
+				++active;
+			}
+		}
+		if (active == 0)
+		{
+			return true;
+		}
+
+		// Lambda to tell whether a destination can take a chunk within its budget (always when it holds nothing)
+		auto within = [this](size_t d, size_t len) -> bool
+		{
+			unsigned long long queued = this->_destinations[d]->queued.load();
+			return queued == 0 || queued + len <= this->_budget;
+		};
+
+		std::error_code ec;
+		unsigned long long sizehint = std::filesystem::file_size(from, ec);
+		bool read = read_file(from, buffers, ec ? ~0ULL : sizehint, 2, [&](unsigned char* data, size_t len)
+			{
+				// Wait only if every destination still taking the file is over its budget
+				{
+					std::unique_lock<std::mutex> lock(this->_mutex);
+					this->_cv.wait(lock, [&]()
+						{
+							for (size_t d = 0; d < count; ++d)
+							{
+								if (files[d] != nullptr && files[d]->dropped == false && within(d, len) == true)
+								{
+									return true;
+								}
+							}
+							return false;
+						});
+				}
+
+				// Share the chunk, leave the destinations over their budget behind (never all of them,
+				// other files may have filled the budgets again since the wait)
+				std::vector<char> taking(count, 0);
+				bool any = false;
+				for (size_t d = 0; d < count; ++d)
+				{
+					if (files[d] != nullptr && files[d]->dropped == false)
+					{
+						taking[d] = (within(d, len) == true ? 1 : 0);
+						any = (any == true || taking[d] != 0);
+					}
+				}
+				auto chunk = std::make_shared<std::vector<unsigned char>>(data, data + len);
+				for (size_t d = 0; d < count; ++d)
+				{
+					if (files[d] == nullptr || files[d]->dropped == true)
+					{
+						continue;
+					}
+					size_t w = turn % this->_destinations[d]->writers.size();
+					if (taking[d] == 0 && any == true)
+					{
+						files[d]->dropped = true;
+						this->_queue(d, w, _write{ files[d], nullptr, true });
+						continue;
+					}
+					this->_destinations[d]->queued += len;
+					this->_queue(d, w, _write{ files[d], chunk, false });
+				}
+			});
+
+		// End the targets, dropping them all if the file could not be read
+		for (size_t d = 0; d < count; ++d)
+		{
+			if (files[d] != nullptr && files[d]->dropped == false)
+			{
+				files[d]->dropped = (read == false);
+				this->_queue(d, turn % this->_destinations[d]->writers.size(), _write{ files[d], nullptr, read == false });
+			}
+		}
+		for (size_t d = 0; d < count; ++d)
+		{
+			if (files[d] == nullptr)
+			{
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(files[d]->mutex);
+			files[d]->cv.wait(lock, [&]() { return files[d]->done == true; });
+			written[d] = (files[d]->written == true ? 1 : 0);
+			lock.unlock();
+			if (written[d] != 0)
+			{
+				_afsync_util_fanout_keep(from, files[d]->path);
+			}
+		}
+		return read;
+	}
+
+	// Queue a write to a writer
+	void AutoFileSyncFanout::_queue(size_t destination, size_t writer, _write&& write) noexcept
+	{
+		_writer& target = *this->_destinations[destination]->writers[writer];
+		std::lock_guard<std::mutex> lock(target.mutex);
+		target.writes.push_back(std::move(write));
+		target.cv.notify_one();
+	}
+
+	// A writer, writing its queue until stopped
+	void AutoFileSyncFanout::_work(size_t destination, size_t writer) noexcept
+	{
+		_destination& owner = *this->_destinations[destination];
+		_writer& self = *owner.writers[writer];
+		while (true)
+		{
+			_write write;
+			{
+				std::unique_lock<std::mutex> lock(self.mutex);
+				self.cv.wait(lock, [&]() { return this->_stop == true || self.writes.empty() == false; });
+				if (self.writes.empty() == true)
+				{
+					return;
+				}
+				write = std::move(self.writes.front());
+				self.writes.pop_front();
+			}
+			_target& target = *write.target;
+
+			// Chunk, in file order since the file has this writer only
+			if (write.chunk != nullptr)
+			{
+				if (target.opened == false)
+				{
+					target.out.open(target.path, std::ios::binary | std::ios::trunc);
+					target.opened = true;
+				}
+				target.out.write((const char*)write.chunk->data(), write.chunk->size());
+				owner.queued -= write.chunk->size();
+				write.chunk.reset();
+				std::lock_guard<std::mutex> lock(this->_mutex);
+				this->_cv.notify_all();
+				continue;
+			}
+
+			// End, closed (created if empty) or dropped (removed)
+			if (target.opened == false && write.drop == false)
+			{
+				target.out.open(target.path, std::ios::binary | std::ios::trunc);
+				target.opened = true;
+			}
+			bool written = false;
+			if (target.opened == true)
+			{
+				target.out.close();
+				written = (write.drop == false && target.out.fail() == false);
+				if (written == false)
+				{
+					std::error_code ec;
+					std::filesystem::remove(target.path, ec);
+				}
+			}
+			std::lock_guard<std::mutex> lock(target.mutex);
+			target.written = written;
+			target.done = true;
+			target.cv.notify_all();
+		}
+	}
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,129 @@
+// AutoFileSyncFanout.hpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <condition_variable>
+
+#include "AutoFileSyncBuffers.hpp"
+
+#pragma once
+
+#pragma warning (disable: 4018)
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4251)
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4661)
+#pragma warning (disable: 4715)
+#pragma warning (disable: 4804)
+#pragma warning (disable: 4819)
+#pragma warning (disable: 4919)
+#pragma warning (disable: 4996)
+#pragma warning (disable: 6031)
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// class AutoFileSyncFanout
+	// Files read once and written to a target in every destination at once
+	//
+	// Every destination has its own writer threads, each with its own queue, and a chunk read
+	// from the source is shared by the queues of all destinations (freed once the last one
+	// wrote it). The chunks of a file go to one writer of each destination, so they are written
+	// in order while other files are written by the other writers. A destination whose queues
+	// already hold its budget of bytes is left behind for that file instead of stalling the
+	// others (its target is removed and reported as not written, to be copied later from a
+	// target that was), unless every destination of the file is, then the read waits.
+	class AutoFileSyncFanout
+	{
+	private:
+		// Target of a file in a destination, written by one writer
+		struct _target
+		{
+			std::string path = "";
+			std::ofstream out;
+			bool opened = false;
+			bool dropped = false;
+
+			// Done (closed or removed) and whether it was written whole
+			std::mutex mutex;
+			std::condition_variable cv;
+			bool done = false;
+			bool written = false;
+		};
+
+		// Write of a chunk to a target, or its end (no chunk) if closing or dropping it
+		struct _write
+		{
+			std::shared_ptr<_target> target;
+			std::shared_ptr<std::vector<unsigned char>> chunk;
+			bool drop = false;
+		};
+
+		// Writer of a destination and its queue
+		struct _writer
+		{
+			std::mutex mutex;
+			std::condition_variable cv;
+			std::deque<_write> writes;
+			std::thread thread;
+		};
+
+		// Destination, its writers and the bytes queued to them
+		struct _destination
+		{
+			std::vector<std::unique_ptr<_writer>> writers;
+			std::atomic<unsigned long long> queued = 0;
+		};
+
+		// Destinations, the budget of bytes queued per destination, and the next writer to take a file
+		std::vector<std::unique_ptr<_destination>> _destinations;
+		unsigned long long _budget = 0;
+		std::atomic<size_t> _turn = 0;
+
+		// Signaled whenever a write is done, for reads waiting on the budget
+		std::mutex _mutex;
+		std::condition_variable _cv;
+
+		// Stop signal of the writers
+		std::atomic<bool> _stop = false;
+
+	public:
+		// Constructor, writers per destination and bytes queued per destination at most (at least a chunk)
+		AutoFileSyncFanout(size_t destinations, size_t writers = 2, unsigned long long budget = 64 * 1024 * 1024) noexcept;
+
+		// Destructor, stops the writers once their queues are written
+		~AutoFileSyncFanout() noexcept;
+
+		// Copy constructor = delete
+		AutoFileSyncFanout(const AutoFileSyncFanout& y) noexcept = delete;
+		AutoFileSyncFanout& operator=(const AutoFileSyncFanout& y) noexcept = delete;
+
+		// Destinations
+		size_t destinations() const noexcept;
+
+		// Copy a file to a target per destination ("" to skip one, overwritten if existing) keeping its mode and times,
+		// false if it cannot be read; written gets whether each target was written whole
+		bool copy(const std::string& from, const std::vector<std::string>& targets,
+			AutoFileSyncBufferPool& buffers, std::vector<char>& written) noexcept;
+
+	private:
+		// Queue a write to a writer
+		void _queue(size_t destination, size_t writer, _write&& write) noexcept;
+
+		// A writer, writing its queue until stopped
+		void _work(size_t destination, size_t writer) noexcept;
+	};
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,120 @@
+// AutoFileSyncFilestat.cpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "AutoFileSyncFilestat.hpp"
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Fill the stat tuple of a record (hash untouched), false if not a regular file
+	bool filestat(const std::string& filepath, AutoFileSyncRecord& record) noexcept
+	{
+#if defined(_WIN32)
+		// FILETIME counts 100ns ticks since 1601-01-01
+		constexpr long long epoch_diff = 116444736000000000LL;
+		auto filetime_ns = [](long long ticks) -> long long
+		{
+			return (ticks - epoch_diff) * 100;
+		};
+
+		// Open for attributes only, it never blocks writers
+		HANDLE handle = CreateFileA(filepath.c_str(), FILE_READ_ATTRIBUTES,
+			FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (handle == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		BY_HANDLE_FILE_INFORMATION info;
+		FILE_BASIC_INFO basic;
+		if (GetFileInformationByHandle(handle, &info) == FALSE ||
+			GetFileInformationByHandleEx(handle, FileBasicInfo, &basic, sizeof(basic)) == FALSE ||
+			(info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+		{
+			CloseHandle(handle);
+			return false;
+		}
+		CloseHandle(handle);
+
+		record.size = ((unsigned long long)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+		record.mtime = filetime_ns(basic.LastWriteTime.QuadPart);
+		record.ctime = filetime_ns(basic.ChangeTime.QuadPart);
+		record.inode = ((unsigned long long)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+		record.dev = info.dwVolumeSerialNumber;
+		return true;
+
+#else
+		struct stat st;
+		if (stat(filepath.c_str(), &st) != 0 || S_ISREG(st.st_mode) == false)
+		{
+			return false;
+		}
+
+		record.size = (unsigned long long)st.st_size;
+	#if defined(__APPLE__)
+		record.mtime = (long long)st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+		record.ctime = (long long)st.st_ctimespec.tv_sec * 1000000000LL + st.st_ctimespec.tv_nsec;
+	#else
+		record.mtime = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+		record.ctime = (long long)st.st_ctim.tv_sec * 1000000000LL + st.st_ctim.tv_nsec;
+	#endif
+		record.inode = (unsigned long long)st.st_ino;
+		record.dev = (unsigned long long)st.st_dev;
+		return true;
+
+#endif
+	}
+
+	// Whether two records share the same stat tuple (then the contents are assumed the same)
+	bool filestat_same(const AutoFileSyncRecord& x, const AutoFileSyncRecord& y) noexcept
+	{
+		return x.size == y.size && x.mtime == y.mtime && x.ctime == y.ctime &&
+			x.inode == y.inode && x.dev == y.dev;
+	}
+
+	// Device (volume) holding a file or a folder, the same value as AutoFileSyncRecord::dev
+	bool filedevice(const std::string& path, unsigned long long& dev) noexcept
+	{
+#if defined(_WIN32)
+		// Backup semantics to open folders as well
+		HANDLE handle = CreateFileA(path.c_str(), FILE_READ_ATTRIBUTES,
+			FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+		if (handle == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		BY_HANDLE_FILE_INFORMATION info;
+		bool got = GetFileInformationByHandle(handle, &info) != FALSE;
+		CloseHandle(handle);
+		if (got == false)
+		{
+			return false;
+		}
+		dev = info.dwVolumeSerialNumber;
+		return true;
+
+#else
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0)
+		{
+			return false;
+		}
+		dev = (unsigned long long)st.st_dev;
+		return true;
+
+#endif
+	}
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,55 @@
+// AutoFileSyncFilestat.hpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <memory>
+#include <string>
+
+#include "AutoFileSyncHasher.hpp"
+
+#pragma once
+
+#pragma warning (disable: 4018)
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4251)
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4661)
+#pragma warning (disable: 4715)
+#pragma warning (disable: 4804)
+#pragma warning (disable: 4819)
+#pragma warning (disable: 4919)
+#pragma warning (disable: 4996)
+#pragma warning (disable: 6031)
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// struct AutoFileSyncRecord
+	// A monitored file: its digest and the stat tuple the digest was computed from
+	// Note times are in nanoseconds since the unix epoch on every platform
+	struct AutoFileSyncRecord
+	{
+		AutoFileSyncDigest hash;         // digest of the contents (and its algorithm)
+		unsigned long long size = 0;     // file size in bytes
+		long long mtime = 0;             // last modification time
+		long long ctime = 0;             // last status (metadata) change time
+		unsigned long long inode = 0;    // inode (file index on windows)
+		unsigned long long dev = 0;      // device (volume serial on windows)
+		bool racy = false;               // modified too close to hashing to trust the times
+		std::shared_ptr<const AutoFileSyncBlockSums> blocks; // per-block sums (delta snapshots), or none
+	};
+
+	// Fill the stat tuple of a record (hash untouched), false if not a regular file
+	bool filestat(const std::string& filepath, AutoFileSyncRecord& record) noexcept;
+
+	// Whether two records share the same stat tuple (then the contents are assumed the same)
+	bool filestat_same(const AutoFileSyncRecord& x, const AutoFileSyncRecord& y) noexcept;
+
+	// Device (volume) holding a file or a folder, the same value as AutoFileSyncRecord::dev
+	bool filedevice(const std::string& path, unsigned long long& dev) noexcept;
+
+}
+// Namespace AutoFileSync ends
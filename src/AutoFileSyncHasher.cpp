@@ -0,0 +1,728 @@
+// AutoFileSyncHasher.cpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <fstream>
+#include <filesystem>
+
+#include "Libs/CRC.hpp"
+
+// Optional hash libraries, compiled in when present
+#if __has_include("Libs/xxhash.h")
+#define XXH_INLINE_ALL
+#include "Libs/xxhash.h"
+#define AFSYNC_HASH_WITH_XXH3 1
+#endif
+#if __has_include("Libs/blake3.h")
+#include "Libs/blake3.h"
+#define AFSYNC_HASH_WITH_BLAKE3 1
+#endif
+
+#include "AutoFileSyncCrc64.hpp"
+#include "AutoFileSyncHasher.hpp"
+#include "AutoFileSyncReader.hpp"
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Hash engine policy - crc64 (fast kernels when they reproduce Libs/CRC.hpp)
+	struct _afsync_hash_engine_crc64
+	{
+		static constexpr AutoFileSyncHashAlgo algo = AFSYNC_HASH_CRC64;
+
+		const bool fast = crc64_fast_ready();
+		unsigned long long faststate = crc64_fast_init();
+		crc64_table state = crc64_init();
+
+		void update(unsigned char* data, size_t len) noexcept
+		{
+			if (fast == true)
+			{
+				crc64_fast_update(faststate, data, len);
+			}
+			else
+			{
+				crc64_update(data, len, &state);
+			}
+		}
+
+		void final(AutoFileSyncDigest& digest) noexcept
+		{
+			unsigned long long hash = (fast == true ? crc64_fast_final(faststate) : crc64_final(&state));
+			memcpy(digest.bytes, &hash, 8);
+		}
+	};
+
+#if defined(AFSYNC_HASH_WITH_XXH3)
+	// Hash engine policy - xxh3-128 (canonical big-endian digest)
+	struct _afsync_hash_engine_xxh3
+	{
+		static constexpr AutoFileSyncHashAlgo algo = AFSYNC_HASH_XXH3;
+
+		XXH3_state_t state;
+
+		_afsync_hash_engine_xxh3() noexcept
+		{
+			XXH3_128bits_reset(&state);
+		}
+
+		void update(unsigned char* data, size_t len) noexcept
+		{
+			XXH3_128bits_update(&state, data, len);
+		}
+
+		void final(AutoFileSyncDigest& digest) noexcept
+		{
+			XXH128_canonical_t canonical;
+			XXH128_canonicalFromHash(&canonical, XXH3_128bits_digest(&state));
+			memcpy(digest.bytes, canonical.digest, 16);
+		}
+	};
+#endif
+
+#if defined(AFSYNC_HASH_WITH_BLAKE3)
+	// Hash engine policy - blake3 (multi-threaded within a buffer if built with tbb)
+	struct _afsync_hash_engine_blake3
+	{
+		static constexpr AutoFileSyncHashAlgo algo = AFSYNC_HASH_BLAKE3;
+
+		blake3_hasher hasher;
+
+		_afsync_hash_engine_blake3() noexcept
+		{
+			blake3_hasher_init(&hasher);
+		}
+
+		void update(unsigned char* data, size_t len) noexcept
+		{
+		#if defined(BLAKE3_USE_TBB)
+			blake3_hasher_update_tbb(&hasher, data, len);
+		#else
+			blake3_hasher_update(&hasher, data, len);
+		#endif
+		}
+
+		void final(AutoFileSyncDigest& digest) noexcept
+		{
+			blake3_hasher_finalize(&hasher, digest.bytes, 32);
+		}
+	};
+#endif
+
+	// Hash engine policy - sha-256 (FIPS 180-4, portable)
+	struct _afsync_hash_engine_sha256
+	{
+		static constexpr AutoFileSyncHashAlgo algo = AFSYNC_HASH_SHA256;
+
+		unsigned int state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+		unsigned char block[64] = {};
+		size_t filled = 0;
+		unsigned long long total = 0;
+
+		static unsigned int rotr(unsigned int x, int n) noexcept
+		{
+			return (x >> n) | (x << (32 - n));
+		}
+
+		void compress(const unsigned char* data) noexcept
+		{
+			static constexpr unsigned int k[64] = {
+				0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+				0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+				0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+				0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+				0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+				0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+				0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+				0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
+
+			unsigned int w[64];
+			for (int i = 0; i < 16; ++i)
+			{
+				w[i] = ((unsigned int)data[i * 4] << 24) | ((unsigned int)data[i * 4 + 1] << 16) |
+					((unsigned int)data[i * 4 + 2] << 8) | (unsigned int)data[i * 4 + 3];
+			}
+			for (int i = 16; i < 64; ++i)
+			{
+				unsigned int s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+				unsigned int s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+				w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+			}
+
+			unsigned int a = state[0], b = state[1], c = state[2], d = state[3];
+			unsigned int e = state[4], f = state[5], g = state[6], h = state[7];
+			for (int i = 0; i < 64; ++i)
+			{
+				unsigned int t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+				unsigned int t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+				h = g;
+				g = f;
+				f = e;
+				e = d + t1;
+				d = c;
+				c = b;
+				b = a;
+				a = t1 + t2;
+			}
+			state[0] += a;
+			state[1] += b;
+			state[2] += c;
+			state[3] += d;
+			state[4] += e;
+			state[5] += f;
+			state[6] += g;
+			state[7] += h;
+		}
+
+		void update(const unsigned char* data, size_t len) noexcept
+		{
+			total += len;
+			if (filled > 0)
+			{
+				size_t take = (64 - filled < len ? 64 - filled : len);
+				memcpy(block + filled, data, take);
+				filled += take;
+				data += take;
+				len -= take;
+				if (filled < 64)
+				{
+					return;
+				}
+				compress(block);
+				filled = 0;
+			}
+			for (; len >= 64; data += 64, len -= 64)
+			{
+				compress(data);
+			}
+			memcpy(block, data, len);
+			filled = len;
+		}
+
+		void final(AutoFileSyncDigest& digest) noexcept
+		{
+			unsigned long long bits = total * 8;
+			block[filled++] = 0x80;
+			if (filled > 56)
+			{
+				memset(block + filled, 0, 64 - filled);
+				compress(block);
+				filled = 0;
+			}
+			memset(block + filled, 0, 56 - filled);
+			for (int i = 0; i < 8; ++i)
+			{
+				block[56 + i] = (unsigned char)(bits >> (56 - i * 8));
+			}
+			compress(block);
+			for (int i = 0; i < 8; ++i)
+			{
+				digest.bytes[i * 4] = (unsigned char)(state[i] >> 24);
+				digest.bytes[i * 4 + 1] = (unsigned char)(state[i] >> 16);
+				digest.bytes[i * 4 + 2] = (unsigned char)(state[i] >> 8);
+				digest.bytes[i * 4 + 3] = (unsigned char)state[i];
+			}
+		}
+	};
+
+	// Utils (not headerable)
+	// Kernel - per-block sums of the chunks of a file, fed in order
+	// Note the strong sums are crc64 (fast kernels when they reproduce Libs/CRC.hpp), the same either way
+	struct _afsync_hash_blocks
+	{
+		AutoFileSyncBlockSums* sums = nullptr;
+		size_t filled = 0;
+		unsigned int a = 0;
+		unsigned int b = 0;
+		const bool fast = crc64_fast_ready();
+		unsigned long long crc = crc64_fast_init();
+		crc64_table state = crc64_init();
+
+		void update(const unsigned char* data, size_t len) noexcept
+		{
+			while (len > 0)
+			{
+				size_t take = sums->blocksize - filled;
+				take = (take < len ? take : len);
+
+				// rsync weak checksum: a = sum of bytes, b = sum of prefix sums (both mod 2^16)
+				for (size_t i = 0; i < take; ++i)
+				{
+					a += data[i];
+					b += a;
+				}
+				if (fast == true)
+				{
+					crc64_fast_update(crc, data, take);
+				}
+				else
+				{
+					crc64_update((unsigned char*)data, take, &state);
+				}
+
+				filled += take;
+				data += take;
+				len -= take;
+				if (filled == sums->blocksize)
+				{
+					final();
+				}
+			}
+		}
+
+		void final() noexcept
+		{
+			if (filled > 0)
+			{
+				sums->weak.push_back((a & 0xffff) | (b << 16));
+				sums->strong.push_back(fast == true ? crc64_fast_final(crc) : crc64_final(&state));
+			}
+			filled = 0;
+			a = 0;
+			b = 0;
+			crc = crc64_fast_init();
+			state = crc64_init();
+		}
+	};
+
+	// Utils (not headerable)
+	// Kernel - hash a file with a hash engine policy
+	template <class Engine>
+	bool _afsync_hash_pipeline(const std::string& filepath, AutoFileSyncDigest& digest,
+		AutoFileSyncBufferPool& buffers, unsigned long long sizehint, size_t depth, AutoFileSyncBlockSums* blocks,
+		std::ofstream* copy = nullptr) noexcept
+	{
+		digest = AutoFileSyncDigest();
+		digest.algo = Engine::algo;
+
+		// Create state to compute the hash, then update it chunk by chunk (and write the chunk if copying)
+		Engine engine;
+		if (blocks == nullptr || blocks->blocksize == 0)
+		{
+			if (read_file(filepath, buffers, sizehint, depth,
+				[&engine, copy](unsigned char* data, size_t len)
+				{
+					engine.update(data, len);
+					if (copy != nullptr)
+					{
+						copy->write((const char*)data, len);
+					}
+				}) == false)
+			{
+				return false;
+			}
+		}
+
+		// And the block sums in the same pass
+		else
+		{
+			blocks->weak.clear();
+			blocks->strong.clear();
+			_afsync_hash_blocks summer;
+			summer.sums = blocks;
+			if (read_file(filepath, buffers, sizehint, depth,
+				[&engine, &summer, copy](unsigned char* data, size_t len)
+				{
+					engine.update(data, len);
+					summer.update(data, len);
+					if (copy != nullptr)
+					{
+						copy->write((const char*)data, len);
+					}
+				}) == false)
+			{
+				return false;
+			}
+			summer.final();
+		}
+
+		engine.final(digest);
+		return true;
+	}
+
+	// Utils (not headerable)
+	// Kernel - hash a file with the engine of an algorithm, writing the chunks to copy as well if not nullptr
+	bool _afsync_hash_dispatch(AutoFileSyncHashAlgo algo, const std::string& filepath, AutoFileSyncDigest& digest,
+		AutoFileSyncBufferPool* buffers, unsigned long long sizehint, size_t depth, AutoFileSyncBlockSums* blocks,
+		std::ofstream* copy) noexcept
+	{
+		static AutoFileSyncBufferPool shared;
+		AutoFileSyncBufferPool& pool = (buffers != nullptr ? *buffers : shared);
+		switch (algo)
+		{
+		case AFSYNC_HASH_CRC64:
+			return _afsync_hash_pipeline<_afsync_hash_engine_crc64>(filepath, digest, pool, sizehint, depth, blocks, copy);
+		case AFSYNC_HASH_SHA256:
+			return _afsync_hash_pipeline<_afsync_hash_engine_sha256>(filepath, digest, pool, sizehint, depth, blocks, copy);
+	#if defined(AFSYNC_HASH_WITH_XXH3)
+		case AFSYNC_HASH_XXH3:
+			return _afsync_hash_pipeline<_afsync_hash_engine_xxh3>(filepath, digest, pool, sizehint, depth, blocks, copy);
+	#endif
+	#if defined(AFSYNC_HASH_WITH_BLAKE3)
+		case AFSYNC_HASH_BLAKE3:
+			return _afsync_hash_pipeline<_afsync_hash_engine_blake3>(filepath, digest, pool, sizehint, depth, blocks, copy);
+	#endif
+		default:
+			digest = AutoFileSyncDigest();
+			return false;
+		}
+	}
+
+	// Utils (not headerable)
+	// Kernel - hash a batch of files with a hash engine policy
+	template <class Engine>
+	bool _afsync_hash_batch(std::vector<AutoFileSyncHashJob>& jobs, AutoFileSyncUring& ring) noexcept
+	{
+		// One state per file, updated as its chunks complete
+		std::vector<Engine> engines(jobs.size());
+		std::vector<AutoFileSyncReadJob> reads(jobs.size());
+		for (size_t i = 0; i < jobs.size(); ++i)
+		{
+			reads[i].filepath = jobs[i].filepath;
+			reads[i].consume = [&engines, i](unsigned char* data, size_t len) { engines[i].update(data, len); };
+		}
+		bool succeeded = ring.read_batch(reads);
+
+		for (size_t i = 0; i < jobs.size(); ++i)
+		{
+			jobs[i].digest = AutoFileSyncDigest();
+			jobs[i].digest.algo = Engine::algo;
+			jobs[i].succeeded = reads[i].succeeded;
+			if (reads[i].succeeded == true)
+			{
+				engines[i].final(jobs[i].digest);
+			}
+		}
+		return succeeded;
+	}
+
+	// Blocks of current that differ from last, or are beyond it (all if the block sizes differ)
+	std::vector<unsigned long long> blocks_changed(const AutoFileSyncBlockSums& last, const AutoFileSyncBlockSums& current) noexcept
+	{
+		std::vector<unsigned long long> changed;
+		bool comparable = last.blocksize == current.blocksize;
+		for (size_t i = 0; i < current.strong.size(); ++i)
+		{
+			if (comparable == false || i >= last.strong.size() ||
+				last.weak[i] != current.weak[i] || last.strong[i] != current.strong[i])
+			{
+				changed.push_back(i);
+			}
+		}
+		return changed;
+	}
+
+	// Hexadecimal digest (of its significant bytes)
+	std::string AutoFileSyncDigest::hex() const noexcept
+	{
+		const char* digits = "0123456789abcdef";
+		std::string out;
+		for (size_t i = 0; i < hash_size((AutoFileSyncHashAlgo)algo); ++i)
+		{
+			out.push_back(digits[bytes[i] >> 4]);
+			out.push_back(digits[bytes[i] & 15]);
+		}
+		return out;
+	}
+
+	// Digest size in bytes of an algorithm, 0 if unknown
+	size_t hash_size(AutoFileSyncHashAlgo algo) noexcept
+	{
+		switch (algo)
+		{
+		case AFSYNC_HASH_CRC64:
+			return 8;
+		case AFSYNC_HASH_XXH3:
+			return 16;
+		case AFSYNC_HASH_BLAKE3:
+		case AFSYNC_HASH_SHA256:
+			return 32;
+		default:
+			return 0;
+		}
+	}
+
+	// Name of an algorithm ("crc64", "xxh3", "blake3", "sha256")
+	const char* hash_name(AutoFileSyncHashAlgo algo) noexcept
+	{
+		switch (algo)
+		{
+		case AFSYNC_HASH_CRC64:
+			return "crc64";
+		case AFSYNC_HASH_XXH3:
+			return "xxh3";
+		case AFSYNC_HASH_BLAKE3:
+			return "blake3";
+		case AFSYNC_HASH_SHA256:
+			return "sha256";
+		default:
+			return "none";
+		}
+	}
+
+	// Algorithm of a name, AFSYNC_HASH_NONE if unknown
+	AutoFileSyncHashAlgo hash_parse(const std::string& name) noexcept
+	{
+		if (name == "crc64")
+		{
+			return AFSYNC_HASH_CRC64;
+		}
+		else if (name == "xxh3" || name == "xxh3-128" || name == "xxh128")
+		{
+			return AFSYNC_HASH_XXH3;
+		}
+		else if (name == "blake3")
+		{
+			return AFSYNC_HASH_BLAKE3;
+		}
+		else if (name == "sha256" || name == "sha-256")
+		{
+			return AFSYNC_HASH_SHA256;
+		}
+		return AFSYNC_HASH_NONE;
+	}
+
+	// Whether an algorithm is compiled in (xxh3 and blake3 need Libs/xxhash.h and Libs/blake3.h)
+	bool hash_available(AutoFileSyncHashAlgo algo) noexcept
+	{
+		switch (algo)
+		{
+		case AFSYNC_HASH_CRC64:
+		case AFSYNC_HASH_SHA256:
+			return true;
+	#if defined(AFSYNC_HASH_WITH_XXH3)
+		case AFSYNC_HASH_XXH3:
+			return true;
+	#endif
+	#if defined(AFSYNC_HASH_WITH_BLAKE3)
+		case AFSYNC_HASH_BLAKE3:
+			return true;
+	#endif
+		default:
+			return false;
+		}
+	}
+
+	// Strongest available algorithm for content addressing (blake3, otherwise sha256)
+	AutoFileSyncHashAlgo hash_strongest() noexcept
+	{
+		return hash_available(AFSYNC_HASH_BLAKE3) == true ? AFSYNC_HASH_BLAKE3 : AFSYNC_HASH_SHA256;
+	}
+
+	// Utils (not headerable)
+	// Kernel - hash a buffer with a hash engine policy
+	template <class Engine>
+	bool _afsync_hash_memory(const unsigned char* data, size_t len, AutoFileSyncDigest& digest) noexcept
+	{
+		digest = AutoFileSyncDigest();
+		digest.algo = Engine::algo;
+		Engine engine;
+		engine.update((unsigned char*)data, len);
+		engine.final(digest);
+		return true;
+	}
+
+	// Hash a buffer, false if the algorithm is not available (then the digest is zeroed)
+	bool hash_buffer(AutoFileSyncHashAlgo algo, const unsigned char* data, size_t len, AutoFileSyncDigest& digest) noexcept
+	{
+		switch (algo)
+		{
+		case AFSYNC_HASH_CRC64:
+			return _afsync_hash_memory<_afsync_hash_engine_crc64>(data, len, digest);
+		case AFSYNC_HASH_SHA256:
+			return _afsync_hash_memory<_afsync_hash_engine_sha256>(data, len, digest);
+	#if defined(AFSYNC_HASH_WITH_XXH3)
+		case AFSYNC_HASH_XXH3:
+			return _afsync_hash_memory<_afsync_hash_engine_xxh3>(data, len, digest);
+	#endif
+	#if defined(AFSYNC_HASH_WITH_BLAKE3)
+		case AFSYNC_HASH_BLAKE3:
+			return _afsync_hash_memory<_afsync_hash_engine_blake3>(data, len, digest);
+	#endif
+		default:
+			digest = AutoFileSyncDigest();
+			return false;
+		}
+	}
+
+	// Hash the contents of a file, false if it cannot be read (then the digest is zeroed)
+	// Reads go through buffers borrowed from buffers (a process-wide pool if nullptr), sized to sizehint bytes,
+	// with up to depth reads in flight; blocks (if not nullptr) gets the sums of blocks of blocks->blocksize
+	bool hash_file(AutoFileSyncHashAlgo algo, const std::string& filepath, AutoFileSyncDigest& digest,
+		AutoFileSyncBufferPool* buffers, unsigned long long sizehint, size_t depth, AutoFileSyncBlockSums* blocks) noexcept
+	{
+		return _afsync_hash_dispatch(algo, filepath, digest, buffers, sizehint, depth, blocks, nullptr);
+	}
+
+	// Hash a file and copy it (overwritten if existing) from the same reads, keeping its mode and mtime, false if failed
+	bool hash_copy_file(AutoFileSyncHashAlgo algo, const std::string& from, const std::string& to, AutoFileSyncDigest& digest,
+		AutoFileSyncBufferPool* buffers, unsigned long long sizehint, size_t depth, AutoFileSyncBlockSums* blocks) noexcept
+	{
+		std::error_code ec;
+		std::filesystem::file_status status = std::filesystem::status(from, ec);
+		std::filesystem::file_time_type mtime = std::filesystem::last_write_time(from, ec);
+		std::ofstream ofs(to, std::ios::binary | std::ios::trunc);
+		if (ofs.is_open() == false)
+		{
+			digest = AutoFileSyncDigest();
+			return false;
+		}
+
+		bool hashed = _afsync_hash_dispatch(algo, from, digest, buffers, sizehint, depth, blocks, &ofs);
+		ofs.close();
+		if (hashed == false || ofs.fail() == true)
+		{
+			std::filesystem::remove(to, ec);
+			return false;
+		}
+		std::filesystem::permissions(to, status.permissions(), ec);
+		std::filesystem::last_write_time(to, mtime, ec);
+		return true;
+	}
+
+
+	// Hash many files in one io_uring batch, false if the ring failed (then unread jobs are not succeeded)
+	bool hash_files(AutoFileSyncHashAlgo algo, std::vector<AutoFileSyncHashJob>& jobs, AutoFileSyncUring& ring) noexcept
+	{
+		switch (algo)
+		{
+		case AFSYNC_HASH_CRC64:
+			return _afsync_hash_batch<_afsync_hash_engine_crc64>(jobs, ring);
+		case AFSYNC_HASH_SHA256:
+			return _afsync_hash_batch<_afsync_hash_engine_sha256>(jobs, ring);
+	#if defined(AFSYNC_HASH_WITH_XXH3)
+		case AFSYNC_HASH_XXH3:
+			return _afsync_hash_batch<_afsync_hash_engine_xxh3>(jobs, ring);
+	#endif
+	#if defined(AFSYNC_HASH_WITH_BLAKE3)
+		case AFSYNC_HASH_BLAKE3:
+			return _afsync_hash_batch<_afsync_hash_engine_blake3>(jobs, ring);
+	#endif
+		default:
+			for (AutoFileSyncHashJob& job : jobs)
+			{
+				job.digest = AutoFileSyncDigest();
+				job.succeeded = false;
+			}
+			return false;
+		}
+	}
+
+	// Constructor, ranges of about rangesize bytes (whole blocks of blocksize if not 0)
+	AutoFileSyncSplitHash::AutoFileSyncSplitHash(const std::string& filepath, unsigned long long size, unsigned long long rangesize,
+		AutoFileSyncBufferPool& buffers, unsigned int blocksize) noexcept
+	{
+		if (rangesize < 1)
+		{
+			rangesize = 1;
+		}
+		if (blocksize > 0)
+		{
+			rangesize = (rangesize + blocksize - 1) / blocksize * blocksize;
+		}
+		this->_filepath = filepath;
+		this->_size = size;
+		this->_rangesize = rangesize;
+		this->_ranges = (size_t)((size + rangesize - 1) / rangesize);
+		this->_buffers = &buffers;
+		this->_blocksize = blocksize;
+		this->_crcs.assign(this->_ranges, 0);
+		if (blocksize > 0)
+		{
+			this->_blocks.resize(this->_ranges);
+		}
+	}
+
+	// Whether files hashed with an algorithm can be split
+	bool AutoFileSyncSplitHash::splittable(AutoFileSyncHashAlgo algo) noexcept
+	{
+		return algo == AFSYNC_HASH_CRC64 && crc64_fast_ready() == true;
+	}
+
+	// Hash a range nobody claimed yet, false if none was left
+	bool AutoFileSyncSplitHash::help() noexcept
+	{
+		size_t range = this->_claimed.fetch_add(1);
+		if (range >= this->_ranges)
+		{
+			return false;
+		}
+		unsigned long long offset = (unsigned long long)range * this->_rangesize;
+		unsigned long long length = (this->_size - offset < this->_rangesize ? this->_size - offset : this->_rangesize);
+
+		// Its crc from a zero state, and its block sums in the same pass
+		unsigned long long crc = 0;
+		bool read = false;
+		if (this->_blocksize == 0)
+		{
+			read = read_range(this->_filepath, offset, length, *this->_buffers,
+				[&crc](unsigned char* data, size_t len) { crc64_fast_update(crc, data, len); });
+		}
+		else
+		{
+			_afsync_hash_blocks summer;
+			summer.sums = &this->_blocks[range];
+			summer.sums->blocksize = this->_blocksize;
+			read = read_range(this->_filepath, offset, length, *this->_buffers,
+				[&crc, &summer](unsigned char* data, size_t len) { crc64_fast_update(crc, data, len); summer.update(data, len); });
+			summer.final();
+		}
+		this->_crcs[range] = crc;
+
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		this->_failed = this->_failed || read == false;
+		if (++this->_done == this->_ranges)
+		{
+			this->_cv.notify_all();
+		}
+		return true;
+	}
+
+	// Help until every range is claimed, wait for the others, then combine, false if any range failed
+	bool AutoFileSyncSplitHash::finish(AutoFileSyncDigest& digest, AutoFileSyncBlockSums* blocks) noexcept
+	{
+		while (this->help() == true)
+		{
+		}
+		{
+			std::unique_lock<std::mutex> lock(this->_mutex);
+			this->_cv.wait(lock, [this]() { return this->_done == this->_ranges; });
+		}
+
+		digest = AutoFileSyncDigest();
+		digest.algo = AFSYNC_HASH_CRC64;
+		if (this->_failed == true)
+		{
+			return false;
+		}
+
+		// Chain the ranges in order
+		unsigned long long state = crc64_fast_init();
+		for (size_t range = 0; range < this->_ranges; ++range)
+		{
+			unsigned long long offset = (unsigned long long)range * this->_rangesize;
+			unsigned long long length = (this->_size - offset < this->_rangesize ? this->_size - offset : this->_rangesize);
+			state = crc64_fast_combine(state, this->_crcs[range], length);
+		}
+		unsigned long long hash = crc64_fast_final(state);
+		memcpy(digest.bytes, &hash, 8);
+
+		if (blocks != nullptr)
+		{
+			blocks->blocksize = this->_blocksize;
+			blocks->weak.clear();
+			blocks->strong.clear();
+			for (const AutoFileSyncBlockSums& sums : this->_blocks)
+			{
+				blocks->weak.insert(blocks->weak.end(), sums.weak.begin(), sums.weak.end());
+				blocks->strong.insert(blocks->strong.end(), sums.strong.begin(), sums.strong.end());
+			}
+		}
+		return true;
+	}
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,171 @@
+// AutoFileSyncHasher.hpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <condition_variable>
+
+#include "AutoFileSyncBuffers.hpp"
+#include "AutoFileSyncUring.hpp"
+
+#pragma once
+
+#pragma warning (disable: 4018)
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4251)
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4661)
+#pragma warning (disable: 4715)
+#pragma warning (disable: 4804)
+#pragma warning (disable: 4819)
+#pragma warning (disable: 4919)
+#pragma warning (disable: 4996)
+#pragma warning (disable: 6031)
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Hash algorithms (values are persisted in the index, never reuse them)
+	enum AutoFileSyncHashAlgo : unsigned char
+	{
+		AFSYNC_HASH_NONE = 0,
+		AFSYNC_HASH_CRC64 = 1,     // crc64 of Libs/CRC.hpp, 8 bytes (compatible)
+		AFSYNC_HASH_XXH3 = 2,      // xxh3-128, 16 bytes (fast)
+		AFSYNC_HASH_BLAKE3 = 3,    // blake3, 32 bytes (strong)
+		AFSYNC_HASH_SHA256 = 4,    // sha-256, 32 bytes (strong, always available)
+	};
+
+	// struct AutoFileSyncDigest
+	// A content digest and the algorithm that produced it
+	// Note digests of different algorithms never compare equal
+	struct AutoFileSyncDigest
+	{
+		unsigned char algo = AFSYNC_HASH_NONE;
+		unsigned char bytes[32] = {};
+
+		bool operator==(const AutoFileSyncDigest& y) const noexcept
+		{
+			return algo == y.algo && memcmp(bytes, y.bytes, sizeof(bytes)) == 0;
+		}
+		bool operator!=(const AutoFileSyncDigest& y) const noexcept
+		{
+			return !(*this == y);
+		}
+
+		// Hexadecimal digest (of its significant bytes)
+		std::string hex() const noexcept;
+	};
+
+	// struct AutoFileSyncBlockSums
+	// Per-block checksums of a file for delta snapshots, fixed-size blocks from offset 0
+	// (the last one may be shorter), each with a weak rolling checksum (rsync) and a crc64
+	struct AutoFileSyncBlockSums
+	{
+		unsigned int blocksize = 0;
+		std::vector<unsigned int> weak;
+		std::vector<unsigned long long> strong;
+	};
+
+	// Blocks of current that differ from last, or are beyond it (all if the block sizes differ)
+	std::vector<unsigned long long> blocks_changed(const AutoFileSyncBlockSums& last, const AutoFileSyncBlockSums& current) noexcept;
+
+	// struct AutoFileSyncHashJob
+	// A file to hash in a batch, its digest and whether it was read
+	struct AutoFileSyncHashJob
+	{
+		std::string filepath = "";
+		AutoFileSyncDigest digest;
+		bool succeeded = false;
+	};
+
+	// Digest size in bytes of an algorithm, 0 if unknown
+	size_t hash_size(AutoFileSyncHashAlgo algo) noexcept;
+
+	// Name of an algorithm ("crc64", "xxh3", "blake3", "sha256")
+	const char* hash_name(AutoFileSyncHashAlgo algo) noexcept;
+
+	// Algorithm of a name, AFSYNC_HASH_NONE if unknown
+	AutoFileSyncHashAlgo hash_parse(const std::string& name) noexcept;
+
+	// Whether an algorithm is compiled in (xxh3 and blake3 need Libs/xxhash.h and Libs/blake3.h)
+	bool hash_available(AutoFileSyncHashAlgo algo) noexcept;
+
+	// Strongest available algorithm for content addressing (blake3, otherwise sha256)
+	AutoFileSyncHashAlgo hash_strongest() noexcept;
+
+	// Hash a buffer, false if the algorithm is not available (then the digest is zeroed)
+	bool hash_buffer(AutoFileSyncHashAlgo algo, const unsigned char* data, size_t len, AutoFileSyncDigest& digest) noexcept;
+
+	// Hash the contents of a file, false if it cannot be read (then the digest is zeroed)
+	// Reads go through buffers borrowed from buffers (a process-wide pool if nullptr), sized to sizehint bytes,
+	// with up to depth reads in flight; blocks (if not nullptr) gets the sums of blocks of blocks->blocksize
+	bool hash_file(AutoFileSyncHashAlgo algo, const std::string& filepath, AutoFileSyncDigest& digest,
+		AutoFileSyncBufferPool* buffers = nullptr, unsigned long long sizehint = ~0ULL, size_t depth = 1,
+		AutoFileSyncBlockSums* blocks = nullptr) noexcept;
+
+	// Hash a file and copy it (overwritten if existing) from the same reads, keeping its mode and mtime, false if failed
+	// Note the digest describes exactly the bytes copied, even if the file is modified meanwhile
+	bool hash_copy_file(AutoFileSyncHashAlgo algo, const std::string& from, const std::string& to, AutoFileSyncDigest& digest,
+		AutoFileSyncBufferPool* buffers = nullptr, unsigned long long sizehint = ~0ULL, size_t depth = 1,
+		AutoFileSyncBlockSums* blocks = nullptr) noexcept;
+
+	// Hash many files in one io_uring batch, false if the ring failed (then unread jobs are not succeeded)
+	bool hash_files(AutoFileSyncHashAlgo algo, std::vector<AutoFileSyncHashJob>& jobs, AutoFileSyncUring& ring) noexcept;
+
+	// class AutoFileSyncSplitHash
+	// A large file hashed as ranges by every thread that helps, then combined into the digest of the whole
+	//
+	// Only crc64 splits (with the fast kernels): every range gets its own crc from a zero state and
+	// crc64_fast_combine chains them back, so the digest is bit-identical to hashing the file in one
+	// pass. Ranges are whole blocks when block sums are wanted, so those are concatenated as well.
+	// Any thread may call help() while the owner calls finish(), which helps too and then waits.
+	class AutoFileSyncSplitHash
+	{
+	private:
+		// File, its size and its ranges
+		std::string _filepath = "";
+		unsigned long long _size = 0;
+		unsigned long long _rangesize = 0;
+		size_t _ranges = 0;
+		AutoFileSyncBufferPool* _buffers = nullptr;
+
+		// Per range crc (from a zero state) and block sums (if blocksize is not 0)
+		unsigned int _blocksize = 0;
+		std::vector<unsigned long long> _crcs;
+		std::vector<AutoFileSyncBlockSums> _blocks;
+
+		// Ranges claimed, ranges done and whether any failed
+		std::atomic<size_t> _claimed = 0;
+		size_t _done = 0;
+		bool _failed = false;
+		std::mutex _mutex;
+		std::condition_variable _cv;
+
+	public:
+		// Constructor, ranges of about rangesize bytes (whole blocks of blocksize if not 0)
+		AutoFileSyncSplitHash(const std::string& filepath, unsigned long long size, unsigned long long rangesize,
+			AutoFileSyncBufferPool& buffers, unsigned int blocksize = 0) noexcept;
+
+		// Copy constructor = delete
+		AutoFileSyncSplitHash(const AutoFileSyncSplitHash& y) noexcept = delete;
+		AutoFileSyncSplitHash& operator=(const AutoFileSyncSplitHash& y) noexcept = delete;
+
+		// Whether files hashed with an algorithm can be split
+		static bool splittable(AutoFileSyncHashAlgo algo) noexcept;
+
+		// Hash a range nobody claimed yet, false if none was left
+		bool help() noexcept;
+
+		// Help until every range is claimed, wait for the others, then combine, false if any range failed
+		bool finish(AutoFileSyncDigest& digest, AutoFileSyncBlockSums* blocks = nullptr) noexcept;
+	};
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,429 @@
+// AutoFileSyncIndex.cpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "AutoFileSyncIndex.hpp"
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Index file format constants
+	constexpr char _afsync_index_magic[8] = { 'A', 'F', 'S', 'Y', 'N', 'C', 'I', 'X' };
+	// Note older journals (1: crc64 only, 2: no block sums) are still read, and rewritten on the next commit
+	constexpr unsigned int _afsync_index_version = 3;
+	constexpr size_t _afsync_index_headsize = 16;
+	constexpr size_t _afsync_index_recordsize = 1 + 32 + 5 * 8 + 1;
+	constexpr size_t _afsync_index_recordsize_v1 = 6 * 8 + 1;
+
+	// Index entry types
+	constexpr unsigned char _afsync_index_put = 1;
+	constexpr unsigned char _afsync_index_del = 2;
+	constexpr unsigned char _afsync_index_snap = 3;
+	constexpr unsigned char _afsync_index_blocks = 4;
+
+	// Utils (not headerable)
+	// Kernel - FNV-1a checksum of an index entry
+	inline unsigned int _afsync_util_index_checksum(const unsigned char* data, size_t len) noexcept
+	{
+		unsigned int h = 2166136261U;
+		for (size_t i = 0; i < len; ++i)
+		{
+			h ^= data[i];
+			h *= 16777619U;
+		}
+		return h;
+	}
+
+	// Utils (not headerable)
+	// Kernel - Append an encoded index entry to a buffer
+	inline void _afsync_util_index_entry(std::string& out, unsigned char type, const std::string& path, const AutoFileSyncRecord* record) noexcept
+	{
+		size_t start = out.size();
+		unsigned int pathlen = (unsigned int)path.size();
+
+		out.push_back((char)type);
+		out.append((const char*)&pathlen, 4);
+		if (type == _afsync_index_put)
+		{
+			out.push_back((char)record->hash.algo);
+			out.append((const char*)record->hash.bytes, 32);
+			out.append((const char*)&record->size, 8);
+			out.append((const char*)&record->mtime, 8);
+			out.append((const char*)&record->ctime, 8);
+			out.append((const char*)&record->inode, 8);
+			out.append((const char*)&record->dev, 8);
+			out.push_back(record->racy ? 1 : 0);
+		}
+		else if (type == _afsync_index_blocks)
+		{
+			unsigned int count = (unsigned int)record->blocks->strong.size();
+			out.append((const char*)&record->blocks->blocksize, 4);
+			out.append((const char*)&count, 4);
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				out.append((const char*)&record->blocks->weak[i], 4);
+				out.append((const char*)&record->blocks->strong[i], 8);
+			}
+		}
+		out.append(path);
+
+		unsigned int checksum = _afsync_util_index_checksum((const unsigned char*)out.data() + start, out.size() - start);
+		out.append((const char*)&checksum, 4);
+	}
+
+	// Utils (not headerable)
+	// Kernel - Append the entries of a record (its block sums follow it)
+	inline size_t _afsync_util_index_record(std::string& out, const std::string& path, const AutoFileSyncRecord& record) noexcept
+	{
+		_afsync_util_index_entry(out, _afsync_index_put, path, &record);
+		if (record.blocks == nullptr)
+		{
+			return 1;
+		}
+		_afsync_util_index_entry(out, _afsync_index_blocks, path, &record);
+		return 2;
+	}
+
+	// Utils (not headerable)
+	// Kernel - Read-only memory mapping of a whole file
+	struct _afsync_util_index_mapping
+	{
+		const unsigned char* data = nullptr;
+		size_t len = 0;
+	#if defined(_WIN32)
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = NULL;
+	#endif
+
+		_afsync_util_index_mapping(const std::string& path) noexcept
+		{
+		#if defined(_WIN32)
+			file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				return;
+			}
+			LARGE_INTEGER size;
+			if (GetFileSizeEx(file, &size) == FALSE || size.QuadPart == 0)
+			{
+				return;
+			}
+			mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping == NULL)
+			{
+				return;
+			}
+			data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			len = data != nullptr ? (size_t)size.QuadPart : 0;
+		#else
+			int fd = open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+			{
+				return;
+			}
+			struct stat st;
+			if (fstat(fd, &st) == 0 && st.st_size > 0)
+			{
+				void* ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (ptr != MAP_FAILED)
+				{
+					madvise(ptr, (size_t)st.st_size, MADV_SEQUENTIAL);
+					data = (const unsigned char*)ptr;
+					len = (size_t)st.st_size;
+				}
+			}
+			close(fd);
+		#endif
+		}
+
+		~_afsync_util_index_mapping() noexcept
+		{
+		#if defined(_WIN32)
+			if (data != nullptr)
+			{
+				UnmapViewOfFile(data);
+			}
+			if (mapping != NULL)
+			{
+				CloseHandle(mapping);
+			}
+			if (file != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(file);
+			}
+		#else
+			if (data != nullptr)
+			{
+				munmap((void*)data, len);
+			}
+		#endif
+		}
+	};
+
+	// Constructor
+	AutoFileSyncIndex::AutoFileSyncIndex(const std::string& indexpath, const std::string& prefix) noexcept
+	{
+		this->_path = indexpath;
+		this->_prefix = prefix;
+	}
+
+	// Load the records (paths under the prefix only) and the last snapshot path, false if no usable index
+	bool AutoFileSyncIndex::load(AutoFileSyncPaths& paths, AutoFileSyncFileTable& records, std::string& snapshot) noexcept
+	{
+		records.clear();
+		snapshot = "";
+		this->_entries = 0;
+		this->_snapshot = "";
+		this->_rewrite = true;
+
+		// Map and check the header
+		_afsync_util_index_mapping mapped(this->_path);
+		const unsigned char* data = mapped.data;
+		const size_t len = mapped.len;
+		if (data == nullptr || len < _afsync_index_headsize)
+		{
+			return false;
+		}
+		unsigned int version = 0;
+		memcpy(&version, data + 8, 4);
+		if (memcmp(data, _afsync_index_magic, 8) != 0 || version < 1 || version > _afsync_index_version)
+		{
+			return false;
+		}
+		const size_t putsize = (version == 1 ? _afsync_index_recordsize_v1 : _afsync_index_recordsize);
+
+		// Replay the journal until its end or the first torn entry
+		size_t pos = _afsync_index_headsize;
+		while (pos < len)
+		{
+			// type and path length
+			if (len - pos < 5)
+			{
+				break;
+			}
+			unsigned char type = data[pos];
+			unsigned int pathlen = 0;
+			memcpy(&pathlen, data + pos + 1, 4);
+			size_t recordsize = (type == _afsync_index_put ? putsize : 0);
+			if (type == _afsync_index_blocks)
+			{
+				unsigned int count = 0;
+				if (len - pos < 13)
+				{
+					break;
+				}
+				memcpy(&count, data + pos + 9, 4);
+				recordsize = 8 + (size_t)count * 12;
+			}
+			size_t entrysize = 5 + recordsize + (size_t)pathlen + 4;
+			if (type < _afsync_index_put || type > _afsync_index_blocks || len - pos < entrysize)
+			{
+				break;
+			}
+
+			// checksum
+			unsigned int checksum = 0;
+			memcpy(&checksum, data + pos + entrysize - 4, 4);
+			if (checksum != _afsync_util_index_checksum(data + pos, entrysize - 4))
+			{
+				break;
+			}
+
+			// apply (record paths relative to the prefix, older journals may have backslashes)
+			const unsigned char* field = data + pos + 5;
+			std::string path((const char*)field + recordsize, pathlen);
+			unsigned int id = AutoFileSyncPaths::npos;
+			if (type != _afsync_index_snap)
+			{
+				std::replace(path.begin(), path.end(), '\\', '/');
+				if (path.starts_with(this->_prefix) == true)
+				{
+					std::string_view relpath = std::string_view(path).substr(this->_prefix.size());
+					id = (type == _afsync_index_put ? paths.intern(relpath) : paths.find(relpath));
+				}
+			}
+			if (type != _afsync_index_snap && id == AutoFileSyncPaths::npos)
+			{
+				// not under the src (or deleting an unknown path)
+			}
+			else if (type == _afsync_index_put)
+			{
+				// version 1 records only had a crc64
+				AutoFileSyncRecord record;
+				if (version == 1)
+				{
+					record.hash.algo = AFSYNC_HASH_CRC64;
+					memcpy(record.hash.bytes, field, 8);
+					field += 8;
+				}
+				else
+				{
+					record.hash.algo = field[0];
+					memcpy(record.hash.bytes, field + 1, 32);
+					field += 33;
+				}
+				memcpy(&record.size, field, 8);
+				memcpy(&record.mtime, field + 8, 8);
+				memcpy(&record.ctime, field + 16, 8);
+				memcpy(&record.inode, field + 24, 8);
+				memcpy(&record.dev, field + 32, 8);
+				record.racy = field[40] != 0;
+				records.resize(paths.size());
+				records.set(id, record);
+			}
+			else if (type == _afsync_index_blocks)
+			{
+				// sums of the record just put
+				if (records.has(id) == true)
+				{
+					AutoFileSyncRecord record = records.get(id);
+					std::shared_ptr<AutoFileSyncBlockSums> blocks = std::make_shared<AutoFileSyncBlockSums>();
+					unsigned int count = 0;
+					memcpy(&blocks->blocksize, field, 4);
+					memcpy(&count, field + 4, 4);
+					blocks->weak.resize(count);
+					blocks->strong.resize(count);
+					for (unsigned int i = 0; i < count; ++i)
+					{
+						memcpy(&blocks->weak[i], field + 8 + (size_t)i * 12, 4);
+						memcpy(&blocks->strong[i], field + 12 + (size_t)i * 12, 8);
+					}
+					record.blocks = blocks;
+					records.set(id, record);
+				}
+			}
+			else if (type == _afsync_index_del)
+			{
+				records.erase(id);
+			}
+			else
+			{
+				snapshot = path;
+			}
+
+			this->_entries++;
+			pos += entrysize;
+		}
+
+		// A clean journal of this version can be appended, otherwise the next commit rewrites it
+		this->_rewrite = pos != len || version != _afsync_index_version;
+		this->_snapshot = snapshot;
+
+		return true;
+	}
+
+	// Commit changed (puts, keys of records) and deleted (dels) paths and the last snapshot path
+	bool AutoFileSyncIndex::commit(const AutoFileSyncPaths& paths, const AutoFileSyncFileTable& records,
+		const std::vector<unsigned int>& puts, const std::vector<unsigned int>& dels,
+		const std::string& snapshot) noexcept
+	{
+		// Compact if needed
+		const size_t live = records.count() + 1;
+		if (this->_rewrite == true || (this->_entries > 4096 && this->_entries - live > live))
+		{
+			return this->_compact(paths, records, snapshot);
+		}
+
+		// Nothing to append
+		if (puts.size() == 0 && dels.size() == 0 && snapshot == this->_snapshot)
+		{
+			return true;
+		}
+
+		// Encode the entries
+		std::string journal;
+		size_t entries = 0;
+		for (unsigned int it : puts)
+		{
+			if (records.has(it) == true)
+			{
+				entries += _afsync_util_index_record(journal, this->_prefix + paths.path(it), records.get(it));
+			}
+		}
+		for (unsigned int it : dels)
+		{
+			_afsync_util_index_entry(journal, _afsync_index_del, this->_prefix + paths.path(it), nullptr);
+			entries++;
+		}
+		if (snapshot != this->_snapshot)
+		{
+			_afsync_util_index_entry(journal, _afsync_index_snap, snapshot, nullptr);
+			entries++;
+		}
+
+		// Append
+		std::ofstream ofs(this->_path, std::ios::binary | std::ios::app);
+		ofs.write(journal.data(), journal.size());
+		ofs.close();
+		if (ofs.fail())
+		{
+			this->_rewrite = true;
+			return false;
+		}
+
+		this->_entries += entries;
+		this->_snapshot = snapshot;
+		return true;
+	}
+
+	// Rewrite the whole journal with the live records only
+	bool AutoFileSyncIndex::_compact(const AutoFileSyncPaths& paths, const AutoFileSyncFileTable& records, const std::string& snapshot) noexcept
+	{
+		// Encode the header and every live record
+		std::string journal;
+		journal.append(_afsync_index_magic, 8);
+		unsigned int version = _afsync_index_version;
+		unsigned int reserved = 0;
+		journal.append((const char*)&version, 4);
+		journal.append((const char*)&reserved, 4);
+		size_t entries = 1;
+		for (unsigned int id = 0; id < (unsigned int)records.size(); ++id)
+		{
+			if (records.has(id) == true)
+			{
+				entries += _afsync_util_index_record(journal, this->_prefix + paths.path(id), records.get(id));
+			}
+		}
+		_afsync_util_index_entry(journal, _afsync_index_snap, snapshot, nullptr);
+
+		// Write aside, then replace the old journal
+		const std::string tmppath = this->_path + ".tmp";
+		std::ofstream ofs(tmppath, std::ios::binary | std::ios::trunc);
+		ofs.write(journal.data(), journal.size());
+		ofs.close();
+		if (ofs.fail())
+		{
+			return false;
+		}
+		std::error_code ec;
+		std::filesystem::rename(tmppath, this->_path, ec);
+		if (ec)
+		{
+			return false;
+		}
+
+		this->_entries = entries;
+		this->_snapshot = snapshot;
+		this->_rewrite = false;
+		return true;
+	}
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,81 @@
+// AutoFileSyncIndex.hpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "AutoFileSyncFilestat.hpp"
+#include "AutoFileSyncTable.hpp"
+
+#pragma once
+
+#pragma warning (disable: 4018)
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4251)
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4661)
+#pragma warning (disable: 4715)
+#pragma warning (disable: 4804)
+#pragma warning (disable: 4819)
+#pragma warning (disable: 4919)
+#pragma warning (disable: 4996)
+#pragma warning (disable: 6031)
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// class AutoFileSyncIndex
+	// Persistent index of the monitored records, stored next to the snapshots
+	// 
+	// The file is an append-only journal (memory-mapped to load):
+	//   header  "AFSYNCIX" u32 version u32 reserved
+	//   entry   u8 type, u32 pathlen, [record], path, u32 checksum
+	//   record  u8 hash algorithm, 32 bytes digest, u64 size, i64 mtime, i64 ctime, u64 inode, u64 dev, u8 racy
+	//   blocks  u32 block size, u32 count, count * (u32 weak, u64 strong)
+	// where type is PUT (path -> record), BLKS (path -> blocks of the record just put),
+	// DEL (path) or SNAP (path of the last snapshot).
+	// Later entries override earlier ones, a torn or corrupted tail is dropped,
+	// and the journal is compacted once superseded entries outnumber the live ones.
+	// Paths are kept whole in the journal, and interned relative to the src prefix in memory.
+	class AutoFileSyncIndex
+	{
+	private:
+		// Index file path
+		std::string _path = "";
+
+		// Src prefix of the paths (forward slashes, ending with one)
+		std::string _prefix = "";
+
+		// Entries in the journal (to decide compaction against the live records)
+		size_t _entries = 0;
+
+		// Last snapshot path in the journal
+		std::string _snapshot = "";
+
+		// Journal has to be rewritten before appending (tail dropped or not existing)
+		bool _rewrite = true;
+
+	public:
+		// Constructor
+		AutoFileSyncIndex(const std::string& indexpath, const std::string& prefix) noexcept;
+
+		// Load the records (paths under the prefix only) and the last snapshot path, false if no usable index
+		bool load(AutoFileSyncPaths& paths, AutoFileSyncFileTable& records, std::string& snapshot) noexcept;
+
+		// Commit changed (puts, ids with records) and deleted (dels) paths and the last snapshot path
+		bool commit(const AutoFileSyncPaths& paths, const AutoFileSyncFileTable& records,
+			const std::vector<unsigned int>& puts, const std::vector<unsigned int>& dels,
+			const std::string& snapshot) noexcept;
+
+	private:
+		// Rewrite the whole journal with the live records only
+		bool _compact(const AutoFileSyncPaths& paths, const AutoFileSyncFileTable& records, const std::string& snapshot) noexcept;
+	};
+
+}
+// Namespace AutoFileSync ends
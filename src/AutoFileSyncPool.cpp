@@ -0,0 +1,124 @@
+// AutoFileSyncPool.cpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include "AutoFileSyncPool.hpp"
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Constructor, with a number of threads (at least one)
+	AutoFileSyncPool::AutoFileSyncPool(size_t threads) noexcept
+	{
+		threads = (threads < 1 ? 1 : threads);
+		for (size_t k = 0; k < threads; ++k)
+		{
+			this->_threads.emplace_back([this]() { this->_work(); });
+		}
+	}
+
+	// Destructor, stops the threads once every queued task has run
+	AutoFileSyncPool::~AutoFileSyncPool() noexcept
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			this->_stop = true;
+			this->_cv.notify_all();
+		}
+		for (std::thread& thread : this->_threads)
+		{
+			thread.join();
+		}
+	}
+
+	// Threads
+	size_t AutoFileSyncPool::threads() const noexcept
+	{
+		return this->_threads.size();
+	}
+
+	// Open a lane for a job, reusing a closed one
+	size_t AutoFileSyncPool::open() noexcept
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		for (size_t lane = 0; lane < this->_open.size(); ++lane)
+		{
+			if (this->_open[lane] == 0 && this->_lanes[lane].empty() == true)
+			{
+				this->_open[lane] = 1;
+				return lane;
+			}
+		}
+		this->_lanes.emplace_back();
+		this->_open.push_back(1);
+		return this->_lanes.size() - 1;
+	}
+
+	// Close a lane (its tasks queued still run)
+	void AutoFileSyncPool::close(size_t lane) noexcept
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		if (lane < this->_open.size())
+		{
+			this->_open[lane] = 0;
+		}
+		return;
+	}
+
+	// Queue a task in a lane
+	void AutoFileSyncPool::submit(size_t lane, AutoFileSyncTask&& task) noexcept
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		this->_lanes[lane].push_back(std::move(task));
+		this->_cv.notify_one();
+		return;
+	}
+
+	// A thread, running the tasks of the lanes in turn until stopped
+	void AutoFileSyncPool::_work() noexcept
+	{
+		std::unique_lock<std::mutex> lock(this->_mutex);
+		while (true)
+		{
+			// The first lane holding tasks from the one to serve next
+			size_t lane = this->_lanes.size();
+			for (size_t k = 0; k < this->_lanes.size(); ++k)
+			{
+				size_t at = (this->_next + k) % this->_lanes.size();
+				if (this->_lanes[at].empty() == false)
+				{
+					lane = at;
+					break;
+				}
+			}
+			if (lane == this->_lanes.size())
+			{
+				if (this->_stop == true)
+				{
+					return;
+				}
+				this->_cv.wait(lock);
+				continue;
+			}
+
+			// Its oldest task, then the next lane's turn
+			AutoFileSyncTask task = std::move(this->_lanes[lane].front());
+			this->_lanes[lane].pop_front();
+			this->_next = lane + 1;
+			lock.unlock();
+			task();
+			lock.lock();
+		}
+	}
+
+	// Constructor, threads of each pool and the cap of each device
+	AutoFileSyncShared::AutoFileSyncShared(size_t threads, long long devicecap) noexcept
+		: chck(threads), sync(threads), buffers(), devices(devicecap)
+	{
+	}
+
+}
+// Namespace AutoFileSync ends
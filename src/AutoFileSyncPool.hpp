@@ -0,0 +1,114 @@
+// AutoFileSyncPool.hpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include "AutoFileSyncBuffers.hpp"
+#include "AutoFileSyncCopier.hpp"
+
+#pragma once
+
+#pragma warning (disable: 4018)
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4251)
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4661)
+#pragma warning (disable: 4715)
+#pragma warning (disable: 4804)
+#pragma warning (disable: 4819)
+#pragma warning (disable: 4919)
+#pragma warning (disable: 4996)
+#pragma warning (disable: 6031)
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Task of a pool
+	typedef std::function<void()> AutoFileSyncTask;
+
+	// class AutoFileSyncPool
+	// Threads shared by several jobs, each queuing its tasks in a lane of its own
+	//
+	// The lanes holding tasks are served round robin, one task each per turn, so a job queuing
+	// thousands of tasks only gets its share of the threads while the others have work too.
+	// Nothing waits for a whole pool, a job counts its own tasks (a latch) to wait for them.
+	class AutoFileSyncPool
+	{
+	private:
+		// Lanes (tasks queued, and whether the lane is open), and the lane to serve next
+		std::mutex _mutex;
+		std::condition_variable _cv;
+		std::vector<std::deque<AutoFileSyncTask>> _lanes;
+		std::vector<char> _open;
+		size_t _next = 0;
+
+		// Threads, and their stop signal
+		std::vector<std::thread> _threads;
+		bool _stop = false;
+
+	public:
+		// Constructor, with a number of threads (at least one)
+		AutoFileSyncPool(size_t threads) noexcept;
+
+		// Destructor, stops the threads once every queued task has run
+		~AutoFileSyncPool() noexcept;
+
+		// Copy constructor = delete
+		AutoFileSyncPool(const AutoFileSyncPool& y) noexcept = delete;
+		AutoFileSyncPool& operator=(const AutoFileSyncPool& y) noexcept = delete;
+
+		// Threads
+		size_t threads() const noexcept;
+
+		// Open a lane for a job, reusing a closed one
+		size_t open() noexcept;
+
+		// Close a lane (its tasks queued still run)
+		void close(size_t lane) noexcept;
+
+		// Queue a task in a lane
+		void submit(size_t lane, AutoFileSyncTask&& task) noexcept;
+
+	private:
+		// A thread, running the tasks of the lanes in turn until stopped
+		void _work() noexcept;
+	};
+
+	// class AutoFileSyncShared
+	// Resources of a daemon shared by all its synchronizors (jobs)
+	//
+	// One hashing pool and one copy pool instead of two per job, one buffer pool, and a cap of
+	// the hashing batches and copies using the same device at once, whichever job they are of.
+	class AutoFileSyncShared
+	{
+	public:
+		// Pools of the hashing passes and of the snapshot copies
+		AutoFileSyncPool chck;
+		AutoFileSyncPool sync;
+
+		// Buffers of the reads
+		AutoFileSyncBufferPool buffers;
+
+		// Hashing batches and copies using the same device at once (0 for no cap)
+		AutoFileSyncCopyGate devices;
+
+	public:
+		// Constructor, threads of each pool and the cap of each device
+		AutoFileSyncShared(size_t threads, long long devicecap = 0) noexcept;
+
+		// Copy constructor = delete
+		AutoFileSyncShared(const AutoFileSyncShared& y) noexcept = delete;
+		AutoFileSyncShared& operator=(const AutoFileSyncShared& y) noexcept = delete;
+	};
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,188 @@
+// AutoFileSyncReader.cpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <cerrno>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#include "AutoFileSyncReader.hpp"
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Read a whole file in order through buffers borrowed from a pool, false if it cannot be read
+	bool read_file(const std::string& filepath, AutoFileSyncBufferPool& buffers,
+		unsigned long long sizehint, size_t depth, const AutoFileSyncConsumer& consume) noexcept
+	{
+		// Open it, and its size then (read up to there)
+#if defined(_WIN32)
+		HANDLE handle = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (handle == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		LARGE_INTEGER large = {};
+		if (GetFileSizeEx(handle, &large) == FALSE)
+		{
+			CloseHandle(handle);
+			return false;
+		}
+		const unsigned long long size = (unsigned long long)large.QuadPart;
+#else
+		int fd = open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			return false;
+		}
+		struct stat st;
+		if (fstat(fd, &st) != 0 || S_ISREG(st.st_mode) == false)
+		{
+			close(fd);
+			return false;
+		}
+		const unsigned long long size = (unsigned long long)st.st_size;
+#endif
+
+		// Borrow a buffer sized to the file (its contents are never read before being filled)
+		AutoFileSyncBuffer buffer = buffers.borrow(sizehint);
+		if (buffer.data == nullptr)
+		{
+#if defined(_WIN32)
+			CloseHandle(handle);
+#else
+			close(fd);
+#endif
+			return false;
+		}
+
+		// Read ahead only if the file spans more than one buffer, depth chunks requested at first
+#if defined(__linux__)
+		const unsigned long long window = (depth > 1 && size > buffer.size ? (unsigned long long)depth * buffer.size : 0);
+		if (window > 0)
+		{
+			posix_fadvise(fd, 0, (off_t)window, POSIX_FADV_WILLNEED);
+		}
+#else
+		(void)depth;
+#endif
+
+		// Positional reads, a failed read or an end before the size fails it (the file shrank)
+		unsigned long long done = 0;
+		while (done < size)
+		{
+			size_t want = (size_t)(size - done < buffer.size ? size - done : buffer.size);
+#if defined(__linux__)
+			// One more chunk requested as one is taken, so depth reads stay queued on the device
+			if (window > 0 && done + window < size)
+			{
+				posix_fadvise(fd, (off_t)(done + window), (off_t)buffer.size, POSIX_FADV_WILLNEED);
+			}
+#endif
+#if defined(_WIN32)
+			OVERLAPPED position = {};
+			position.Offset = (DWORD)(done & 0xFFFFFFFFULL);
+			position.OffsetHigh = (DWORD)(done >> 32);
+			DWORD got = 0;
+			if (ReadFile(handle, buffer.data, (DWORD)want, &got, &position) == FALSE || got == 0)
+			{
+				break;
+			}
+#else
+			ssize_t got = pread(fd, buffer.data, want, (off_t)done);
+			if (got < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (got <= 0)
+			{
+				break;
+			}
+#endif
+			consume(buffer.data, (size_t)got);
+			done += (unsigned long long)got;
+		}
+
+#if defined(_WIN32)
+		CloseHandle(handle);
+#else
+		close(fd);
+#endif
+		buffers.giveback(buffer);
+		return done == size;
+	}
+
+	// Read a range of a file in order through one buffer borrowed from a pool, false unless it is read whole
+	bool read_range(const std::string& filepath, unsigned long long offset, unsigned long long length,
+		AutoFileSyncBufferPool& buffers, const AutoFileSyncConsumer& consume) noexcept
+	{
+		AutoFileSyncBuffer buffer = buffers.borrow(length);
+		if (buffer.data == nullptr)
+		{
+			return false;
+		}
+
+#if defined(_WIN32)
+		HANDLE handle = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (handle == INVALID_HANDLE_VALUE)
+		{
+			buffers.giveback(buffer);
+			return false;
+		}
+#else
+		int fd = open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			buffers.giveback(buffer);
+			return false;
+		}
+#endif
+
+		// Positional reads, a short read before the end of the range fails it (the file shrank)
+		unsigned long long done = 0;
+		while (done < length)
+		{
+			size_t want = (size_t)(length - done < buffer.size ? length - done : buffer.size);
+			unsigned long long at = offset + done;
+#if defined(_WIN32)
+			OVERLAPPED position = {};
+			position.Offset = (DWORD)(at & 0xFFFFFFFFULL);
+			position.OffsetHigh = (DWORD)(at >> 32);
+			DWORD got = 0;
+			if (ReadFile(handle, buffer.data, (DWORD)want, &got, &position) == FALSE || got == 0)
+			{
+				break;
+			}
+#else
+			ssize_t got = pread(fd, buffer.data, want, (off_t)at);
+			if (got <= 0)
+			{
+				break;
+			}
+#endif
+			consume(buffer.data, (size_t)got);
+			done += (unsigned long long)got;
+		}
+
+#if defined(_WIN32)
+		CloseHandle(handle);
+#else
+		close(fd);
+#endif
+		buffers.giveback(buffer);
+		return done == length;
+	}
+
+}
+// Namespace AutoFileSync ends
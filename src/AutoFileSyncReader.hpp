@@ -0,0 +1,50 @@
+// AutoFileSyncReader.hpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <string>
+#include <functional>
+
+#include "AutoFileSyncBuffers.hpp"
+
+#pragma once
+
+#pragma warning (disable: 4018)
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4251)
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4661)
+#pragma warning (disable: 4715)
+#pragma warning (disable: 4804)
+#pragma warning (disable: 4819)
+#pragma warning (disable: 4919)
+#pragma warning (disable: 4996)
+#pragma warning (disable: 6031)
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Consumer of the chunks of a file, called in file order
+	typedef std::function<void(unsigned char* data, size_t len)> AutoFileSyncConsumer;
+
+	// Read a whole file in order through buffers borrowed from a pool, false if it cannot be read
+	// 
+	// With depth 1 (or a file fitting one buffer) it reads then consumes chunk by chunk.
+	// With depth N the N chunks after the one read are requested ahead (posix_fadvise on
+	// linux, the system read ahead elsewhere), so they are queued on the device while the
+	// consumer works, and a large file takes about max(read, consume) instead of their sum.
+	// It is read up to its size once opened, a failed read or an earlier end fails it.
+	// sizehint is the expected file size.
+	bool read_file(const std::string& filepath, AutoFileSyncBufferPool& buffers,
+		unsigned long long sizehint, size_t depth, const AutoFileSyncConsumer& consume) noexcept;
+
+	// Read a range of a file in order through one buffer borrowed from a pool, false unless it is read whole
+	// Note ranges of the same file may be read by different threads at once (positional reads)
+	bool read_range(const std::string& filepath, unsigned long long offset, unsigned long long length,
+		AutoFileSyncBufferPool& buffers, const AutoFileSyncConsumer& consume) noexcept;
+
+}
+// Namespace AutoFileSync ends
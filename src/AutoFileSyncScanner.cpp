@@ -0,0 +1,413 @@
+// AutoFileSyncScanner.cpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <mutex>
+#include <deque>
+#include <latch>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <cstddef>
+#include <condition_variable>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#endif
+
+#include "AutoFileSyncScanner.hpp"
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Utils (not headerable)
+	// Kernel - a folder to list, with an open handle of it (-1 to open it from the root)
+	struct _afsync_scan_folder
+	{
+		std::string relpath = "";
+		int fd = -1;
+	};
+
+	// Utils (not headerable)
+	// Kernel - the stack of folders to list of one thread, the owner pops at the back, thieves at the front
+	struct _afsync_scan_stack
+	{
+		std::mutex mutex;
+		std::deque<_afsync_scan_folder> folders;
+	};
+
+	// Folder handles kept open while queued, beyond that queued folders are opened again from the root
+	constexpr int _afsync_scan_handles = 256;
+
+	// Utils (not headerable)
+	// Kernel - whether a name is . or ..
+	inline bool _afsync_util_scan_dots(const char* name) noexcept
+	{
+		return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+	}
+
+	// Utils (not headerable)
+	// Kernel - list a folder into a batch, its subfolders to walk into subfolders (false if it cannot be listed,
+	// broken unless it was simply gone: removed, or replaced by a file)
+	// Note rootfd is the open root (unused on windows, where folders are listed by path)
+	bool _afsync_util_scan_list(const std::string& root, int rootfd, _afsync_scan_folder& folder, bool walk,
+		const AutoFileSyncExcluder& excluder, std::atomic<int>& handles,
+		AutoFileSyncScanBatch& batch, std::vector<_afsync_scan_folder>& subfolders, bool& broken) noexcept
+	{
+		broken = false;
+		batch.folder = folder.relpath;
+		batch.files.clear();
+		batch.folders.clear();
+		subfolders.clear();
+		const bool toplevel = folder.relpath.empty();
+
+		// Lambda to get the path of an entry relative to the root
+		auto relpather = [&](const char* name) -> std::string
+		{
+			return toplevel ? std::string(name) : folder.relpath + "/" + name;
+		};
+
+		// Lambda to register a file, unless excluded
+		auto file = [&](const char* name) -> void
+		{
+			if (excluder.empty() == false && excluder.excluded(relpather(name), false) == true)
+			{
+				return;
+			}
+			batch.files.push_back(name);
+		};
+
+		// Lambda to register a subfolder, unless excluded
+		auto subfolder = [&](const char* name, int parentfd) -> void
+		{
+			if (walk == false)
+			{
+				return;
+			}
+			_afsync_scan_folder sub;
+			sub.relpath = relpather(name);
+			if (excluder.empty() == false && excluder.excluded(sub.relpath, true) == true)
+			{
+				return;
+			}
+#if !defined(_WIN32)
+			// Keep it open (relative to its parent) while there are handles to spare
+			if (handles.fetch_add(1) < _afsync_scan_handles)
+			{
+				sub.fd = openat(parentfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+			}
+			if (sub.fd < 0)
+			{
+				handles.fetch_sub(1);
+			}
+#endif
+			batch.folders.push_back(name);
+			subfolders.emplace_back(std::move(sub));
+		};
+
+#if defined(_WIN32)
+		// Basic info and large fetches, the attributes come with the names
+		std::string pattern = root + "/" + (toplevel ? std::string("") : folder.relpath + "/") + "*";
+		WIN32_FIND_DATAA data;
+		HANDLE find = FindFirstFileExA(pattern.c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+		if (find == INVALID_HANDLE_VALUE)
+		{
+			DWORD error = GetLastError();
+			broken = (error != ERROR_FILE_NOT_FOUND && error != ERROR_PATH_NOT_FOUND && error != ERROR_DIRECTORY);
+			return false;
+		}
+		do
+		{
+			if (_afsync_util_scan_dots(data.cFileName) == true)
+			{
+				continue;
+			}
+
+			// Junctions and folder links are not followed
+			if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+			{
+				if ((data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0)
+				{
+					subfolder(data.cFileName, -1);
+				}
+			}
+			else if ((data.dwFileAttributes & FILE_ATTRIBUTE_DEVICE) == 0)
+			{
+				file(data.cFileName);
+			}
+		} while (FindNextFileA(find, &data) != FALSE);
+		broken = (GetLastError() != ERROR_NO_MORE_FILES);
+		FindClose(find);
+		return broken == false;
+
+#else
+		(void)root;
+
+		// Open it, from the root if no handle was kept
+		int fd = folder.fd;
+		if (fd >= 0)
+		{
+			folder.fd = -1;
+			handles.fetch_sub(1);
+		}
+		else
+		{
+			fd = openat(rootfd, toplevel ? "." : folder.relpath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		}
+		if (fd < 0)
+		{
+			broken = (errno != ENOENT && errno != ENOTDIR);
+			return false;
+		}
+
+		// Lambda to register an entry by its type, a stat only if the type is unknown or a link
+		auto entry = [&](const char* name, unsigned char type) -> void
+		{
+			if (_afsync_util_scan_dots(name) == true)
+			{
+				return;
+			}
+			if (type == DT_UNKNOWN || type == DT_LNK)
+			{
+				// Links to files are files, links to folders are not followed
+				struct stat st;
+				if (fstatat(fd, name, &st, type == DT_LNK ? 0 : AT_SYMLINK_NOFOLLOW) != 0)
+				{
+					return;
+				}
+				type = S_ISREG(st.st_mode) ? DT_REG : (S_ISDIR(st.st_mode) && type == DT_UNKNOWN ? DT_DIR : DT_UNKNOWN);
+			}
+			if (type == DT_REG)
+			{
+				file(name);
+			}
+			else if (type == DT_DIR)
+			{
+				subfolder(name, fd);
+			}
+		};
+
+	#if defined(__linux__)
+		// Raw getdents64, many entries per call into a buffer of our own
+		// Note entries are u64 d_ino, s64 d_off, u16 d_reclen, u8 d_type, then the name
+		alignas(8) static thread_local char entries[65536];
+		while (true)
+		{
+			long got = syscall(SYS_getdents64, fd, entries, sizeof(entries));
+			if (got < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (got <= 0)
+			{
+				broken = (got < 0);
+				break;
+			}
+			for (long pos = 0; pos < got;)
+			{
+				unsigned short reclen = 0;
+				std::memcpy(&reclen, entries + pos + 16, sizeof(reclen));
+				entry(entries + pos + 19, (unsigned char)entries[pos + 18]);
+				pos += reclen;
+			}
+		}
+		close(fd);
+	#else
+		DIR* dir = fdopendir(fd);
+		if (dir == nullptr)
+		{
+			close(fd);
+			return false;
+		}
+		errno = 0;
+		for (struct dirent* it = readdir(dir); it != nullptr; it = readdir(dir))
+		{
+			entry(it->d_name, it->d_type);
+			errno = 0;
+		}
+		broken = (errno != 0);
+		closedir(dir);
+	#endif
+		return broken == false;
+
+#endif
+	}
+
+	// Walk a folder tree, handing every listed folder to sink as soon as it is listed, false if the root
+	// cannot be listed or a listing broke off (the tree would look partly deleted)
+	bool scan_tree(const std::string& root, bool recursive, const AutoFileSyncExcluder& excluder,
+		int threads, const AutoFileSyncScanRunner& runner, const AutoFileSyncScanSink& sink,
+		const AutoFileSyncScanIdle& idle) noexcept
+	{
+		int rootfd = -1;
+#if !defined(_WIN32)
+		rootfd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (rootfd < 0)
+		{
+			return false;
+		}
+#endif
+		std::atomic<int> handles = 0;
+
+		// The root first, on this thread (its subfolders seed the stacks)
+		AutoFileSyncScanBatch batch;
+		_afsync_scan_folder top;
+		std::vector<_afsync_scan_folder> subfolders;
+		bool broken = false;
+		if (_afsync_util_scan_list(root, rootfd, top, recursive, excluder, handles, batch, subfolders, broken) == false)
+		{
+#if !defined(_WIN32)
+			close(rootfd);
+#endif
+			return false;
+		}
+		sink(batch);
+
+		// Stacks, seeded round robin, folders queued in them, and folders queued or being listed
+		size_t count = (threads < 1 || subfolders.empty() == true ? 1 : (size_t)threads);
+		std::vector<_afsync_scan_stack> stacks(count);
+		for (size_t i = 0; i < subfolders.size(); ++i)
+		{
+			stacks[i % count].folders.emplace_back(std::move(subfolders[i]));
+		}
+		std::atomic<size_t> queued = subfolders.size();
+		std::atomic<size_t> pending = subfolders.size();
+		std::atomic<bool> failed = false;
+
+		// Walkers with nothing to steal (nor idle work) sleep until folders are queued, one is listed (it may
+		// bring idle work) or the walk is over
+		std::mutex idle_mutex;
+		std::condition_variable idle_cv;
+		std::atomic<size_t> listed = 0;
+		std::atomic<int> sleeping = 0;
+		auto wakeup = [&idle_mutex, &idle_cv]() -> void
+		{
+			std::lock_guard<std::mutex> lock(idle_mutex);
+			idle_cv.notify_all();
+		};
+
+		// Lambda, one per walker, listing its own folders depth first and stealing the shallowest of the others
+		auto __ = [&](size_t self) -> void
+		{
+			AutoFileSyncScanBatch batch;
+			std::vector<_afsync_scan_folder> subfolders;
+			while (pending.load() > 0 && failed == false)
+			{
+				// Own stack, then the others
+				_afsync_scan_folder folder;
+				bool got = false;
+				for (size_t k = 0; k < count && got == false; ++k)
+				{
+					_afsync_scan_stack& stack = stacks[(self + k) % count];
+					std::lock_guard<std::mutex> lock(stack.mutex);
+					if (stack.folders.empty() == false)
+					{
+						if (k == 0)
+						{
+							folder = std::move(stack.folders.back());
+							stack.folders.pop_back();
+						}
+						else
+						{
+							folder = std::move(stack.folders.front());
+							stack.folders.pop_front();
+						}
+						--queued;
+						got = true;
+					}
+				}
+				if (got == false)
+				{
+					const size_t seen = listed.load();
+					if (idle != nullptr && idle() == true)
+					{
+						continue;
+					}
+					std::unique_lock<std::mutex> lock(idle_mutex);
+					++sleeping;
+					idle_cv.wait(lock, [&]()
+						{
+							return queued.load() > 0 || pending.load() == 0 || failed == true || (idle != nullptr && listed.load() != seen);
+						});
+					--sleeping;
+					continue;
+				}
+
+				// List it, queueing its subfolders before it stops counting as pending
+				// Note a folder gone meanwhile is skipped, one that cannot be opened otherwise (no permission, out of
+				// handles, ...) or whose listing broke off fails the walk
+				bool broken = false;
+				if (_afsync_util_scan_list(root, rootfd, folder, true, excluder, handles, batch, subfolders, broken) == true)
+				{
+					pending += subfolders.size();
+					{
+						std::lock_guard<std::mutex> lock(stacks[self].mutex);
+						for (_afsync_scan_folder& sub : subfolders)
+						{
+							stacks[self].folders.emplace_back(std::move(sub));
+						}
+					}
+					if (subfolders.empty() == false)
+					{
+						queued += subfolders.size();
+						wakeup();
+					}
+					const bool files = batch.files.empty() == false;
+					sink(batch);
+					++listed;
+					if (idle != nullptr && files == true && sleeping.load() > 0)
+					{
+						wakeup();
+					}
+				}
+				else if (broken == true)
+				{
+					failed = true;
+				}
+				if (--pending == 0 || failed == true)
+				{
+					wakeup();
+				}
+			}
+			return;
+		};
+
+		// The other walkers on the runner, this thread works as well
+		std::latch done((std::ptrdiff_t)count - 1);
+		for (size_t k = 1; k < count; ++k)
+		{
+			runner([&__, &done, k]() { __(k); done.count_down(); });
+		}
+		__(0);
+		done.wait();
+
+		// Handles of the folders left by a failed walk
+#if !defined(_WIN32)
+		for (_afsync_scan_stack& stack : stacks)
+		{
+			for (_afsync_scan_folder& folder : stack.folders)
+			{
+				if (folder.fd >= 0)
+				{
+					close(folder.fd);
+				}
+			}
+		}
+		close(rootfd);
+#endif
+		return failed == false;
+	}
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,66 @@
+// AutoFileSyncScanner.hpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "AutoFileSyncExcluder.hpp"
+
+#pragma once
+
+#pragma warning (disable: 4018)
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4251)
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4661)
+#pragma warning (disable: 4715)
+#pragma warning (disable: 4804)
+#pragma warning (disable: 4819)
+#pragma warning (disable: 4919)
+#pragma warning (disable: 4996)
+#pragma warning (disable: 6031)
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// struct AutoFileSyncScanBatch
+	// A folder listed by the scanner (relative to the root, "" for the root itself, forward slashes)
+	// with the names of its regular files and of its subfolders being walked
+	struct AutoFileSyncScanBatch
+	{
+		std::string folder = "";
+		std::vector<std::string> files;
+		std::vector<std::string> folders;
+	};
+
+	// Consumer of the listed folders, called from the walking threads (it must be thread-safe)
+	typedef std::function<void(AutoFileSyncScanBatch& batch)> AutoFileSyncScanSink;
+
+	// Runner of the walking tasks on other threads (a threadpool)
+	typedef std::function<void(std::function<void()>&& task)> AutoFileSyncScanRunner;
+
+	// Work of a walker with no folder to list, false if there was none (then it sleeps until folders are queued)
+	typedef std::function<bool()> AutoFileSyncScanIdle;
+
+	// Walk a folder tree, handing every listed folder to sink as soon as it is listed, false if the root
+	// cannot be listed or a listing broke off (the tree would look partly deleted)
+	//
+	// Folders are listed relative to an open handle of their parent (openat and getdents64 on
+	// linux) and entries are told apart by their type, so a file costs no stat. The calling thread
+	// and (threads - 1) tasks of runner walk it, each with its own stack of folders to list, stealing
+	// from the others once it runs dry, then doing idle work (the files listed so far) if given,
+	// and sleeping while there is nothing to do.
+	// Only the root is listed unless recursive, files and folders excluded by excluder are left
+	// out at any depth (excluded folders are never opened), and symbolic links to folders are not followed.
+	// Note a folder removed before it is opened is left out, any other failure to open one fails the walk as well.
+	bool scan_tree(const std::string& root, bool recursive, const AutoFileSyncExcluder& excluder,
+		int threads, const AutoFileSyncScanRunner& runner, const AutoFileSyncScanSink& sink,
+		const AutoFileSyncScanIdle& idle = nullptr) noexcept;
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,172 @@
+// AutoFileSyncScheduler.cpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <algorithm>
+
+#include "AutoFileSyncScheduler.hpp"
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Constructor, for a number of workers (at least one)
+	AutoFileSyncScheduler::AutoFileSyncScheduler(size_t workers) noexcept
+		: _deques(workers < 1 ? 1 : workers)
+	{
+		return;
+	}
+
+	// Cut items [0, weights.size()) into batches and deal them (call before the workers start)
+	void AutoFileSyncScheduler::plan(const std::vector<unsigned long long>& weights, size_t maxitems, unsigned long long maxweight) noexcept
+	{
+		// Coalesce consecutive items, an item that would overflow a batch starts the next one
+		std::vector<AutoFileSyncBatch> batches;
+		AutoFileSyncBatch batch;
+		for (size_t i = 0; i < weights.size(); ++i)
+		{
+			if (batch.end > batch.begin && (batch.end - batch.begin >= maxitems || batch.weight + weights[i] > maxweight))
+			{
+				batches.push_back(batch);
+				batch.begin = i;
+				batch.weight = 0;
+			}
+			batch.end = i + 1;
+			batch.weight += weights[i];
+		}
+		if (batch.end > batch.begin)
+		{
+			batches.push_back(batch);
+		}
+
+		// Deal the heaviest first, round robin
+		std::stable_sort(batches.begin(), batches.end(), [](const AutoFileSyncBatch& x, const AutoFileSyncBatch& y) -> bool
+			{
+				return x.weight > y.weight;
+			});
+		for (size_t k = 0; k < batches.size(); ++k)
+		{
+			this->_deques[k % this->_deques.size()].batches.push_back(batches[k]);
+		}
+	}
+
+	// Workers
+	size_t AutoFileSyncScheduler::workers() const noexcept
+	{
+		return this->_deques.size();
+	}
+
+	// Next batch of a worker, its own first, then stolen, false once none is left anywhere
+	// Note nothing is added once the workers start, so empty deques everywhere mean done
+	bool AutoFileSyncScheduler::next(size_t worker, AutoFileSyncBatch& batch) noexcept
+	{
+		const size_t count = this->_deques.size();
+		for (size_t k = 0; k < count; ++k)
+		{
+			_deque& deque = this->_deques[(worker + k) % count];
+			std::lock_guard<std::mutex> lock(deque.mutex);
+			if (deque.batches.empty() == true)
+			{
+				continue;
+			}
+			if (k == 0)
+			{
+				batch = deque.batches.front();
+				deque.batches.pop_front();
+			}
+			else
+			{
+				batch = deque.batches.back();
+				deque.batches.pop_back();
+			}
+			return true;
+		}
+		return false;
+	}
+
+	// Offer a help to idle workers
+	void AutoFileSyncScheduler::offer(const std::shared_ptr<AutoFileSyncHelp>& help) noexcept
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		this->_helps.push_back(help);
+		this->_cv.notify_all();
+		return;
+	}
+
+	// Withdraw a help (once the owner is done with it)
+	void AutoFileSyncScheduler::withdraw(const std::shared_ptr<AutoFileSyncHelp>& help) noexcept
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		this->_helps.remove(help);
+		return;
+	}
+
+	// A worker starts taking batches
+	void AutoFileSyncScheduler::enter() noexcept
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		++this->_busy;
+		return;
+	}
+
+	// A worker ran out of batches, helping the others until every worker entered is idle
+	// Note only workers that entered are waited for, a worker the threadpool has not started yet
+	// (or runs after this one, on the same thread) finds nothing to wait for and leaves at once
+	void AutoFileSyncScheduler::idle() noexcept
+	{
+		std::unique_lock<std::mutex> lock(this->_mutex);
+		--this->_busy;
+		this->_cv.notify_all();
+		while (true)
+		{
+			this->_cv.wait(lock, [this]() { return this->_helps.empty() == false || this->_busy == 0; });
+			if (this->_helps.empty() == true)
+			{
+				return;
+			}
+
+			// A piece of the oldest help, dropped once it has nothing left to take
+			std::shared_ptr<AutoFileSyncHelp> help = this->_helps.front();
+			lock.unlock();
+			bool more = (*help)();
+			lock.lock();
+			if (more == false)
+			{
+				this->_helps.remove(help);
+			}
+		}
+	}
+
+	// A piece of the oldest help offered, without waiting, false if none is offered
+	// Note for workers that must not block their thread (a shared pool), they leave instead of idling
+	bool AutoFileSyncScheduler::help() noexcept
+	{
+		std::unique_lock<std::mutex> lock(this->_mutex);
+		if (this->_helps.empty() == true)
+		{
+			return false;
+		}
+		std::shared_ptr<AutoFileSyncHelp> help = this->_helps.front();
+		lock.unlock();
+		bool more = (*help)();
+		lock.lock();
+		if (more == false)
+		{
+			this->_helps.remove(help);
+		}
+		return true;
+	}
+
+	// A worker out of batches and helps leaves, without waiting for the others
+	void AutoFileSyncScheduler::leave() noexcept
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		--this->_busy;
+		this->_cv.notify_all();
+		return;
+	}
+
+}
+// Namespace AutoFileSync ends
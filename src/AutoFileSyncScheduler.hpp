@@ -0,0 +1,110 @@
+// AutoFileSyncScheduler.hpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <list>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <condition_variable>
+
+#pragma once
+
+#pragma warning (disable: 4018)
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4251)
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4661)
+#pragma warning (disable: 4715)
+#pragma warning (disable: 4804)
+#pragma warning (disable: 4819)
+#pragma warning (disable: 4919)
+#pragma warning (disable: 4996)
+#pragma warning (disable: 6031)
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// struct AutoFileSyncBatch
+	// Consecutive items [begin, end) handed to a worker at once, and their estimated cost
+	struct AutoFileSyncBatch
+	{
+		size_t begin = 0;
+		size_t end = 0;
+		unsigned long long weight = 0;
+	};
+
+	// Work a busy worker offers to idle ones, one piece per call, false once nothing is left to take
+	typedef std::function<bool()> AutoFileSyncHelp;
+
+	// class AutoFileSyncScheduler
+	// Batches of items dealt to per-worker deques, idle workers stealing from the others
+	//
+	// Consecutive items are coalesced until a batch holds maxitems or maxweight, so a batch of
+	// small files costs one claim instead of one task each while a large file stays alone.
+	// Batches are dealt the heaviest first, round robin, so every worker starts with its share
+	// of the large ones. A worker takes from the front of its own deque and steals from the
+	// back of the others once it runs dry, so a worker stuck on a large file is relieved of
+	// the batches queued behind it. A worker out of batches idles on the helps offered by the
+	// busy ones (a huge file hashed in ranges) until every worker that entered is idle.
+	class AutoFileSyncScheduler
+	{
+	private:
+		// Deque of a worker
+		struct _deque
+		{
+			std::mutex mutex;
+			std::deque<AutoFileSyncBatch> batches;
+		};
+
+		// Deques, one per worker (never resized once built)
+		std::vector<_deque> _deques;
+
+		// Helps offered, and workers entered but not idle yet
+		std::mutex _mutex;
+		std::condition_variable _cv;
+		std::list<std::shared_ptr<AutoFileSyncHelp>> _helps;
+		size_t _busy = 0;
+
+	public:
+		// Constructor, for a number of workers (at least one)
+		AutoFileSyncScheduler(size_t workers) noexcept;
+
+		// Copy constructor = delete
+		AutoFileSyncScheduler(const AutoFileSyncScheduler& y) noexcept = delete;
+		AutoFileSyncScheduler& operator=(const AutoFileSyncScheduler& y) noexcept = delete;
+
+		// Cut items [0, weights.size()) into batches and deal them (call before the workers start)
+		void plan(const std::vector<unsigned long long>& weights, size_t maxitems, unsigned long long maxweight) noexcept;
+
+		// Workers
+		size_t workers() const noexcept;
+
+		// Next batch of a worker, its own first, then stolen, false once none is left anywhere
+		bool next(size_t worker, AutoFileSyncBatch& batch) noexcept;
+
+		// Offer a help to idle workers, and withdraw it (once the owner is done with it)
+		void offer(const std::shared_ptr<AutoFileSyncHelp>& help) noexcept;
+		void withdraw(const std::shared_ptr<AutoFileSyncHelp>& help) noexcept;
+
+		// A worker starts taking batches
+		void enter() noexcept;
+
+		// A worker ran out of batches, helping the others until every worker entered is idle
+		void idle() noexcept;
+
+		// A piece of the oldest help offered, without waiting, false if none is offered
+		// Note for workers that must not block their thread (a shared pool), they leave instead of idling
+		bool help() noexcept;
+
+		// A worker out of batches and helps leaves, without waiting for the others
+		void leave() noexcept;
+	};
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,302 @@
+// AutoFileSyncTable.cpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <cstring>
+#include <algorithm>
+
+#include "AutoFileSyncTable.hpp"
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Utils (not headerable)
+	// Kernel - hash of a path as its folder id and its name (FNV-1a, then mixed)
+	inline size_t _afsync_util_paths_hash(unsigned int folder, std::string_view name) noexcept
+	{
+		unsigned long long h = 14695981039346656037ULL ^ ((unsigned long long)folder * 0x9e3779b97f4a7c15ULL);
+		for (unsigned char c : name)
+		{
+			h ^= c;
+			h *= 1099511628211ULL;
+		}
+		h ^= h >> 29;
+		return (size_t)h;
+	}
+
+	// Utils (not headerable)
+	// Kernel - split a relative path into its folder and its name
+	inline void _afsync_util_paths_split(std::string_view relpath, std::string_view& folder, std::string_view& name) noexcept
+	{
+		size_t slash = relpath.find_last_of('/');
+		if (slash == std::string_view::npos)
+		{
+			folder = std::string_view();
+			name = relpath;
+		}
+		else
+		{
+			folder = relpath.substr(0, slash);
+			name = relpath.substr(slash + 1);
+		}
+	}
+
+	// Intern a path, its id (the existing one if already interned)
+	unsigned int AutoFileSyncPaths::intern(std::string_view relpath) noexcept
+	{
+		std::string_view foldername;
+		std::string_view name;
+		_afsync_util_paths_split(relpath, foldername, name);
+
+		// Folder (paths come folder by folder, so the last one is tried first)
+		unsigned int folder = this->_lastfolderid;
+		if (folder == npos || foldername != this->_lastfolder)
+		{
+			auto found = this->_folderids.find(std::string(foldername));
+			if (found == this->_folderids.end())
+			{
+				folder = (unsigned int)this->_folders.size();
+				this->_folders.emplace_back(foldername);
+				this->_folderids.emplace(std::string(foldername), folder);
+			}
+			else
+			{
+				folder = found->second;
+			}
+			this->_lastfolder = foldername;
+			this->_lastfolderid = folder;
+		}
+
+		// Name, if not interned yet
+		if ((this->_folder.size() + 1) * 2 > this->_slots.size())
+		{
+			this->_rehash(this->_folder.size() + 1);
+		}
+		size_t slot = this->_probe(folder, name);
+		if (this->_slots[slot] != 0)
+		{
+			return this->_slots[slot] - 1;
+		}
+		unsigned int id = (unsigned int)this->_folder.size();
+		this->_folder.push_back(folder);
+		this->_name.push_back(((unsigned long long)this->_names.size() << 16) | (unsigned long long)name.size());
+		this->_names.append(name);
+		this->_slots[slot] = id + 1;
+		return id;
+	}
+
+	// Id of a path, npos if not interned
+	unsigned int AutoFileSyncPaths::find(std::string_view relpath) const noexcept
+	{
+		std::string_view foldername;
+		std::string_view name;
+		_afsync_util_paths_split(relpath, foldername, name);
+
+		auto found = this->_folderids.find(std::string(foldername));
+		if (found == this->_folderids.end() || this->_slots.size() == 0)
+		{
+			return npos;
+		}
+		size_t slot = this->_probe(found->second, name);
+		return this->_slots[slot] == 0 ? npos : this->_slots[slot] - 1;
+	}
+
+	// Path of an id
+	std::string AutoFileSyncPaths::path(unsigned int id) const noexcept
+	{
+		const std::string& folder = this->_folders[this->_folder[id]];
+		std::string path;
+		path.reserve(folder.size() + 1 + (this->_name[id] & 0xFFFF));
+		if (folder.empty() == false)
+		{
+			path.append(folder);
+			path.push_back('/');
+		}
+		path.append(this->_names, (size_t)(this->_name[id] >> 16), (size_t)(this->_name[id] & 0xFFFF));
+		return path;
+	}
+
+	// Ids interned
+	size_t AutoFileSyncPaths::size() const noexcept
+	{
+		return this->_folder.size();
+	}
+
+	// Keep only the ids marked in keep (renumbered in order), old id -> new id (npos if dropped)
+	std::vector<unsigned int> AutoFileSyncPaths::compact(const std::vector<unsigned char>& keep) noexcept
+	{
+		AutoFileSyncPaths kept;
+		std::vector<unsigned int> remap(this->size(), npos);
+		for (unsigned int id = 0; id < (unsigned int)this->size(); ++id)
+		{
+			if (id < keep.size() && keep[id] != 0)
+			{
+				remap[id] = kept.intern(this->path(id));
+			}
+		}
+		*this = std::move(kept);
+		return remap;
+	}
+
+	// Slot of (folder, name), the empty one where it would go if not interned
+	size_t AutoFileSyncPaths::_probe(unsigned int folder, std::string_view name) const noexcept
+	{
+		const size_t mask = this->_slots.size() - 1;
+		size_t slot = _afsync_util_paths_hash(folder, name) & mask;
+		while (this->_slots[slot] != 0)
+		{
+			unsigned int id = this->_slots[slot] - 1;
+			if (this->_folder[id] == folder &&
+				std::string_view(this->_names.data() + (this->_name[id] >> 16), (size_t)(this->_name[id] & 0xFFFF)) == name)
+			{
+				break;
+			}
+			slot = (slot + 1) & mask;
+		}
+		return slot;
+	}
+
+	// Rebuild the slots for at least n ids
+	void AutoFileSyncPaths::_rehash(size_t n) noexcept
+	{
+		size_t slots = 1024;
+		while (slots < n * 2)
+		{
+			slots *= 2;
+		}
+		this->_slots.assign(slots, 0);
+		for (unsigned int id = 0; id < (unsigned int)this->_folder.size(); ++id)
+		{
+			std::string_view name(this->_names.data() + (this->_name[id] >> 16), (size_t)(this->_name[id] & 0xFFFF));
+			this->_slots[this->_probe(this->_folder[id], name)] = id + 1;
+		}
+	}
+
+	// Make room for ids [0, n) (new ones absent)
+	void AutoFileSyncFileTable::resize(size_t n) noexcept
+	{
+		if (n <= this->_present.size())
+		{
+			return;
+		}
+		this->_present.resize(n, 0);
+		this->_hash.resize(n);
+		this->_size.resize(n, 0);
+		this->_mtime.resize(n, 0);
+		this->_ctime.resize(n, 0);
+		this->_inode.resize(n, 0);
+		this->_dev.resize(n, 0);
+		this->_racy.resize(n, 0);
+		this->_blocks.resize(n);
+	}
+
+	// Make every id absent, keeping the room
+	void AutoFileSyncFileTable::clear() noexcept
+	{
+		std::fill(this->_present.begin(), this->_present.end(), 0);
+		for (std::shared_ptr<const AutoFileSyncBlockSums>& blocks : this->_blocks)
+		{
+			blocks.reset();
+		}
+	}
+
+	// Whether an id has a record
+	bool AutoFileSyncFileTable::has(unsigned int id) const noexcept
+	{
+		return id < this->_present.size() && this->_present[id] != 0;
+	}
+
+	// Record of an id (it must have one)
+	AutoFileSyncRecord AutoFileSyncFileTable::get(unsigned int id) const noexcept
+	{
+		AutoFileSyncRecord record;
+		record.hash = this->_hash[id];
+		record.size = this->_size[id];
+		record.mtime = this->_mtime[id];
+		record.ctime = this->_ctime[id];
+		record.inode = this->_inode[id];
+		record.dev = this->_dev[id];
+		record.racy = this->_racy[id] != 0;
+		record.blocks = this->_blocks[id];
+		return record;
+	}
+
+	// Size and mtime of an id (it must have a record)
+	unsigned long long AutoFileSyncFileTable::size_of(unsigned int id) const noexcept
+	{
+		return this->_size[id];
+	}
+
+	long long AutoFileSyncFileTable::mtime_of(unsigned int id) const noexcept
+	{
+		return this->_mtime[id];
+	}
+
+	// Set or remove the record of an id
+	void AutoFileSyncFileTable::set(unsigned int id, const AutoFileSyncRecord& record) noexcept
+	{
+		this->_present[id] = 1;
+		this->_hash[id] = record.hash;
+		this->_size[id] = record.size;
+		this->_mtime[id] = record.mtime;
+		this->_ctime[id] = record.ctime;
+		this->_inode[id] = record.inode;
+		this->_dev[id] = record.dev;
+		this->_racy[id] = record.racy ? 1 : 0;
+		this->_blocks[id] = record.blocks;
+	}
+
+	void AutoFileSyncFileTable::erase(unsigned int id) noexcept
+	{
+		if (id < this->_present.size())
+		{
+			this->_present[id] = 0;
+			this->_blocks[id].reset();
+		}
+	}
+
+	// Ids with room, and ids with a record
+	size_t AutoFileSyncFileTable::size() const noexcept
+	{
+		return this->_present.size();
+	}
+
+	size_t AutoFileSyncFileTable::count() const noexcept
+	{
+		return (size_t)std::count(this->_present.begin(), this->_present.end(), (unsigned char)1);
+	}
+
+	// Swap two generations
+	void AutoFileSyncFileTable::swap(AutoFileSyncFileTable& y) noexcept
+	{
+		this->_present.swap(y._present);
+		this->_hash.swap(y._hash);
+		this->_size.swap(y._size);
+		this->_mtime.swap(y._mtime);
+		this->_ctime.swap(y._ctime);
+		this->_inode.swap(y._inode);
+		this->_dev.swap(y._dev);
+		this->_racy.swap(y._racy);
+		this->_blocks.swap(y._blocks);
+	}
+
+	// Renumber after the paths were compacted (remap as returned by compact)
+	void AutoFileSyncFileTable::remap(const std::vector<unsigned int>& remap, size_t n) noexcept
+	{
+		AutoFileSyncFileTable table;
+		table.resize(n);
+		for (unsigned int id = 0; id < (unsigned int)this->_present.size() && id < remap.size(); ++id)
+		{
+			if (this->_present[id] != 0 && remap[id] != AutoFileSyncPaths::npos)
+			{
+				table.set(remap[id], this->get(id));
+			}
+		}
+		this->swap(table);
+	}
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,133 @@
+// AutoFileSyncTable.hpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+
+#include "AutoFileSyncFilestat.hpp"
+
+#pragma once
+
+#pragma warning (disable: 4018)
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4251)
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4661)
+#pragma warning (disable: 4715)
+#pragma warning (disable: 4804)
+#pragma warning (disable: 4819)
+#pragma warning (disable: 4919)
+#pragma warning (disable: 4996)
+#pragma warning (disable: 6031)
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// class AutoFileSyncPaths
+	// Interned paths (relative to the src, forward slashes) with dense ids, never moved once interned
+	//
+	// A path is its folder id and its name: every folder is kept once, names are kept back
+	// to back in one arena, and an open-addressed table maps (folder, name) to the id, so a
+	// path costs about its name plus 20 bytes instead of a full string and a map node.
+	class AutoFileSyncPaths
+	{
+	public:
+		// No path
+		static constexpr unsigned int npos = 0xFFFFFFFFU;
+
+	private:
+		// Folders ("" for the src itself) and their ids
+		std::vector<std::string> _folders;
+		std::unordered_map<std::string, unsigned int> _folderids;
+		std::string _lastfolder = "";
+		unsigned int _lastfolderid = npos;
+
+		// Names back to back, and per path its folder and its name (offset << 16 | length)
+		std::string _names;
+		std::vector<unsigned int> _folder;
+		std::vector<unsigned long long> _name;
+
+		// Open-addressed table of id + 1 (0 for empty), kept at most half full
+		std::vector<unsigned int> _slots;
+
+	public:
+		// Intern a path, its id (the existing one if already interned)
+		unsigned int intern(std::string_view relpath) noexcept;
+
+		// Id of a path, npos if not interned
+		unsigned int find(std::string_view relpath) const noexcept;
+
+		// Path of an id
+		std::string path(unsigned int id) const noexcept;
+
+		// Ids interned
+		size_t size() const noexcept;
+
+		// Keep only the ids marked in keep (renumbered in order), old id -> new id (npos if dropped)
+		std::vector<unsigned int> compact(const std::vector<unsigned char>& keep) noexcept;
+
+	private:
+		// Slot of (folder, name), the empty one where it would go if not interned
+		size_t _probe(unsigned int folder, std::string_view name) const noexcept;
+
+		// Rebuild the slots for at least n ids
+		void _rehash(size_t n) noexcept;
+	};
+
+	// class AutoFileSyncFileTable
+	// Records of one check indexed by path id, one column per field (structure of arrays)
+	// Note distinct ids may be set from different threads, as long as nothing resizes meanwhile
+	class AutoFileSyncFileTable
+	{
+	private:
+		std::vector<unsigned char> _present;
+		std::vector<AutoFileSyncDigest> _hash;
+		std::vector<unsigned long long> _size;
+		std::vector<long long> _mtime;
+		std::vector<long long> _ctime;
+		std::vector<unsigned long long> _inode;
+		std::vector<unsigned long long> _dev;
+		std::vector<unsigned char> _racy;
+		std::vector<std::shared_ptr<const AutoFileSyncBlockSums>> _blocks;
+
+	public:
+		// Make room for ids [0, n) (new ones absent)
+		void resize(size_t n) noexcept;
+
+		// Make every id absent, keeping the room
+		void clear() noexcept;
+
+		// Whether an id has a record
+		bool has(unsigned int id) const noexcept;
+
+		// Record of an id (it must have one)
+		AutoFileSyncRecord get(unsigned int id) const noexcept;
+
+		// Size and mtime of an id (it must have a record)
+		unsigned long long size_of(unsigned int id) const noexcept;
+		long long mtime_of(unsigned int id) const noexcept;
+
+		// Set or remove the record of an id
+		void set(unsigned int id, const AutoFileSyncRecord& record) noexcept;
+		void erase(unsigned int id) noexcept;
+
+		// Ids with room, and ids with a record
+		size_t size() const noexcept;
+		size_t count() const noexcept;
+
+		// Swap two generations
+		void swap(AutoFileSyncFileTable& y) noexcept;
+
+		// Renumber after the paths were compacted (remap as returned by compact)
+		void remap(const std::vector<unsigned int>& remap, size_t n) noexcept;
+	};
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,391 @@
+// AutoFileSyncUring.cpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#define AFSYNC_WITH_IO_URING 1
+#endif
+
+#include <cerrno>
+#include <cstring>
+
+#include "AutoFileSyncUring.hpp"
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+#if defined(AFSYNC_WITH_IO_URING)
+	// Steps of a file in flight (kept in the low bits of the user data)
+	constexpr unsigned long long _afsync_uring_open = 1;
+	constexpr unsigned long long _afsync_uring_read = 2;
+	constexpr unsigned long long _afsync_uring_close = 3;
+
+	// Utils (not headerable)
+	// Kernel - raw io_uring syscalls (no liburing needed)
+	inline int _afsync_uring_setup(unsigned entries, io_uring_params* params) noexcept
+	{
+		return (int)syscall(__NR_io_uring_setup, entries, params);
+	}
+	inline int _afsync_uring_enter(int fd, unsigned tosubmit, unsigned mincomplete, unsigned flags) noexcept
+	{
+		return (int)syscall(__NR_io_uring_enter, fd, tosubmit, mincomplete, flags, nullptr, 0);
+	}
+	inline int _afsync_uring_register(int fd, unsigned opcode, const void* arg, unsigned nargs) noexcept
+	{
+		return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nargs);
+	}
+
+	// Utils (not headerable)
+	// Kernel - whether a ring supports the operations of a batch
+	bool _afsync_uring_probe(int fd) noexcept
+	{
+		constexpr unsigned ops = 256;
+		std::vector<unsigned char> mem(sizeof(io_uring_probe) + ops * sizeof(io_uring_probe_op), 0);
+		io_uring_probe* probe = (io_uring_probe*)mem.data();
+		if (_afsync_uring_register(fd, IORING_REGISTER_PROBE, probe, ops) < 0)
+		{
+			return false;
+		}
+		for (unsigned op : { (unsigned)IORING_OP_OPENAT, (unsigned)IORING_OP_READ_FIXED, (unsigned)IORING_OP_CLOSE })
+		{
+			if (op > probe->last_op || (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+#endif
+
+	// Constructor (slots files in flight, read by chunks of chunksize bytes)
+	AutoFileSyncUring::AutoFileSyncUring(AutoFileSyncBufferPool& buffers, unsigned slots, size_t chunksize) noexcept
+	{
+#if defined(AFSYNC_WITH_IO_URING)
+		this->_buffers = &buffers;
+		if (slots == 0)
+		{
+			return;
+		}
+
+		// One submission per file in flight at most, so the queues never overflow
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		this->_fd = _afsync_uring_setup(slots, &params);
+		if (this->_fd < 0)
+		{
+			this->_fd = -1;
+			return;
+		}
+
+		// Map the queues
+		this->_sqringsize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		this->_cqringsize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0)
+		{
+			this->_sqringsize = this->_cqringsize = (this->_sqringsize > this->_cqringsize ? this->_sqringsize : this->_cqringsize);
+		}
+		this->_sqring = mmap(nullptr, this->_sqringsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->_fd, IORING_OFF_SQ_RING);
+		if (this->_sqring == MAP_FAILED)
+		{
+			this->_sqring = nullptr;
+			this->_close();
+			return;
+		}
+		if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0)
+		{
+			this->_cqring = this->_sqring;
+		}
+		else
+		{
+			this->_cqring = mmap(nullptr, this->_cqringsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->_fd, IORING_OFF_CQ_RING);
+			if (this->_cqring == MAP_FAILED)
+			{
+				this->_cqring = nullptr;
+				this->_close();
+				return;
+			}
+		}
+		this->_sqessize = params.sq_entries * sizeof(io_uring_sqe);
+		this->_sqes = mmap(nullptr, this->_sqessize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->_fd, IORING_OFF_SQES);
+		if (this->_sqes == MAP_FAILED)
+		{
+			this->_sqes = nullptr;
+			this->_close();
+			return;
+		}
+
+		unsigned char* sq = (unsigned char*)this->_sqring;
+		unsigned char* cq = (unsigned char*)this->_cqring;
+		this->_sqhead = (unsigned*)(sq + params.sq_off.head);
+		this->_sqtail = (unsigned*)(sq + params.sq_off.tail);
+		this->_sqmask = (unsigned*)(sq + params.sq_off.ring_mask);
+		this->_sqarray = (unsigned*)(sq + params.sq_off.array);
+		this->_cqhead = (unsigned*)(cq + params.cq_off.head);
+		this->_cqtail = (unsigned*)(cq + params.cq_off.tail);
+		this->_cqmask = (unsigned*)(cq + params.cq_off.ring_mask);
+		this->_cqes = cq + params.cq_off.cqes;
+
+		// The operations of a batch need linux 5.6+
+		if (_afsync_uring_probe(this->_fd) == false)
+		{
+			this->_close();
+			return;
+		}
+
+		// Borrow and register one buffer per slot
+		std::vector<iovec> iovecs;
+		for (unsigned i = 0; i < slots; ++i)
+		{
+			AutoFileSyncBuffer buffer = buffers.borrow(chunksize);
+			if (buffer.data == nullptr)
+			{
+				break;
+			}
+			this->_slots.push_back(buffer);
+			iovecs.push_back({ buffer.data, buffer.size });
+		}
+		if (this->_slots.empty() == true ||
+			_afsync_uring_register(this->_fd, IORING_REGISTER_BUFFERS, iovecs.data(), (unsigned)iovecs.size()) < 0)
+		{
+			this->_close();
+			return;
+		}
+#else
+		this->_buffers = &buffers;
+#endif
+	}
+
+	// Destructor
+	AutoFileSyncUring::~AutoFileSyncUring() noexcept
+	{
+		this->_close();
+	}
+
+	// Whether the ring is usable
+	bool AutoFileSyncUring::ready() const noexcept
+	{
+		return this->_fd >= 0;
+	}
+
+	// Read all the files of a batch, false if the ring failed (unfinished jobs are left not succeeded)
+	bool AutoFileSyncUring::read_batch(std::vector<AutoFileSyncReadJob>& jobs) noexcept
+	{
+		if (this->ready() == false)
+		{
+			return false;
+		}
+
+#if defined(AFSYNC_WITH_IO_URING)
+		// File in flight of each slot (job, fd, offset, whether it failed)
+		struct inflight
+		{
+			size_t job = 0;
+			int fd = -1;
+			unsigned long long offset = 0;
+			bool failed = false;
+		};
+		std::vector<inflight> states(this->_slots.size());
+		std::vector<unsigned> freeslots;
+		for (unsigned i = (unsigned)this->_slots.size(); i > 0; --i)
+		{
+			freeslots.push_back(i - 1);
+		}
+
+		size_t next = 0;
+		size_t active = 0;
+		while (next < jobs.size() || active > 0)
+		{
+			// Open as many files as there are free slots
+			while (next < jobs.size() && freeslots.empty() == false)
+			{
+				unsigned slot = freeslots.back();
+				freeslots.pop_back();
+				states[slot] = inflight();
+				states[slot].job = next;
+				jobs[next].succeeded = false;
+				this->_queue(IORING_OP_OPENAT, AT_FDCWD, jobs[next].filepath.c_str(), 0, 0, slot);
+				++next;
+				++active;
+			}
+
+			// Submit and wait (on failure, close what is open and drop the ring)
+			if (this->_enter() == false)
+			{
+				for (inflight& state : states)
+				{
+					if (state.fd >= 0)
+					{
+						::close(state.fd);
+					}
+				}
+				this->_close();
+				return false;
+			}
+
+			// Reap the completions and queue the next step of their files
+			unsigned head = __atomic_load_n(this->_cqhead, __ATOMIC_RELAXED);
+			unsigned tail = __atomic_load_n(this->_cqtail, __ATOMIC_ACQUIRE);
+			for (; head != tail; ++head)
+			{
+				io_uring_cqe* cqe = (io_uring_cqe*)this->_cqes + (head & *this->_cqmask);
+				unsigned slot = (unsigned)(cqe->user_data >> 8);
+				unsigned long long step = cqe->user_data & 0xff;
+				inflight& state = states[slot];
+				AutoFileSyncBuffer& buffer = this->_slots[slot];
+
+				if (step == _afsync_uring_open)
+				{
+					if (cqe->res < 0)
+					{
+						freeslots.push_back(slot);
+						--active;
+						continue;
+					}
+					state.fd = cqe->res;
+					this->_queue(IORING_OP_READ_FIXED, state.fd, buffer.data, (unsigned)buffer.size, 0, slot, (unsigned short)slot);
+				}
+				else if (step == _afsync_uring_read)
+				{
+					// Only an empty read is the end, a short one may come anywhere (signals, network file systems)
+					if (cqe->res > 0)
+					{
+						jobs[state.job].consume(buffer.data, (size_t)cqe->res);
+						state.offset += (unsigned long long)cqe->res;
+					}
+					if (cqe->res < 0)
+					{
+						state.failed = true;
+					}
+					if (cqe->res > 0)
+					{
+						this->_queue(IORING_OP_READ_FIXED, state.fd, buffer.data, (unsigned)buffer.size, state.offset, slot, (unsigned short)slot);
+					}
+					else
+					{
+						this->_queue(IORING_OP_CLOSE, state.fd, nullptr, 0, 0, slot);
+					}
+				}
+				else
+				{
+					state.fd = -1;
+					jobs[state.job].succeeded = (state.failed == false);
+					freeslots.push_back(slot);
+					--active;
+				}
+			}
+			__atomic_store_n(this->_cqhead, head, __ATOMIC_RELEASE);
+		}
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	// Queue a submission
+	void AutoFileSyncUring::_queue(unsigned char opcode, int fd, const void* addr, unsigned len,
+		unsigned long long offset, unsigned slot, unsigned short bufindex) noexcept
+	{
+#if defined(AFSYNC_WITH_IO_URING)
+		unsigned tail = *this->_sqtail;
+		unsigned index = tail & *this->_sqmask;
+		io_uring_sqe* sqe = (io_uring_sqe*)this->_sqes + index;
+		memset(sqe, 0, sizeof(io_uring_sqe));
+		sqe->opcode = opcode;
+		sqe->fd = fd;
+		sqe->addr = (unsigned long long)addr;
+		sqe->len = len;
+		sqe->off = offset;
+		if (opcode == IORING_OP_OPENAT)
+		{
+			sqe->open_flags = O_RDONLY | O_CLOEXEC;
+		}
+		else if (opcode == IORING_OP_READ_FIXED)
+		{
+			sqe->buf_index = bufindex;
+		}
+		unsigned long long step = (opcode == IORING_OP_OPENAT ? _afsync_uring_open :
+			opcode == IORING_OP_READ_FIXED ? _afsync_uring_read : _afsync_uring_close);
+		sqe->user_data = ((unsigned long long)slot << 8) | step;
+		this->_sqarray[index] = index;
+		__atomic_store_n(this->_sqtail, tail + 1, __ATOMIC_RELEASE);
+		++this->_tosubmit;
+#endif
+	}
+
+	// Enter the queued submissions and wait for at least one completion
+	bool AutoFileSyncUring::_enter() noexcept
+	{
+#if defined(AFSYNC_WITH_IO_URING)
+		while (true)
+		{
+			int entered = _afsync_uring_enter(this->_fd, this->_tosubmit, 1, IORING_ENTER_GETEVENTS);
+			if (entered >= 0)
+			{
+				this->_tosubmit -= (unsigned)entered;
+				return true;
+			}
+			if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+			{
+				return false;
+			}
+		}
+#else
+		return false;
+#endif
+	}
+
+	// Release the ring and the buffers
+	void AutoFileSyncUring::_close() noexcept
+	{
+#if defined(AFSYNC_WITH_IO_URING)
+		if (this->_sqes != nullptr)
+		{
+			munmap(this->_sqes, this->_sqessize);
+			this->_sqes = nullptr;
+		}
+		if (this->_cqring != nullptr && this->_cqring != this->_sqring)
+		{
+			munmap(this->_cqring, this->_cqringsize);
+		}
+		this->_cqring = nullptr;
+		if (this->_sqring != nullptr)
+		{
+			munmap(this->_sqring, this->_sqringsize);
+			this->_sqring = nullptr;
+		}
+		if (this->_fd >= 0)
+		{
+			::close(this->_fd);
+			this->_fd = -1;
+		}
+#endif
+		for (AutoFileSyncBuffer& buffer : this->_slots)
+		{
+			this->_buffers->giveback(buffer);
+		}
+		this->_slots.clear();
+	}
+
+	// Whether io_uring batches can be used on this system
+	bool uring_available() noexcept
+	{
+		static const bool available = []() -> bool
+			{
+				AutoFileSyncBufferPool buffers;
+				AutoFileSyncUring ring(buffers, 1, 4096);
+				return ring.ready();
+			}();
+		return available;
+	}
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,110 @@
+// AutoFileSyncUring.hpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <string>
+#include <vector>
+
+#include "AutoFileSyncBuffers.hpp"
+#include "AutoFileSyncReader.hpp"
+
+#pragma once
+
+#pragma warning (disable: 4018)
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4251)
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4661)
+#pragma warning (disable: 4715)
+#pragma warning (disable: 4804)
+#pragma warning (disable: 4819)
+#pragma warning (disable: 4919)
+#pragma warning (disable: 4996)
+#pragma warning (disable: 6031)
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// struct AutoFileSyncReadJob
+	// A file to read whole in a batch, and whether it was read
+	struct AutoFileSyncReadJob
+	{
+		std::string filepath = "";
+		AutoFileSyncConsumer consume;
+		bool succeeded = false;
+	};
+
+	// class AutoFileSyncUring
+	// Batched reads of many files on one thread through io_uring (linux 5.6+)
+	// 
+	// Up to (slots) files are in flight at once, each with its open, reads and close
+	// submitted as soon as the previous step completes, so one thread keeps the device
+	// queue full without a syscall chain per file. Reads go into buffers borrowed from
+	// a pool and registered with the ring; every file is consumed in order.
+	// Elsewhere, or if the kernel lacks the operations, ready() is false.
+	class AutoFileSyncUring
+	{
+	private:
+		// Ring fd and its mapped queues
+		int _fd = -1;
+		void* _sqring = nullptr;
+		size_t _sqringsize = 0;
+		void* _cqring = nullptr;
+		size_t _cqringsize = 0;
+		void* _sqes = nullptr;
+		size_t _sqessize = 0;
+
+		// Queue pointers inside the mapped rings
+		unsigned* _sqhead = nullptr;
+		unsigned* _sqtail = nullptr;
+		unsigned* _sqmask = nullptr;
+		unsigned* _sqarray = nullptr;
+		unsigned* _cqhead = nullptr;
+		unsigned* _cqtail = nullptr;
+		unsigned* _cqmask = nullptr;
+		void* _cqes = nullptr;
+
+		// Submissions queued but not entered yet
+		unsigned _tosubmit = 0;
+
+		// Registered buffers, one per file in flight
+		AutoFileSyncBufferPool* _buffers = nullptr;
+		std::vector<AutoFileSyncBuffer> _slots;
+
+	public:
+		// Constructor (slots files in flight, read by chunks of chunksize bytes)
+		AutoFileSyncUring(AutoFileSyncBufferPool& buffers, unsigned slots = 32, size_t chunksize = 256 * 1024) noexcept;
+
+		// Destructor
+		~AutoFileSyncUring() noexcept;
+
+		// Copy constructor = delete
+		AutoFileSyncUring(const AutoFileSyncUring& y) noexcept = delete;
+		AutoFileSyncUring& operator=(const AutoFileSyncUring& y) noexcept = delete;
+
+		// Whether the ring is usable
+		bool ready() const noexcept;
+
+		// Read all the files of a batch, false if the ring failed (unfinished jobs are left not succeeded)
+		bool read_batch(std::vector<AutoFileSyncReadJob>& jobs) noexcept;
+
+	private:
+		// Queue a submission
+		void _queue(unsigned char opcode, int fd, const void* addr, unsigned len,
+			unsigned long long offset, unsigned slot, unsigned short bufindex = 0) noexcept;
+
+		// Enter the queued submissions and wait for at least one completion
+		bool _enter() noexcept;
+
+		// Release the ring and the buffers
+		void _close() noexcept;
+	};
+
+	// Whether io_uring batches can be used on this system
+	bool uring_available() noexcept;
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,607 @@
+// AutoFileSyncWatcher.cpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#elif defined(__linux__)
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/fanotify.h>
+#endif
+
+#include "AutoFileSyncWatcher.hpp"
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// Utils (not headerable)
+	// Kernel - steady clock now, in ns
+	inline long long _afsync_util_watch_now_ns() noexcept
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Constructor
+	AutoFileSyncWatcher::AutoFileSyncWatcher(const std::string& root, bool recursive) noexcept
+	{
+		this->_root = root;
+		std::replace(this->_root.begin(), this->_root.end(), '\\', '/');
+		while (this->_root.size() > 1 && this->_root.back() == '/')
+		{
+			this->_root.pop_back();
+		}
+		this->_recursive = recursive;
+	}
+
+	// Destructor
+	AutoFileSyncWatcher::~AutoFileSyncWatcher() noexcept
+	{
+		this->stop();
+	}
+
+	// Start watching with the first usable backend, false if none
+	bool AutoFileSyncWatcher::start() noexcept
+	{
+		if (this->_thread != nullptr)
+		{
+			return false;
+		}
+		this->_tostop = false;
+
+		// Fanotify reports folders with their links resolved, the src may be reached through one
+		std::error_code ec;
+		this->_resolved = std::filesystem::canonical(this->_root, ec).generic_string();
+		if (ec)
+		{
+			this->_resolved = this->_root;
+		}
+
+#if defined(_WIN32)
+		if (this->_start_readdir() == true)
+		{
+			this->_backend = "readdir";
+			this->_thread = new std::thread([this]() { this->_loop_readdir(); });
+			return true;
+		}
+#elif defined(__linux__)
+		// A filesystem-wide fanotify mark is only worth it for whole trees
+		if (this->_recursive == true && this->_start_fanotify() == true)
+		{
+			this->_backend = "fanotify";
+			this->_thread = new std::thread([this]() { this->_loop_fanotify(); });
+			return true;
+		}
+		if (this->_start_inotify() == true)
+		{
+			this->_backend = "inotify";
+			this->_thread = new std::thread([this]() { this->_loop_inotify(); });
+			return true;
+		}
+#endif
+
+		return false;
+	}
+
+	// Stop watching
+	void AutoFileSyncWatcher::stop() noexcept
+	{
+		if (this->_thread == nullptr)
+		{
+			return;
+		}
+
+		// Wake the event thread up and wait for it
+		this->_tostop = true;
+#if defined(_WIN32)
+		CancelSynchronousIo((HANDLE)this->_thread->native_handle());
+		this->_thread->join();
+		CloseHandle((HANDLE)this->_dirhandle);
+		this->_dirhandle = nullptr;
+#elif defined(__linux__)
+		unsigned long long one = 1;
+		write(this->_wakefd, &one, sizeof(one));
+		this->_thread->join();
+		close(this->_fd);
+		close(this->_wakefd);
+		if (this->_mountfd >= 0)
+		{
+			close(this->_mountfd);
+		}
+		this->_fd = -1;
+		this->_wakefd = -1;
+		this->_mountfd = -1;
+		this->_watches.clear();
+#endif
+
+		delete this->_thread;
+		this->_thread = nullptr;
+		this->_backend = "";
+	}
+
+	// Backend name, "" if not started
+	const char* AutoFileSyncWatcher::backend() const noexcept
+	{
+		return this->_backend;
+	}
+
+	// Whether anything was touched since the last take
+	bool AutoFileSyncWatcher::pending() const noexcept
+	{
+		return this->_pending;
+	}
+
+	// Time of the last event (steady clock, ns), 0 if none yet
+	long long AutoFileSyncWatcher::touched() const noexcept
+	{
+		return this->_touched;
+	}
+
+	// Set a callback of every event, called on the event thread (before starting)
+	void AutoFileSyncWatcher::onevent(const std::function<void()>& callback) noexcept
+	{
+		this->_onevent = callback;
+	}
+
+	// Take the dirty paths since the last take, false if events were lost (rescan everything)
+	bool AutoFileSyncWatcher::take(std::unordered_set<std::string>& dirty) noexcept
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		dirty.clear();
+		dirty.swap(this->_dirty);
+		bool lost = this->_overflow;
+		this->_overflow = false;
+		this->_pending = false;
+		return lost == false;
+	}
+
+	// Register a dirty path, false if not within the root
+	bool AutoFileSyncWatcher::_touch(const std::string& path) noexcept
+	{
+		// Lambda to tell whether a path is within a folder
+		auto within = [&path](const std::string& folder) -> bool
+		{
+			return path.size() > folder.size() && path.compare(0, folder.size(), folder) == 0 && path[folder.size()] == '/';
+		};
+
+		// Only paths within the root, as the root or with its links resolved (then mapped back to the root)
+		std::string touched = path;
+		if (within(this->_root) == false)
+		{
+			if (this->_resolved == this->_root || within(this->_resolved) == false)
+			{
+				return false;
+			}
+			touched = this->_root + path.substr(this->_resolved.size());
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			this->_dirty.insert(touched);
+			this->_touched = _afsync_util_watch_now_ns();
+			this->_pending = true;
+		}
+		if (this->_onevent)
+		{
+			this->_onevent();
+		}
+		return true;
+	}
+
+	// Register an overflow (events were lost)
+	void AutoFileSyncWatcher::_touch_overflow() noexcept
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			this->_overflow = true;
+			this->_touched = _afsync_util_watch_now_ns();
+			this->_pending = true;
+		}
+		if (this->_onevent)
+		{
+			this->_onevent();
+		}
+	}
+
+#if defined(__linux__)
+	// Backend - fanotify
+	bool AutoFileSyncWatcher::_start_fanotify() noexcept
+	{
+	#if defined(FAN_REPORT_DFID_NAME)
+		int fd = fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME, O_RDONLY | O_LARGEFILE);
+		if (fd < 0)
+		{
+			return false;
+		}
+
+		// Every change of a file or folder on the filesystem holding the root
+		const unsigned long long mask = FAN_MODIFY | FAN_CLOSE_WRITE | FAN_ATTRIB | FAN_CREATE | FAN_DELETE |
+			FAN_MOVED_FROM | FAN_MOVED_TO | FAN_DELETE_SELF | FAN_MOVE_SELF | FAN_ONDIR;
+		if (fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, mask, AT_FDCWD, this->_root.c_str()) != 0)
+		{
+			close(fd);
+			return false;
+		}
+
+		this->_fd = fd;
+		this->_mountfd = open(this->_root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		this->_wakefd = eventfd(0, EFD_CLOEXEC);
+		if (this->_mountfd < 0 || this->_wakefd < 0)
+		{
+			close(this->_fd);
+			close(this->_mountfd);
+			close(this->_wakefd);
+			this->_fd = -1;
+			this->_mountfd = -1;
+			this->_wakefd = -1;
+			return false;
+		}
+		return true;
+
+	#else
+		return false;
+
+	#endif
+	}
+
+	// Backend - inotify
+	bool AutoFileSyncWatcher::_start_inotify() noexcept
+	{
+		this->_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (this->_fd < 0)
+		{
+			return false;
+		}
+
+		// A watch per folder, failing if the watch limit is hit
+		if (this->_inotify_addtree(this->_root) == false)
+		{
+			close(this->_fd);
+			this->_fd = -1;
+			this->_watches.clear();
+			return false;
+		}
+
+		this->_wakefd = eventfd(0, EFD_CLOEXEC);
+		if (this->_wakefd < 0)
+		{
+			close(this->_fd);
+			this->_fd = -1;
+			this->_watches.clear();
+			return false;
+		}
+		return true;
+	}
+
+	// Backend - windows only
+	bool AutoFileSyncWatcher::_start_readdir() noexcept
+	{
+		return false;
+	}
+
+	// Inotify, add a watch to a folder (and its subfolders if recursive)
+	bool AutoFileSyncWatcher::_inotify_addtree(const std::string& folder) noexcept
+	{
+		const unsigned int mask = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE |
+			IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_EXCL_UNLINK | IN_ONLYDIR;
+		int wd = inotify_add_watch(this->_fd, folder.c_str(), mask);
+		if (wd < 0)
+		{
+			// Vanished in the meantime, fine; out of watches, not fine
+			return errno != ENOSPC && errno != ENOMEM;
+		}
+		this->_watches[wd] = folder;
+
+		// Subfolders (only the top folder if not recursive)
+		if (this->_recursive == false && folder == this->_root)
+		{
+			return true;
+		}
+		std::error_code ec;
+		for (std::filesystem::directory_iterator it(folder, ec), end; ec.value() == 0 && it != end; it.increment(ec))
+		{
+			if (it->is_directory(ec) == true && it->is_symlink(ec) == false)
+			{
+				if (this->_inotify_addtree(folder + "/" + it->path().filename().string()) == false)
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// Event thread - fanotify
+	void AutoFileSyncWatcher::_loop_fanotify() noexcept
+	{
+	#if defined(FAN_REPORT_DFID_NAME)
+		alignas(fanotify_event_metadata) char buffer[64 * 1024];
+		pollfd fds[2] = { { this->_fd, POLLIN, 0 }, { this->_wakefd, POLLIN, 0 } };
+
+		while (this->_tostop == false)
+		{
+			if (poll(fds, 2, -1) <= 0 || (fds[1].revents & POLLIN) != 0)
+			{
+				continue;
+			}
+
+			ssize_t len = read(this->_fd, buffer, sizeof(buffer));
+			if (len <= 0)
+			{
+				continue;
+			}
+
+			for (fanotify_event_metadata* meta = (fanotify_event_metadata*)buffer;
+				FAN_EVENT_OK(meta, len); meta = FAN_EVENT_NEXT(meta, len))
+			{
+				if ((meta->mask & FAN_Q_OVERFLOW) != 0)
+				{
+					this->_touch_overflow();
+					continue;
+				}
+
+				// The folder handle and the entry name
+				fanotify_event_info_fid* info = (fanotify_event_info_fid*)(meta + 1);
+				if (info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME)
+				{
+					continue;
+				}
+				file_handle* handle = (file_handle*)info->handle;
+				const char* name = (const char*)(handle->f_handle + handle->handle_bytes);
+
+				// Resolve the folder, which may already be gone (then its files are gone too)
+				int dirfd = open_by_handle_at(this->_mountfd, handle, O_PATH | O_CLOEXEC);
+				if (dirfd < 0)
+				{
+					continue;
+				}
+				char folder[PATH_MAX];
+				ssize_t folderlen = readlink(("/proc/self/fd/" + std::to_string(dirfd)).c_str(), folder, sizeof(folder));
+				close(dirfd);
+				if (folderlen <= 0)
+				{
+					continue;
+				}
+
+				std::string path(folder, (size_t)folderlen);
+				if (strcmp(name, ".") != 0)
+				{
+					path += "/";
+					path += name;
+				}
+
+				// A folder moved or removed takes the files below it along unreported, so everything is checked again
+				const unsigned long long moved = FAN_MOVED_FROM | FAN_MOVED_TO | FAN_MOVE_SELF | FAN_DELETE_SELF;
+				if (this->_touch(path) == true && (meta->mask & FAN_ONDIR) != 0 && (meta->mask & moved) != 0)
+				{
+					this->_touch_overflow();
+				}
+			}
+		}
+
+	#endif
+	}
+
+	// Event thread - inotify
+	void AutoFileSyncWatcher::_loop_inotify() noexcept
+	{
+		alignas(inotify_event) char buffer[64 * 1024];
+		pollfd fds[2] = { { this->_fd, POLLIN, 0 }, { this->_wakefd, POLLIN, 0 } };
+
+		while (this->_tostop == false)
+		{
+			if (poll(fds, 2, -1) <= 0 || (fds[1].revents & POLLIN) != 0)
+			{
+				continue;
+			}
+
+			ssize_t len = read(this->_fd, buffer, sizeof(buffer));
+			if (len <= 0)
+			{
+				continue;
+			}
+
+			bool rewatch = false;
+			for (char* ptr = buffer; ptr < buffer + len; ptr += sizeof(inotify_event) + ((inotify_event*)ptr)->len)
+			{
+				const inotify_event* event = (const inotify_event*)ptr;
+				if ((event->mask & IN_Q_OVERFLOW) != 0)
+				{
+					this->_touch_overflow();
+					continue;
+				}
+				if ((event->mask & IN_IGNORED) != 0)
+				{
+					this->_watches.erase(event->wd);
+					continue;
+				}
+
+				auto found = this->_watches.find(event->wd);
+				if (found == this->_watches.end())
+				{
+					continue;
+				}
+				std::string path = found->second;
+				if (event->len > 0)
+				{
+					path += "/";
+					path += event->name;
+				}
+				this->_touch(path);
+
+				// A new folder needs its own watches, a moved one makes the
+				// watched paths below it stale, so watch everything again
+				if ((event->mask & IN_ISDIR) != 0 && this->_recursive == true)
+				{
+					if ((event->mask & IN_CREATE) != 0)
+					{
+						if (this->_inotify_addtree(path) == false)
+						{
+							this->_touch_overflow();
+						}
+					}
+					else if ((event->mask & (IN_MOVED_FROM | IN_MOVED_TO)) != 0)
+					{
+						rewatch = true;
+					}
+				}
+			}
+
+			// Rewatch the tree, anything in between is treated as lost
+			if (rewatch == true)
+			{
+				for (const auto& it : this->_watches)
+				{
+					inotify_rm_watch(this->_fd, it.first);
+				}
+				this->_watches.clear();
+				this->_inotify_addtree(this->_root);
+				this->_touch_overflow();
+			}
+		}
+	}
+
+	// Event thread - windows only
+	void AutoFileSyncWatcher::_loop_readdir() noexcept
+	{
+		return;
+	}
+
+#elif defined(_WIN32)
+	// Backend - linux only
+	bool AutoFileSyncWatcher::_start_fanotify() noexcept
+	{
+		return false;
+	}
+
+	// Backend - linux only
+	bool AutoFileSyncWatcher::_start_inotify() noexcept
+	{
+		return false;
+	}
+
+	// Backend - ReadDirectoryChangesW
+	bool AutoFileSyncWatcher::_start_readdir() noexcept
+	{
+		HANDLE handle = CreateFileA(this->_root.c_str(), FILE_LIST_DIRECTORY,
+			FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+		if (handle == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		this->_dirhandle = handle;
+		return true;
+	}
+
+	// Inotify - linux only
+	bool AutoFileSyncWatcher::_inotify_addtree(const std::string& folder) noexcept
+	{
+		return false;
+	}
+
+	// Event thread - linux only
+	void AutoFileSyncWatcher::_loop_fanotify() noexcept
+	{
+		return;
+	}
+
+	// Event thread - linux only
+	void AutoFileSyncWatcher::_loop_inotify() noexcept
+	{
+		return;
+	}
+
+	// Event thread - ReadDirectoryChangesW
+	void AutoFileSyncWatcher::_loop_readdir() noexcept
+	{
+		alignas(DWORD) char buffer[64 * 1024];
+		const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_ATTRIBUTES |
+			FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_CREATION;
+
+		while (this->_tostop == false)
+		{
+			DWORD len = 0;
+			if (ReadDirectoryChangesW((HANDLE)this->_dirhandle, buffer, sizeof(buffer), this->_recursive ? TRUE : FALSE,
+				filter, &len, NULL, NULL) == FALSE)
+			{
+				// Cancelled by stop, or the folder is gone
+				if (this->_tostop == false)
+				{
+					this->_touch_overflow();
+					Sleep(200);
+				}
+				continue;
+			}
+
+			// The system buffer overflowed
+			if (len == 0)
+			{
+				this->_touch_overflow();
+				continue;
+			}
+
+			for (DWORD offset = 0; ; )
+			{
+				const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)(buffer + offset);
+				int namelen = WideCharToMultiByte(CP_ACP, 0, info->FileName, (int)(info->FileNameLength / sizeof(WCHAR)), NULL, 0, NULL, NULL);
+				std::string name((size_t)namelen, '\0');
+				WideCharToMultiByte(CP_ACP, 0, info->FileName, (int)(info->FileNameLength / sizeof(WCHAR)), name.data(), namelen, NULL, NULL);
+				std::replace(name.begin(), name.end(), '\\', '/');
+				this->_touch(this->_root + "/" + name);
+
+				if (info->NextEntryOffset == 0)
+				{
+					break;
+				}
+				offset += info->NextEntryOffset;
+			}
+		}
+	}
+
+#else
+	// Backends - not available on this platform, keep polling
+	bool AutoFileSyncWatcher::_start_fanotify() noexcept
+	{
+		return false;
+	}
+	bool AutoFileSyncWatcher::_start_inotify() noexcept
+	{
+		return false;
+	}
+	bool AutoFileSyncWatcher::_start_readdir() noexcept
+	{
+		return false;
+	}
+	bool AutoFileSyncWatcher::_inotify_addtree(const std::string& folder) noexcept
+	{
+		return false;
+	}
+	void AutoFileSyncWatcher::_loop_fanotify() noexcept
+	{
+		return;
+	}
+	void AutoFileSyncWatcher::_loop_inotify() noexcept
+	{
+		return;
+	}
+	void AutoFileSyncWatcher::_loop_readdir() noexcept
+	{
+		return;
+	}
+
+#endif
+
+}
+// Namespace AutoFileSync ends
@@ -0,0 +1,128 @@
+// AutoFileSyncWatcher.hpp
+// An automatic synchronization system
+// 
+// Version 0.0.1.1 by DOF Studio
+// Opensourced with Apache 2.0 License
+//
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <functional>
+#include <unordered_set>
+#include <unordered_map>
+
+#pragma once
+
+#pragma warning (disable: 4018)
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4251)
+#pragma warning (disable: 4267)
+#pragma warning (disable: 4661)
+#pragma warning (disable: 4715)
+#pragma warning (disable: 4804)
+#pragma warning (disable: 4819)
+#pragma warning (disable: 4919)
+#pragma warning (disable: 4996)
+#pragma warning (disable: 6031)
+
+// Namespace AutoFileSync starts
+namespace AutoFileSync
+{
+	// class AutoFileSyncWatcher
+	// Event-driven change detection of a monitored folder
+	// 
+	// Backends, tried in order:
+	//   fanotify   linux, whole filesystem mark (needs CAP_SYS_ADMIN, kernel 5.9+)
+	//   inotify    linux, one watch per directory
+	//   readdir    windows, ReadDirectoryChangesW on the whole tree
+	// If none can be started, the caller keeps polling.
+	// Paths touched since the last take() are collected with forward slashes.
+	class AutoFileSyncWatcher
+	{
+	private:
+		// Root folder and whether its subfolders are watched
+		std::string _root = "";
+		bool _recursive = false;
+
+		// Root folder with its links resolved, as the backends may report it (mapped back to the root)
+		std::string _resolved = "";
+
+		// Backend name, "" if not started
+		const char* _backend = "";
+
+		// Dirty paths since the last take, and whether events were lost
+		std::mutex _mutex;
+		std::unordered_set<std::string> _dirty;
+		bool _overflow = false;
+		std::atomic<bool> _pending = false;
+
+		// Time of the last event (steady clock, ns), and the callback of every event
+		std::atomic<long long> _touched = 0;
+		std::function<void()> _onevent;
+
+		// Event thread and its stop signal
+		std::thread* _thread = nullptr;
+		std::atomic<bool> _tostop = false;
+
+		// Backend handles
+		int _fd = -1;                                      // fanotify or inotify fd
+		int _wakefd = -1;                                  // eventfd to wake the event thread
+		int _mountfd = -1;                                 // fanotify, to open file handles
+		std::unordered_map<int, std::string> _watches;     // inotify, watch descriptor -> folder
+		void* _dirhandle = nullptr;                        // windows, the root folder handle
+
+	public:
+		// Constructor
+		AutoFileSyncWatcher(const std::string& root, bool recursive) noexcept;
+
+		// Destructor
+		~AutoFileSyncWatcher() noexcept;
+
+		// Copy constructor = delete
+		AutoFileSyncWatcher(const AutoFileSyncWatcher& y) noexcept = delete;
+		AutoFileSyncWatcher& operator=(const AutoFileSyncWatcher& y) noexcept = delete;
+
+		// Start watching with the first usable backend, false if none
+		bool start() noexcept;
+
+		// Stop watching
+		void stop() noexcept;
+
+		// Backend name, "" if not started
+		const char* backend() const noexcept;
+
+		// Whether anything was touched since the last take
+		bool pending() const noexcept;
+
+		// Time of the last event (steady clock, ns), 0 if none yet
+		long long touched() const noexcept;
+
+		// Set a callback of every event, called on the event thread (before starting)
+		void onevent(const std::function<void()>& callback) noexcept;
+
+		// Take the dirty paths since the last take, false if events were lost (rescan everything)
+		bool take(std::unordered_set<std::string>& dirty) noexcept;
+
+	private:
+		// Register a dirty path, false if not within the root (or an overflow)
+		bool _touch(const std::string& path) noexcept;
+		void _touch_overflow() noexcept;
+
+		// Backends
+		bool _start_fanotify() noexcept;
+		bool _start_inotify() noexcept;
+		bool _start_readdir() noexcept;
+
+		// Inotify, add a watch to a folder (and its subfolders if recursive)
+		bool _inotify_addtree(const std::string& folder) noexcept;
+
+		// Event thread loops
+		void _loop_fanotify() noexcept;
+		void _loop_inotify() noexcept;
+		void _loop_readdir() noexcept;
+	};
+
+}
+// Namespace AutoFileSync ends
@@ -5,28 +5,651 @@
 // Opensourced with Apache 2.0 License
 //
 
+#include <mutex>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <fstream>
 #include <iostream>
+#include <unordered_set>
+#include <condition_variable>
 
+#include "Libs/FILE.hpp"
 #include "Libs/ThreadPool.hpp"
 #include "Libs/AdminAccess.hpp"
 
+#include "AutoFileSyncControl.hpp"
 #include "AutoFileSynchronedline.hpp"
 
 // Namespace AutoFileSync starts
 namespace AutoFileSync
 {
+	// Utils (not headerable)
+	// Kernel - options of a synchronizor (a job), from the command line or a line of a job list
+	struct _afsync_cli_options
+	{
+		bool has_subfolder = false;
+		long long interval = 300000;
+		long long verbosity = 2;
+		long long cores = 20;
+		bool incremental = false;
+		long long verify = 0;
+		bool watching = false;
+		std::string hash = "crc64";
+		std::vector<std::string> readaheads;
+		long long uring = 0;
+		long long copywrites = 0;
+		long long delta = 0;
+		bool store = false;
+		std::string restore = "";
+		std::vector<std::string> exclusions;
+		std::vector<std::string> exclusionfiles;
+		std::string compression = "none";
+		bool staging = false;
+		std::vector<std::string> mirrors;
+		std::string settle = "0";
+		std::string control = "";
+	};
+
+	// Utils (not headerable)
+	// Kernel - parse an optional arg of a synchronizor into its options, false if invalid
+	bool _afsync_cli_parse(const std::string& arg, _afsync_cli_options& options) noexcept
+	{
+		// Valid arg
+		if (arg.starts_with("-subf="))
+		{
+			std::string arg_content = arg.substr(strlen("-subf="));
+			options.has_subfolder = atoll(arg_content.c_str()) != 0;
+		}
+		else if (arg.starts_with("-intv="))
+		{
+			std::string arg_content = arg.substr(strlen("-intv="));
+			options.interval = atoll(arg_content.c_str());
+			if (options.interval == 0)
+			{
+				options.interval = 300000;
+			}
+		}
+		else if (arg.starts_with("-verb="))
+		{
+			std::string arg_content = arg.substr(strlen("-verb="));
+			options.verbosity = atoll(arg_content.c_str());
+			if (options.verbosity > 2 || options.verbosity < 0)
+			{
+				options.verbosity = 2;
+			}
+		}
+		else if (arg.starts_with("-core="))
+		{
+			std::string arg_content = arg.substr(strlen("-core="));
+			options.cores = atoll(arg_content.c_str());
+			if (options.cores > tpool::ThreadNum() || options.cores <= 0)
+			{
+				options.cores = tpool::ThreadNum();
+			}
+		}
+		else if (arg.starts_with("-incr="))
+		{
+			std::string arg_content = arg.substr(strlen("-incr="));
+			options.incremental = atoll(arg_content.c_str()) != 0;
+		}
+		else if (arg.starts_with("-vrfy="))
+		{
+			std::string arg_content = arg.substr(strlen("-vrfy="));
+			options.verify = atoll(arg_content.c_str());
+			if (options.verify < 0)
+			{
+				options.verify = 0;
+			}
+		}
+		else if (arg.starts_with("-wtch="))
+		{
+			std::string arg_content = arg.substr(strlen("-wtch="));
+			options.watching = atoll(arg_content.c_str()) != 0;
+		}
+		else if (arg.starts_with("-hash="))
+		{
+			std::string arg_content = arg.substr(strlen("-hash="));
+			options.hash = arg_content;
+		}
+		else if (arg.starts_with("-rdah="))
+		{
+			std::string arg_content = arg.substr(strlen("-rdah="));
+			options.readaheads.push_back(arg_content);
+		}
+		else if (arg.starts_with("-urng="))
+		{
+			std::string arg_content = arg.substr(strlen("-urng="));
+			options.uring = atoll(arg_content.c_str());
+		}
+		else if (arg.starts_with("-cpwr="))
+		{
+			std::string arg_content = arg.substr(strlen("-cpwr="));
+			options.copywrites = atoll(arg_content.c_str());
+		}
+		else if (arg.starts_with("-dlta="))
+		{
+			std::string arg_content = arg.substr(strlen("-dlta="));
+			options.delta = atoll(arg_content.c_str());
+		}
+		else if (arg.starts_with("-stor="))
+		{
+			std::string arg_content = arg.substr(strlen("-stor="));
+			options.store = atoll(arg_content.c_str()) != 0;
+		}
+		else if (arg.starts_with("-rstr="))
+		{
+			std::string arg_content = arg.substr(strlen("-rstr="));
+			options.restore = arg_content;
+		}
+		else if (arg.starts_with("-excl="))
+		{
+			std::string arg_content = arg.substr(strlen("-excl="));
+			options.exclusions.push_back(arg_content);
+		}
+		else if (arg.starts_with("-exlf="))
+		{
+			std::string arg_content = arg.substr(strlen("-exlf="));
+			options.exclusionfiles.push_back(arg_content);
+		}
+		else if (arg.starts_with("-cmpr="))
+		{
+			std::string arg_content = arg.substr(strlen("-cmpr="));
+			options.compression = arg_content;
+		}
+		else if (arg.starts_with("-stag="))
+		{
+			std::string arg_content = arg.substr(strlen("-stag="));
+			options.staging = atoll(arg_content.c_str()) != 0;
+		}
+		else if (arg.starts_with("-mirr="))
+		{
+			std::string arg_content = arg.substr(strlen("-mirr="));
+			options.mirrors.push_back(arg_content);
+		}
+		else if (arg.starts_with("-setl="))
+		{
+			std::string arg_content = arg.substr(strlen("-setl="));
+			options.settle = arg_content;
+		}
+		else if (arg.starts_with("-ctrl="))
+		{
+			std::string arg_content = arg.substr(strlen("-ctrl="));
+			options.control = arg_content;
+		}
+
+		// Invalid arg
+		else
+		{
+			return false;
+		}
+		return true;
+	}
+
+	// Utils (not headerable)
+	// Kernel - apply the options to a synchronizor (before starting), errors printed and omitted
+	void _afsync_cli_apply(AutoFileSynchonizor& afsync, const _afsync_cli_options& options) noexcept
+	{
+		afsync.api_set_incremental(options.incremental);
+		afsync.api_set_verification(options.verify);
+		afsync.api_set_watching(options.watching);
+		if (afsync.api_set_hash(options.hash) == false)
+		{
+			std::cout << "! Error, hash algorithm " << options.hash << " is not available, using crc64." << std::endl;
+		}
+		for (const std::string& readahead : options.readaheads)
+		{
+			size_t at = readahead.find('@');
+			std::string path = (at == std::string::npos ? "" : readahead.substr(at + 1));
+			if (afsync.api_set_readahead(atoll(readahead.substr(0, at).c_str()), path) == false)
+			{
+				std::cout << "! Error, invalid readahead " << readahead << ", omitted." << std::endl;
+			}
+		}
+		if (afsync.api_set_uring(options.uring) == false)
+		{
+			std::cout << "! Error, io_uring is not available, omitted." << std::endl;
+		}
+		afsync.api_set_copy_writes(options.copywrites);
+		afsync.api_set_delta(options.delta);
+		afsync.api_set_store(options.store);
+		afsync.api_set_staging(options.staging);
+		size_t colon = options.compression.find(':');
+		long long level = (colon == std::string::npos ? 0 : atoll(options.compression.substr(colon + 1).c_str()));
+		if (afsync.api_set_compression(options.compression.substr(0, colon), level) == false)
+		{
+			std::cout << "! Error, compression " << options.compression << " is not available, omitted." << std::endl;
+		}
+		for (const std::string& exclusion : options.exclusions)
+		{
+			if (afsync.api_add_exclusion(exclusion) == false)
+			{
+				std::cout << "! Error, invalid exclusion rule " << exclusion << ", omitted." << std::endl;
+			}
+		}
+		for (const std::string& exclusionfile : options.exclusionfiles)
+		{
+			if (afsync.api_load_exclusions(exclusionfile) == false)
+			{
+				std::cout << "! Error, cannot read exclusion rules " << exclusionfile << ", omitted." << std::endl;
+			}
+		}
+		for (const std::string& mirror : options.mirrors)
+		{
+			if (afsync.api_add_mirror(mirror) == false)
+			{
+				std::cout << "! Error, invalid mirror destination " << mirror << ", omitted." << std::endl;
+			}
+		}
+		size_t at = options.settle.find(':');
+		long long maxlatency = (at == std::string::npos ? 0 : atoll(options.settle.substr(at + 1).c_str()));
+		if (afsync.api_set_settle(atoll(options.settle.substr(0, at).c_str()), maxlatency) == false)
+		{
+			std::cout << "! Error, invalid settle window " << options.settle << ", omitted." << std::endl;
+		}
+		return;
+	}
+
+	// Utils (not headerable)
+	// Kernel - split a line of a job list into args at spaces, double quotes keeping them
+	std::vector<std::string> _afsync_cli_split(const std::string& line) noexcept
+	{
+		std::vector<std::string> args;
+		std::string arg = "";
+		bool quoted = false;
+		bool any = false;
+		for (char c : line)
+		{
+			if (c == '"')
+			{
+				quoted = !quoted;
+				any = true;
+			}
+			else if (quoted == false && (c == ' ' || c == '\t' || c == '\r'))
+			{
+				if (any == true)
+				{
+					args.push_back(arg);
+				}
+				arg = "";
+				any = false;
+			}
+			else
+			{
+				arg.push_back(c);
+				any = true;
+			}
+		}
+		if (any == true)
+		{
+			args.push_back(arg);
+		}
+		return args;
+	}
+
+	// Utils (not headerable)
+	// Kernel - names a src takes in a dest (fullpath of its snapshots, index, chunk store and staging folder, without suffix)
+	std::string _afsync_cli_destname(const std::string& src, const std::string& dest) noexcept
+	{
+		std::string srcname = abspath(src);
+		std::replace(srcname.begin(), srcname.end(), '\\', '/');
+		while (!srcname.empty() && srcname.back() == '/')
+		{
+			srcname.pop_back();
+		}
+		srcname = srcname.substr(srcname.find_last_of('/') + 1);
+		std::string destpath = abspath(dest);
+		std::replace(destpath.begin(), destpath.end(), '\\', '/');
+		while (!destpath.empty() && destpath.back() == '/')
+		{
+			destpath.pop_back();
+		}
+		return destpath + "/" + srcname;
+	}
+
+	// Utils (not headerable)
+	// Kernel - a running service, its synchronizors (jobs) and its stop signal
+	struct _afsync_cli_service
+	{
+		std::vector<AutoFileSynchonizor*> afsyncs;
+		std::mutex mutex;
+		std::condition_variable cv;
+		bool stopping = false;
+	};
+
+	// Utils (not headerable)
+	// Kernel - answer a command of the control socket, lines ending with "ok" or "error, ..."
+	//   sync [job]    synchronize at once, answered once done
+	//   pause [job]   hold the synchronizations of the interval and of the watcher
+	//   resume [job]  resume them
+	//   status [job]  a line per job, its phase and the progress of its synchronization
+	//   stop          stop the service
+	// (every job if no job number, numbered from 0 in the order they started)
+	std::string _afsync_cli_command(_afsync_cli_service& service, const std::string& line) noexcept
+	{
+		std::vector<std::string> args = _afsync_cli_split(line);
+		if (args.empty() == true)
+		{
+			return "error, empty command";
+		}
+
+		// Jobs addressed
+		std::vector<size_t> jobs;
+		if (args.size() >= 2)
+		{
+			char* end = nullptr;
+			unsigned long long job = strtoull(args[1].c_str(), &end, 10);
+			if (end == args[1].c_str() || *end != '\0' || job >= service.afsyncs.size())
+			{
+				return "error, no job " + args[1];
+			}
+			jobs.push_back((size_t)job);
+		}
+		else
+		{
+			for (size_t job = 0; job < service.afsyncs.size(); ++job)
+			{
+				jobs.push_back(job);
+			}
+		}
+
+		// Commands
+		const std::string& command = args[0];
+		std::string reply = "";
+		if (command == "sync")
+		{
+			// Every job at once, each waited for on a thread
+			std::vector<char> succeeded(jobs.size(), 0);
+			std::vector<std::thread> waiters;
+			for (size_t k = 0; k < jobs.size(); ++k)
+			{
+				waiters.emplace_back([&service, &jobs, &succeeded, k]()
+					{
+						succeeded[k] = (service.afsyncs[jobs[k]]->api_sync_now(true) == true ? 1 : 0);
+					});
+			}
+			for (std::thread& waiter : waiters)
+			{
+				waiter.join();
+			}
+			long long failed = std::count(succeeded.begin(), succeeded.end(), (char)0);
+			return (failed == 0 ? "ok" : "error, " + std::to_string(failed) + " synchronizations failed");
+		}
+		else if (command == "pause" || command == "resume")
+		{
+			for (size_t job : jobs)
+			{
+				if (service.afsyncs[job]->api_pause(command == "pause") == false)
+				{
+					return "error, job " + std::to_string(job) + " is not working";
+				}
+			}
+		}
+		else if (command == "status")
+		{
+			for (size_t job : jobs)
+			{
+				AutoFileSyncStatus status = service.afsyncs[job]->api_status();
+				reply += "job " + std::to_string(job) + " " + (status.working == false ? "stopped" : (status.paused == true ? "paused" : "working"));
+				reply += std::string(" phase=") + phase_name(status.phase);
+				reply += " files=" + std::to_string(status.files) + " checked=" + std::to_string(status.checked);
+				reply += " hashed=" + std::to_string(status.hashed);
+				reply += " copies=" + std::to_string(status.copies) + " copied=" + std::to_string(status.copied);
+				reply += " bytes=" + std::to_string(status.bytes);
+				reply += " synced=" + std::to_string(status.synced);
+				reply += std::string(" last=") + (status.synced == 0 ? "none" : (status.succeeded == true ? "ok" : "failed"));
+				reply += "\n";
+			}
+		}
+		else if (command == "stop")
+		{
+			std::lock_guard<std::mutex> lock(service.mutex);
+			service.stopping = true;
+			service.cv.notify_all();
+		}
+		else
+		{
+			return "error, unknown command " + command;
+		}
+		return reply + "ok";
+	}
+
+	// Utils (not headerable)
+	// Kernel - serve until stopped from the console (or from the control socket at control, if any), then stop the synchronizors
+	int _afsync_cli_serve(const std::vector<AutoFileSynchonizor*>& afsyncs, const std::string& control) noexcept
+	{
+		std::shared_ptr<_afsync_cli_service> service = std::make_shared<_afsync_cli_service>();
+		service->afsyncs = afsyncs;
+
+		// Control socket, if wanted
+		std::unique_ptr<AutoFileSyncControl> controller;
+		if (control != "")
+		{
+			controller = std::make_unique<AutoFileSyncControl>(control, [service](const std::string& line) -> std::string
+				{
+					return _afsync_cli_command(*service, line);
+				});
+			if (controller->start() == false)
+			{
+				std::cout << "! Error, cannot listen on the control socket " << control << ", omitted." << std::endl;
+				controller.reset();
+			}
+			else
+			{
+				std::cout << "Taking commands on the control socket " << control << " (sync, pause, resume, status, stop)." << std::endl;
+			}
+		}
+
+		// Console, read on a thread of its own, left blocked there once stopped (touching nothing after)
+		std::cout << "To stop that process, please type in \"stop\" in lower cases, or \"sync\" to synchronize at once." << std::endl;
+		std::cout << std::endl;
+		std::thread console([service]()
+			{
+				std::string readline;
+				while (std::cin >> readline)
+				{
+					std::lock_guard<std::mutex> lock(service->mutex);
+					if (service->stopping == true)
+					{
+						return;
+					}
+					if (readline == "sync")
+					{
+						for (AutoFileSynchonizor* afsync : service->afsyncs)
+						{
+							afsync->api_sync_now();
+						}
+					}
+					else if (readline == "stop")
+					{
+						service->stopping = true;
+						service->cv.notify_all();
+						return;
+					}
+				}
+			});
+		console.detach();
+		{
+			std::unique_lock<std::mutex> lock(service->mutex);
+			service->cv.wait(lock, [&service]() { return service->stopping == true; });
+		}
+
+		// Stop the service, the synchronizors first (commands waiting for them return), then the control socket
+		bool stopped = true;
+		for (AutoFileSynchonizor* afsync : afsyncs)
+		{
+			stopped = (afsync->api_stop_working() == true && stopped == true);
+		}
+		controller.reset();
+		if (stopped == false)
+		{
+			std::cout << "! Error, failed to stop " << (afsyncs.size() > 1 ? "a synchronizor." : "the synchronizor.") << std::endl;
+			return -3;
+		}
+		else
+		{
+			std::cout << "The synchronization service has stopped." << std::endl;
+			return 0;
+		}
+	}
+
+	// Utils (not headerable)
+	// Kernel - run the jobs of a job list as a daemon, its synchronizors sharing its pools and device caps
+	// Note a job list holds a job per line, src dest [optional args] as on the command line (double quotes
+	// around paths with spaces, no -core, -rstr nor -ctrl), empty lines and lines starting with # are skipped,
+	// and a job whose src has the folder name of another one of the same dest (or mirror) is omitted
+	int _afsync_cli_daemon(int argc, char* argv[]) noexcept
+	{
+		// Default args
+		std::string jobs = "";
+		long long cores = 20;
+		long long devicecap = 0;
+		std::string control = "";
+
+		// Eval args
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string arg = argv[i];
+			if (arg.starts_with("-jobs="))
+			{
+				jobs = arg.substr(strlen("-jobs="));
+			}
+			else if (arg.starts_with("-core="))
+			{
+				std::string arg_content = arg.substr(strlen("-core="));
+				cores = atoll(arg_content.c_str());
+				if (cores > tpool::ThreadNum() || cores <= 0)
+				{
+					cores = tpool::ThreadNum();
+				}
+			}
+			else if (arg.starts_with("-iocp="))
+			{
+				std::string arg_content = arg.substr(strlen("-iocp="));
+				devicecap = atoll(arg_content.c_str());
+			}
+			else if (arg.starts_with("-ctrl="))
+			{
+				control = arg.substr(strlen("-ctrl="));
+			}
+			else
+			{
+				std::cout << "Omitted invalid arg: " << arg << std::endl;
+			}
+		}
+
+		// Start a synchronizor per job, all sharing the same pools
+		std::ifstream ifs(jobs);
+		if (ifs.is_open() == false)
+		{
+			std::cout << "! Error, cannot read the job list " << jobs << "." << std::endl;
+			return -1;
+		}
+		AutoFileSyncShared shared((size_t)cores, devicecap);
+		std::vector<std::unique_ptr<AutoFileSynchonizor>> afsyncs;
+		std::unordered_set<std::string> destnames;
+		std::string line;
+		long long lineno = 0;
+		while (std::getline(ifs, line))
+		{
+			++lineno;
+			std::vector<std::string> args = _afsync_cli_split(line);
+			if (args.empty() == true || args[0].starts_with("#") == true)
+			{
+				continue;
+			}
+			if (args.size() < 2)
+			{
+				std::cout << "! Error, job at line " << lineno << " has no dest, omitted." << std::endl;
+				continue;
+			}
+
+			_afsync_cli_options options;
+			for (size_t k = 2; k < args.size(); ++k)
+			{
+				if (args[k].starts_with("-core=") == true || args[k].starts_with("-rstr=") == true || args[k].starts_with("-ctrl=") == true ||
+					_afsync_cli_parse(args[k], options) == false)
+				{
+					std::cout << "Omitted invalid arg of the job at line " << lineno << ": " << args[k] << std::endl;
+				}
+			}
+
+			// Two jobs naming their snapshots, index, chunk store and staging folder alike in a dest (or a mirror)
+			// would overwrite each other's, so the srcs of a dest need distinct folder names
+			std::vector<std::string> names = { _afsync_cli_destname(args[0], args[1]) };
+			for (const std::string& mirror : options.mirrors)
+			{
+				names.push_back(_afsync_cli_destname(args[0], mirror));
+			}
+			bool clashing = false;
+			for (const std::string& name : names)
+			{
+				clashing = (clashing == true || destnames.contains(name) == true);
+			}
+			if (clashing == true)
+			{
+				std::cout << "! Error, job at line " << lineno << " has a src named like another one of the same dest, omitted." << std::endl;
+				continue;
+			}
+			std::unique_ptr<AutoFileSynchonizor> afsync = std::make_unique<AutoFileSynchonizor>(args[0], args[1], shared,
+				options.has_subfolder, std::vector<std::string>{}, options.interval, options.verbosity);
+			_afsync_cli_apply(*afsync, options);
+			if (afsync->api_start_working() == false)
+			{
+				std::cout << "! Error, failed to start the job at line " << lineno << ", omitted." << std::endl;
+				continue;
+			}
+			destnames.insert(names.begin(), names.end());
+			afsyncs.push_back(std::move(afsync));
+		}
+		if (afsyncs.empty() == true)
+		{
+			std::cout << "! Error, no job has started." << std::endl;
+			return -2;
+		}
+
+		// Serve until stopped
+		std::cout << afsyncs.size() << " jobs are running on " << cores << " hashing and " << cores << " copying threads." << std::endl;
+		std::vector<AutoFileSynchonizor*> served;
+		for (std::unique_ptr<AutoFileSynchonizor>& afsync : afsyncs)
+		{
+			served.push_back(afsync.get());
+		}
+		return _afsync_cli_serve(served, control);
+	}
+
 	// Afsync Command line system (requires admin prev)
 	//
 	// Automatic File Synchronizor (afsync)
 	// Copy Right: DOF Studio 2024
 	// 
 	// Syntax: programname.exe src dest [optional args]
+	//         programname.exe -jobs=joblist [-core=N] [-iocp=N] [-ctrl=socket]
+	//         (a job per line of joblist, src dest [optional args], sharing -core hashing and copying threads
+	//         and at most -iocp hashing batches and copies per device at once, 0 for no cap)
 	// Optional Args Syntax: -arg_name=arg_value
 	// Optional Args: 
 	//   -subf  whether to monitor subfolders or not, non-0 or 0, defualt 0
 	//   -intv  synchronization interval, in msecond, default 300000
 	//   -verb  verbosity setting, 0 or 1 or 2, default 2
 	//   -core  multi-thread threads used, any Z+, default 20
+	//   -incr  whether to hard-link unchanged files from the last snapshot, non-0 or 0, default 0
+	//   -vrfy  re-hash every file on each N-th check regardless of metadata, 0 for never, default 0
+	//   -wtch  whether to watch file system events (polling if unavailable), non-0 or 0, default 0
+	//   -hash  hash algorithm of new digests, crc64 or xxh3 or blake3 or sha256, default crc64
+	//   -rdah  reads in flight while hashing a large file, N or N@path for the device of path, repeatable, default 2
+	//   -urng  io_uring threads hashing small files in batches (linux), 0 for off, default 0
+	//   -cpwr  snapshot copies writing to the same device at once, 0 for no cap, default 0
+	//   -dlta  delta snapshots (reflink plus changed blocks) of files from this size in bytes, 0 for off, default 0
+	//   -stor  snapshots as manifests of deduplicated chunks in a chunk store, non-0 or 0, default 0
+	//   -rstr  restore a manifest snapshot into a folder and exit, manifest@folder
+	//   -excl  exclusion rule with the gitignore syntax (node_modules/, *.tmp, build/**), repeatable
+	//   -exlf  file of exclusion rules with the gitignore syntax, one per line, repeatable
+	//   -cmpr  compressed snapshots, zstd or lz4 with an optional level (zstd:19, lz4:9), restored with -rstr on its .afscodecs, default none
+	//   -stag  whether to copy changed files while hashing them, read once for the check and the snapshot, non-0 or 0, default 0
+	//   -mirr  mirror destination given every snapshot as well, changed files read once for all, repeatable
+	//   -setl  watched changes snapshotted after this quiet time in msecond, at most maxms after the first, ms or ms:maxms, default 0
+	//   -ctrl  control socket (linux) taking the commands sync, pause, resume, status and stop, each with an optional job number
 	int AutoFileSyncCommandline(int argc, char* argv[]) noexcept
 	{
 		// Standard Admin-Fetching Template
@@ -41,6 +664,12 @@ namespace AutoFileSync
 			return -1;
 		}
 
+		// A job list instead of a src and a dest, run as a daemon
+		if (argc >= 2 && std::string(argv[1]).starts_with("-jobs=") == true)
+		{
+			return _afsync_cli_daemon(argc, argv);
+		}
+
 		// Too few args, print help then
 		if (argc < 3)
 		{
@@ -48,12 +677,32 @@ namespace AutoFileSync
 			std::cout << "Copy Right : DOF Studio 2024" << std::endl;
 			std::cout << "" << std::endl;
 			std::cout << "Syntax: program_name.exe src dest [optional args]" << std::endl;
+			std::cout << "        program_name.exe -jobs=joblist [-core=N] [-iocp=N] [-ctrl=socket]" << std::endl;
+			std::cout << "        (a job per line of joblist, src dest [optional args], sharing -core hashing and copying threads" << std::endl;
+			std::cout << "        and at most -iocp hashing batches and copies per device at once, 0 for no cap)" << std::endl;
 			std::cout << "Optional Args Syntax: -arg_name=arg_value" << std::endl;
 			std::cout << "Optional Args: " << std::endl;
 			std::cout << "  -subf  whether to monitor subfolders or not, non-0 or 0, defualt 0" << std::endl;
 			std::cout << "  -intv  synchronization interval, in msecond, default 300000" << std::endl;
 			std::cout << "  -verb  verbosity setting, 0 or 1 or 2, default 2" << std::endl;
 			std::cout << "  -core  multi-thread threads used, any Z+, default 20" << std::endl;
+			std::cout << "  -incr  whether to hard-link unchanged files from the last snapshot, non-0 or 0, default 0" << std::endl;
+			std::cout << "  -vrfy  re-hash every file on each N-th check regardless of metadata, 0 for never, default 0" << std::endl;
+			std::cout << "  -wtch  whether to watch file system events (polling if unavailable), non-0 or 0, default 0" << std::endl;
+			std::cout << "  -hash  hash algorithm of new digests, crc64 or xxh3 or blake3 or sha256, default crc64" << std::endl;
+			std::cout << "  -rdah  reads in flight while hashing a large file, N or N@path for the device of path, repeatable, default 2" << std::endl;
+			std::cout << "  -urng  io_uring threads hashing small files in batches (linux), 0 for off, default 0" << std::endl;
+			std::cout << "  -cpwr  snapshot copies writing to the same device at once, 0 for no cap, default 0" << std::endl;
+			std::cout << "  -dlta  delta snapshots (reflink plus changed blocks) of files from this size in bytes, 0 for off, default 0" << std::endl;
+			std::cout << "  -stor  snapshots as manifests of deduplicated chunks in a chunk store, non-0 or 0, default 0" << std::endl;
+			std::cout << "  -rstr  restore a manifest snapshot into a folder and exit, manifest@folder" << std::endl;
+			std::cout << "  -excl  exclusion rule with the gitignore syntax (node_modules/, *.tmp, build/**), repeatable" << std::endl;
+			std::cout << "  -exlf  file of exclusion rules with the gitignore syntax, one per line, repeatable" << std::endl;
+			std::cout << "  -cmpr  compressed snapshots, zstd or lz4 with an optional level (zstd:19, lz4:9), restored with -rstr on its .afscodecs, default none" << std::endl;
+			std::cout << "  -stag  whether to copy changed files while hashing them, read once for the check and the snapshot, non-0 or 0, default 0" << std::endl;
+			std::cout << "  -mirr  mirror destination given every snapshot as well, changed files read once for all, repeatable" << std::endl;
+			std::cout << "  -setl  watched changes snapshotted after this quiet time in msecond, at most maxms after the first, ms or ms:maxms, default 0" << std::endl;
+			std::cout << "  -ctrl  control socket (linux) taking the commands sync, pause, resume, status and stop, each with an optional job number" << std::endl;
 			std::cout << "" << std::endl;
 			std::cout << "! Error, too few arguments!" << std::endl;
 
@@ -63,83 +712,42 @@ namespace AutoFileSync
 		// Default args
 		const std::string src = std::string(argv[1]);
 		const std::string dest = std::string(argv[2]);
-		bool has_subfolder = false;
-		long long interval = 300000;
-		long long verbosity = 2;
-		long long cores = 20;
+		_afsync_cli_options options;
 
 		// Eval args
 		for (int i = 3; i < argc; ++i)
 		{
 			std::string arg = argv[i];
-
-			// Valid arg
-			if (arg.starts_with("-subf="))
-			{
-				std::string arg_content = arg.substr(strlen("-subf="));
-				has_subfolder = atoll(arg_content.c_str()) != 0;
-			}
-			else if (arg.starts_with("-intv="))
-			{
-				std::string arg_content = arg.substr(strlen("-intv="));
-				interval = atoll(arg_content.c_str());
-				if (interval == 0)
-				{
-					interval = 300000;
-				}
-			}
-			else if (arg.starts_with("-verb="))
-			{
-				std::string arg_content = arg.substr(strlen("-verb="));
-				verbosity = atoll(arg_content.c_str());
-				if (verbosity > 2 || verbosity < 0)
-				{
-					verbosity = 2;
-				}
-			}
-			else if (arg.starts_with("-core="))
-			{
-				std::string arg_content = arg.substr(strlen("-core="));
-				cores = atoll(arg_content.c_str());
-				if (cores > tpool::ThreadNum() || cores <= 0)
-				{
-					cores = tpool::ThreadNum();
-				}
-			}
-
-			// Invalid arg
-			else
+			if (_afsync_cli_parse(arg, options) == false)
 			{
 				std::cout << "Omitted invalid arg: " << arg << std::endl;
 			}
 		}
 
 		// Start the service
-		AutoFileSynchonizor afsync(src, dest, has_subfolder, {}, interval, verbosity, cores);
+		AutoFileSynchonizor afsync(src, dest, options.has_subfolder, {}, options.interval, options.verbosity, options.cores);
+		_afsync_cli_apply(afsync, options);
+
+		// Restore a manifest instead of working
+		if (options.restore != "")
+		{
+			size_t at = options.restore.find('@');
+			if (at == std::string::npos || afsync.api_restore(options.restore.substr(0, at), options.restore.substr(at + 1)) == false)
+			{
+				std::cout << "! Error, failed to restore " << options.restore << "." << std::endl;
+				return -4;
+			}
+			std::cout << "The manifest snapshot has been restored." << std::endl;
+			return 0;
+		}
 		if (afsync.api_start_working() == false)
 		{
 			std::cout << "! Error, failed to start the synchronizor." << std::endl;
 			return -2;
 		}
 
-		// Stop the service
-		std::cout << "To stop that process, please type in \"stop\" in lower cases." << std::endl;
-		std::cout << std::endl;
-		std::string readline;
-		do
-		{
-			std::cin >> readline;
-		} while (readline != "stop");
-		if (afsync.api_stop_working() == false)
-		{
-			std::cout << "! Error, failed to stop the synchronizor." << std::endl;
-			return -3;
-		}
-		else
-		{
-			std::cout << "The synchronization service has stopped." << std::endl;
-			return 0;
-		}
+		// Serve until stopped
+		return _afsync_cli_serve({ &afsync }, options.control);
 	}
 
 }
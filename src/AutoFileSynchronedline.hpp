@@ -30,12 +30,32 @@ namespace AutoFileSync
 	// Copy Right: DOF Studio 2024
 	// 
 	// Syntax: programname.exe src dest [optional args]
+	//         programname.exe -jobs=joblist [-core=N] [-iocp=N] [-ctrl=socket]
+	//         (a job per line of joblist, src dest [optional args], sharing -core hashing and copying threads
+	//         and at most -iocp hashing batches and copies per device at once, 0 for no cap)
 	// Optional Args Syntax: -arg_name=arg_value
 	// Optional Args: 
 	//   -subf  whether to monitor subfolders or not, non-0 or 0, defualt 0
 	//   -intv  synchronization interval, in msecond, default 300000
 	//   -verb  verbosity setting, 0 or 1 or 2, default 2
 	//   -core  multi-thread threads used, any Z+, default 20
+	//   -incr  whether to hard-link unchanged files from the last snapshot, non-0 or 0, default 0
+	//   -vrfy  re-hash every file on each N-th check regardless of metadata, 0 for never, default 0
+	//   -wtch  whether to watch file system events (polling if unavailable), non-0 or 0, default 0
+	//   -hash  hash algorithm of new digests, crc64 or xxh3 or blake3 or sha256, default crc64
+	//   -rdah  reads in flight while hashing a large file, N or N@path for the device of path, repeatable, default 2
+	//   -urng  io_uring threads hashing small files in batches (linux), 0 for off, default 0
+	//   -cpwr  snapshot copies writing to the same device at once, 0 for no cap, default 0
+	//   -dlta  delta snapshots (reflink plus changed blocks) of files from this size in bytes, 0 for off, default 0
+	//   -stor  snapshots as manifests of deduplicated chunks in a chunk store, non-0 or 0, default 0
+	//   -rstr  restore a manifest snapshot into a folder and exit, manifest@folder
+	//   -excl  exclusion rule with the gitignore syntax (node_modules/, *.tmp, build/**), repeatable
+	//   -exlf  file of exclusion rules with the gitignore syntax, one per line, repeatable
+	//   -cmpr  compressed snapshots, zstd or lz4 with an optional level (zstd:19, lz4:9), restored with -rstr on its .afscodecs, default none
+	//   -stag  whether to copy changed files while hashing them, read once for the check and the snapshot, non-0 or 0, default 0
+	//   -mirr  mirror destination given every snapshot as well, changed files read once for all, repeatable
+	//   -setl  watched changes snapshotted after this quiet time in msecond, at most maxms after the first, ms or ms:maxms, default 0
+	//   -ctrl  control socket (linux) taking the commands sync, pause, resume, status and stop, each with an optional job number
 	int AutoFileSyncCommandline(int argc, char* argv[]) noexcept;
 
 }
@@ -9,12 +9,28 @@
 #include <iomanip>
 #include <ctime>
 #include <sstream>
+#include <cstring>
+#include <filesystem>
+#include <chrono>
+#include <mutex>
+#include <latch>
+#include <memory>
+#include <algorithm>
 
-#include "Libs/CRC.hpp"
 #include "Libs/FILE.hpp"
 #include "Libs/Clock.hpp"
 #include "Libs/ThreadPool.hpp"
 
+#include "AutoFileSyncCrc64.hpp"
+#include "AutoFileSyncBuffers.hpp"
+#include "AutoFileSyncChunks.hpp"
+#include "AutoFileSyncCopier.hpp"
+#include "AutoFileSyncFanout.hpp"
+#include "AutoFileSyncHasher.hpp"
+#include "AutoFileSyncIndex.hpp"
+#include "AutoFileSyncScanner.hpp"
+#include "AutoFileSyncUring.hpp"
+#include "AutoFileSyncWatcher.hpp"
 #include "AutoFileSynchronizor.hpp"
 
 // Namespace AutoFileSync starts
@@ -29,6 +45,15 @@ namespace AutoFileSync
 		return (tpool::ThreadPool*)anyptr;
 	}
 
+	// Utils (not headerable)
+	// Kernel - AutoFileSyncBufferPool pointer fetcher
+	__AUTOFILECOPIER_FUNCTION__
+	__AUTOFILECOPIER_INLINE_FUNCTION__
+	AutoFileSyncBufferPool* _afsync_util_buffers_ptr(void* anyptr) noexcept
+	{
+		return (AutoFileSyncBufferPool*)anyptr;
+	}
+
 	// Utils (not headerable)
 	// Kernel - Clocks::Clock pointer fetcher
 	__AUTOFILECOPIER_FUNCTION__
@@ -38,6 +63,60 @@ namespace AutoFileSync
 		return (Clocks::Clock*)anyptr;
 	}
 
+	// Utils (not headerable)
+	// Kernel - AutoFileSyncIndex pointer fetcher
+	__AUTOFILECOPIER_FUNCTION__
+	__AUTOFILECOPIER_INLINE_FUNCTION__
+	AutoFileSyncIndex* _afsync_util_index_ptr(void* anyptr) noexcept
+	{
+		return (AutoFileSyncIndex*)anyptr;
+	}
+
+	// Utils (not headerable)
+	// Kernel - AutoFileSyncWatcher pointer fetcher
+	__AUTOFILECOPIER_FUNCTION__
+	__AUTOFILECOPIER_INLINE_FUNCTION__
+	AutoFileSyncWatcher* _afsync_util_watcher_ptr(void* anyptr) noexcept
+	{
+		return (AutoFileSyncWatcher*)anyptr;
+	}
+
+	// Utils (not headerable)
+	// Kernel - AutoFileSyncChunkStore pointer fetcher
+	__AUTOFILECOPIER_FUNCTION__
+	__AUTOFILECOPIER_INLINE_FUNCTION__
+	AutoFileSyncChunkStore* _afsync_util_store_ptr(void* anyptr) noexcept
+	{
+		return (AutoFileSyncChunkStore*)anyptr;
+	}
+
+	// Utils (not headerable)
+	// Kernel - steady time now (ns), the clock of the watcher events
+	__AUTOFILECOPIER_FUNCTION__
+	__AUTOFILECOPIER_INLINE_FUNCTION__
+	long long _afsync_util_steady_now_ns() noexcept
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Phase name
+	const char* phase_name(AutoFileSyncPhase phase) noexcept
+	{
+		switch (phase)
+		{
+		case AFSYNC_PHASE_SCANNING:
+			return "scanning";
+		case AFSYNC_PHASE_HASHING:
+			return "hashing";
+		case AFSYNC_PHASE_COPYING:
+			return "copying";
+		case AFSYNC_PHASE_STORING:
+			return "storing";
+		default:
+			return "idle";
+		}
+	}
+
 	// class AutoFileSynchonizor
 	// Զжָļнб
 	// ݣÿһʱ䣬
@@ -53,12 +132,42 @@ namespace AutoFileSync
 		// Create threadpools
 		tpool::ThreadPool* chck_nptr = _afsync_util_threadpool_ptr(chck);
 		chck_nptr = new tpool::ThreadPool(cores);
+		this->chck = chck_nptr;
+		AutoFileSyncBufferPool* buffers_nptr = _afsync_util_buffers_ptr(buffers);
+		buffers_nptr = new AutoFileSyncBufferPool();
+		this->buffers = buffers_nptr;
 		tpool::ThreadPool* sync_nptr = _afsync_util_threadpool_ptr(sync);
 		sync_nptr = new tpool::ThreadPool(cores);
+		this->sync = sync_nptr;
+
+		this->_kernel_once_construct(src, dest, has_subfolders, excluded_subfolders, interval, verbosity, cores);
+		return;
+	}
+
+	// Constructor, sharing the pools and device caps of a daemon with its other synchronizors (jobs)
+	AutoFileSynchonizor::AutoFileSynchonizor(const std::string& src, const std::string& dest, AutoFileSyncShared& shared,
+		bool has_subfolders, const std::vector<std::string>& excluded_subfolders,
+		long long interval, long long verbosity) noexcept
+	{
+		// Lanes in the shared pools, instead of threadpools of its own
+		this->_shared = &shared;
+		this->_shared_chck_lane = shared.chck.open();
+		this->_shared_sync_lane = shared.sync.open();
+		this->buffers = &shared.buffers;
+
+		this->_kernel_once_construct(src, dest, has_subfolders, excluded_subfolders, interval, verbosity, (int)shared.chck.threads());
+		return;
+	}
 
+	// Kernel - Once, set up everything but the threadpools (called by the constructors)
+	void AutoFileSynchonizor::_kernel_once_construct(const std::string& src, const std::string& dest,
+		bool has_subfolders, const std::vector<std::string>& excluded_subfolders,
+		long long interval, long long verbosity, int cores) noexcept
+	{
 		// Create timer clocks
 		Clocks::Clock* clock_nptr = _afsync_util_clock_ptr(clock);
 		clock_nptr = new Clocks::Clock();
+		this->clock = clock_nptr;
 
 		// Eval Elements
 		this->_src = abspath(src);
@@ -66,6 +175,7 @@ namespace AutoFileSync
 		this->_src_has_subfolders = has_subfolders;
 		this->_src_except_subfolders = excluded_subfolders;
 		this->_confg_interval = interval;
+		this->_confg_cores = cores;
 		this->_confg_verbosity = verbosity;
 
 		// Reset elements - See if a default dest is set
@@ -74,10 +184,19 @@ namespace AutoFileSync
 			this->_dest = this->_src.substr(0, min(_src.find_last_of('/'), _src.find_last_of('\\'))) + "/AutoFileCopier/Synchronization/";
 		}
 
-		// Create a set
+		// Excluded subfolder names, as rules for top-level folders (the names escaped)
 		for (const std::string& subs : _src_except_subfolders)
 		{
-			_src_set_except_subfolders.insert(subs);
+			std::string rule = "/";
+			for (char c : subs)
+			{
+				if (std::strchr("\\*?[!# ", c) != nullptr)
+				{
+					rule.push_back('\\');
+				}
+				rule.push_back(c);
+			}
+			_src_excluder.add(rule + "/");
 		}
 
 		// Check src and dest validity
@@ -95,6 +214,53 @@ namespace AutoFileSync
 			}
 		}
 
+		// Load the persistent index of the src kept in the dest
+		// Note it only counts if the last snapshot (folder or manifest) it refers to still exists
+		std::string srcname = this->_src;
+		std::replace(srcname.begin(), srcname.end(), '\\', '/');
+		while (!srcname.empty() && srcname.back() == '/')
+		{
+			srcname.pop_back();
+		}
+		srcname = srcname.substr(srcname.find_last_of('/') + 1);
+
+		// Paths are kept relative to the src (forward slashes), under this prefix
+		this->_src_prefix = abspath(this->_src);
+		std::replace(this->_src_prefix.begin(), this->_src_prefix.end(), '\\', '/');
+		while (!this->_src_prefix.empty() && this->_src_prefix.back() == '/')
+		{
+			this->_src_prefix.pop_back();
+		}
+		this->_src_prefix += "/";
+
+		AutoFileSyncIndex* index_nptr = _afsync_util_index_ptr(index);
+		index_nptr = new AutoFileSyncIndex(abspath(this->_dest) + "/" + srcname + ".afsindex", this->_src_prefix);
+		this->index = index_nptr;
+		this->_store = abspath(this->_dest) + "/" + srcname + ".afschunks";
+		this->_stage = abspath(this->_dest) + "/" + srcname + ".afsstaging";
+		std::string snapshot;
+		if (index_nptr->load(this->monitored_paths, this->last_monitored, snapshot) == true && snapshot != "" && direxist(snapshot) == true)
+		{
+			this->_last_snapshot = snapshot;
+		}
+		else if (snapshot != "" && fileexist(snapshot) == true)
+		{
+			// a manifest, its unchanged files need not be chunked again
+			std::vector<AutoFileSyncManifestFile> files;
+			if (read_manifest(snapshot, files) == true)
+			{
+				for (AutoFileSyncManifestFile& file : files)
+				{
+					this->last_manifest[file.path] = std::move(file);
+				}
+			}
+			this->_last_snapshot = snapshot;
+		}
+		else
+		{
+			this->last_monitored.clear();
+		}
+
 		this->_valid = true;
 		return;
 	}
@@ -110,6 +276,13 @@ namespace AutoFileSync
 			chck_nptr = nullptr;
 			chck = nullptr;
 		}
+		if (this->buffers != nullptr && this->_shared == nullptr)
+		{
+			AutoFileSyncBufferPool* buffers_nptr = _afsync_util_buffers_ptr(buffers);
+			delete buffers_nptr;
+			buffers_nptr = nullptr;
+			buffers = nullptr;
+		}
 		if (this->sync != nullptr)
 		{
 			tpool::ThreadPool* sync_nptr = _afsync_util_threadpool_ptr(sync);
@@ -117,6 +290,27 @@ namespace AutoFileSync
 			sync_nptr = nullptr;
 			sync = nullptr;
 		}
+		if (this->index != nullptr)
+		{
+			AutoFileSyncIndex* index_nptr = _afsync_util_index_ptr(index);
+			delete index_nptr;
+			index_nptr = nullptr;
+			index = nullptr;
+		}
+		if (this->watcher != nullptr)
+		{
+			AutoFileSyncWatcher* watcher_nptr = _afsync_util_watcher_ptr(watcher);
+			delete watcher_nptr;
+			watcher_nptr = nullptr;
+			watcher = nullptr;
+		}
+		if (this->store != nullptr)
+		{
+			AutoFileSyncChunkStore* store_nptr = _afsync_util_store_ptr(store);
+			delete store_nptr;
+			store_nptr = nullptr;
+			store = nullptr;
+		}
 		if (this->clock != nullptr)
 		{
 			Clocks::Clock* clock_nptr = _afsync_util_clock_ptr(clock);
@@ -129,6 +323,13 @@ namespace AutoFileSync
 			delete _worker;
 			_worker = nullptr;
 		}
+		if (this->_shared != nullptr)
+		{
+			this->_shared->chck.close(this->_shared_chck_lane);
+			this->_shared->sync.close(this->_shared_sync_lane);
+			this->_shared = nullptr;
+			buffers = nullptr;
+		}
 
 		return;
 	}
@@ -139,8 +340,34 @@ namespace AutoFileSync
 		return this->_valid;
 	}
 
-	// Kernel - Once, update file info
-	bool AutoFileSynchonizor::_kernel_once_updfileinfo() noexcept
+	// Kernel - Run a task on the checking threadpool (or the synchronizor one), in the lane of this synchronizor if shared
+	void AutoFileSynchonizor::_kernel_invoke(bool checking, AutoFileSyncTask&& task) noexcept
+	{
+		if (this->_shared != nullptr)
+		{
+			AutoFileSyncPool& pool = (checking == true ? this->_shared->chck : this->_shared->sync);
+			pool.submit(checking == true ? this->_shared_chck_lane : this->_shared_sync_lane, std::move(task));
+			return;
+		}
+		tpool::ThreadPool* pool_nptr = _afsync_util_threadpool_ptr(checking == true ? chck : sync);
+		pool_nptr->Invoke([task]() { task(); });
+		return;
+	}
+
+	// Kernel - Fullpath of a monitored file (path id)
+	std::string AutoFileSynchonizor::_kernel_fullpath(unsigned int id) const noexcept
+	{
+		return this->_src_prefix + this->monitored_paths.path(id);
+	}
+
+	// Kernel - Fullpath of the staged copy of a monitored file (path id)
+	std::string AutoFileSynchonizor::_kernel_stagepath(unsigned int id) const noexcept
+	{
+		return this->_stage + "/" + std::to_string(id);
+	}
+
+	// Kernel - Once, update file info, checking the files of known paths (ids below known, with slots) as they are listed
+	bool AutoFileSynchonizor::_kernel_once_updfileinfo(size_t known) noexcept
 	{
 		if (this->_valid == false)
 		{
@@ -154,333 +381,1051 @@ namespace AutoFileSync
 			return false;
 		}
 
-		// Get the files within the mother folder
-		std::vector<std::string> mother_list = listdir(this->_src, false);
-		for (std::string& it : mother_list)
-		{
-			it = this->_src + "/" + it;
-			it = abspath(it);
-		}
-
-		// Try to split files and folders
-		std::vector<std::string> mother_files;
-		std::vector<std::string> mother_folders;
-		for (const std::string& it : mother_list)
+		// Walk the src on the checking threads, every listed folder goes straight to the files to check
+		// Note interning is the only shared step, each folder is interned at once under a lock
+		// Note files of known paths are queued with their fullpath (the paths move while interning) and checked by
+		// the walkers with no folder to list, new files and those still queued are left to the hashing pass
+		std::mutex scan_mutex;
+		std::vector<std::pair<unsigned int, std::string>> streamed;
+		size_t streamed_next = 0;
+		this->_file_tochk.clear();
+		this->_file_tohash.clear();
+		this->_file_sub_tocopy.clear();
+		auto __ = [this, &scan_mutex, &streamed, known](AutoFileSyncScanBatch& batch) -> void
 		{
-			if (fileexist(it) == false)
-			{
-				mother_folders.push_back(it);
-			}
-			else
+			std::string relpath = batch.folder;
+			const size_t base = relpath.empty() ? 0 : relpath.size() + 1;
+			if (base > 0)
 			{
-				mother_files.push_back(it);
+				relpath.push_back('/');
 			}
-		}
 
-		// If applicable, try to get the allowed subfolders and subfiles
-		std::vector<std::string> allowed_subfolders;
-		std::vector<std::string> allowed_subfiles;
-		if (this->_src_has_subfolders)
-		{
-			// Try to deliminate the "\\" or "/" in the end
-			for (std::string& it : mother_folders)
+			std::lock_guard<std::mutex> lock(scan_mutex);
+			for (const std::string& name : batch.files)
 			{
-				if (it.ends_with("\\") || it.ends_with("/"))
+				relpath.resize(base);
+				relpath.append(name);
+				const unsigned int id = this->monitored_paths.intern(relpath);
+				this->_file_tochk.push_back(id);
+				if (id < known)
+				{
+					streamed.emplace_back(id, this->_src_prefix + relpath);
+				}
+				else
 				{
-					it = it.substr(0, it.size() - 1);
+					this->_file_tohash.push_back(id);
 				}
 			}
 
-			// Get the pure folder name and register allowed ones
-			for (const std::string& it : mother_folders)
+			// Register: files and folders to copy (the top level of the src)
+			if (base == 0)
 			{
-				size_t nmstart = min(it.find_last_of('/', 0), it.find_last_of('\\', 0));
-				std::string purename = it.substr(nmstart + 1);
-				// Not in the exception list
-				if (_src_set_except_subfolders.find(purename) == _src_set_except_subfolders.end())
+				for (const std::string& name : batch.files)
+				{
+					this->_file_sub_tocopy.push_back(this->_src_prefix + name);
+				}
+				for (const std::string& name : batch.folders)
 				{
-					allowed_subfolders.push_back(it);
+					this->_file_sub_tocopy.push_back(this->_src_prefix + name);
 				}
 			}
+		};
+		auto runner = [this](std::function<void()>&& task) -> void
+		{
+			this->_kernel_invoke(true, std::move(task));
+		};
 
-			// For each subfolders, get subfiles and concat them
-			for (const std::string& sub : allowed_subfolders)
+		// Lambda, for a walker with no folder to list, checking a few queued files (false if none is queued)
+		// Note on the shared pool, they take a turn on the device of the src like a batch of the hashing pass
+		unsigned long long srcdev = 0;
+		filedevice(this->_src, srcdev);
+		auto idle = [this, &scan_mutex, &streamed, &streamed_next, srcdev]() -> bool
+		{
+			std::vector<std::pair<unsigned int, std::string>> files;
 			{
-				std::vector<std::string> subfiles = dir(sub, false);
-				for (const std::string& file : subfiles)
+				std::lock_guard<std::mutex> lock(scan_mutex);
+				size_t take = std::min(streamed.size() - streamed_next, (size_t)this->_settings_batch_files);
+				for (size_t i = 0; i < take; ++i)
 				{
-					allowed_subfiles.push_back(abspath(file));
+					files.emplace_back(std::move(streamed[streamed_next + i]));
 				}
+				streamed_next += take;
+			}
+			if (files.empty() == true)
+			{
+				return false;
 			}
-		}
 
-		// Register: files to check crc
-		this->_file_tochk = mother_files;
-		for (std::string& it : allowed_subfiles)
+			if (this->_shared != nullptr)
+			{
+				this->_shared->devices.enter(srcdev);
+			}
+			for (const std::pair<unsigned int, std::string>& file : files)
+			{
+				this->_kernel_thread_computecrc(file.first, file.second);
+			}
+			if (this->_shared != nullptr)
+			{
+				this->_shared->devices.leave(srcdev);
+			}
+			this->_status_checked += files.size();
+			return true;
+		};
+
+		int scanners = (int)(this->_shared != nullptr ? this->_settings_shared_scanners : this->_confg_cores);
+		if (scan_tree(this->_src, this->_src_has_subfolders, this->_src_excluder, scanners, runner, __, idle) == false)
 		{
-			this->_file_tochk.emplace_back(std::move(it));
+			return false;
 		}
 
-		// Register: files and folders to copy
-		this->_file_sub_tocopy = mother_files;
-		for (std::string& it : allowed_subfolders)
+		// Files still queued once the walk is done
+		for (size_t i = streamed_next; i < streamed.size(); ++i)
 		{
-			this->_file_sub_tocopy.emplace_back(std::move(it));
+			this->_file_tohash.push_back(streamed[i].first);
 		}
 
 		return true;
 	}
 
-	// Kernel - Thread, compute crc of a given file (write to map)
-	void AutoFileSynchonizor::_kernel_thread_computecrc(const std::string& filepath, bool compare)
+	// Utils (not headerable)
+	// Kernel - now in nanoseconds since the Unix epoch (the clock of the stat tuples)
+	__AUTOFILECOPIER_FUNCTION__
+	__AUTOFILECOPIER_INLINE_FUNCTION__
+	long long _afsync_util_now_ns() noexcept
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	// A file modified within 2 seconds (FAT time resolution) before hashing may be
+	// modified again without its mtime moving, so never trust its stat tuple later
+	constexpr long long _afsync_racy_window = 2000000000LL;
+
+	// Kernel - Thread, stat a given file (path id) and fetch its last record, true if its contents have to be hashed
+	// Note otherwise it is already registered (or skipped if non-existed)
+	bool AutoFileSynchonizor::_kernel_thread_statcrc(unsigned int id, const std::string& filepath, bool compare,
+		AutoFileSyncRecord& record, AutoFileSyncRecord& last_record, bool& last_existed)
 	{
 		if (this->_valid == false)
 		{
-			return;
+			return false;
 		}
 
-		// File non-existed
-		if (fileexist(filepath) == false)
+		// Fetch the last record of the file (last_monitored is read-only while checking)
+		last_existed = this->last_monitored.has(id);
+		if (last_existed == true)
 		{
-			return;
+			last_record = this->last_monitored.get(id);
 		}
 
-		// Compute crc of a file
-		// Lambda Functions
-		auto __crccal__ = [](const char* filepath) -> unsigned long long
+		// Whether the last record can be kept at all, not if hashed by another algorithm (rehashed once after a switch)
+		const bool keepable = last_existed == true && last_record.racy == false && last_record.hash.algo == (unsigned char)this->_confg_hash;
+
+		// Watched fast path, a file the watcher did not see touched keeps its record (not even stat)
+		if (this->_watched == true && this->_verifying == false && keepable == true &&
+			this->watched_dirty.find(filepath) == this->watched_dirty.end())
 		{
-			// Whether a file exists, and its hash is the same as the specified
-			if (fileexist(filepath) == true)
-			{
-				// Create mem and tmp
-				constexpr size_t tmpmem = 4 * 1024 * 1024;
-				unsigned char* tmp = new unsigned char[tmpmem + 1];
-				memset(tmp, 0, tmpmem + 1);
-				WinReadWrite<unsigned char> io((unsigned char*)filepath, 0, tmpmem);
-				if (io.Ready_() == false)
-				{
-					delete[] tmp;
-					tmp = nullptr;
-					return 0ULL;
-				}
+			this->current_monitored.set(id, last_record);
+			return false;
+		}
 
-				// Create state to compute crc64
-				crc64_table state = crc64_init();
-				size_t readbytes = 0;
-				while (io.filePosition_() < io.fileLength_())
-				{
-					// Read
-					if (io.fileLength_() - io.filePosition_() >= tmpmem)
-					{
-						memset(tmp, 0, tmpmem + 1);
-						readbytes = tmpmem;
-						io.WinReadAuto(tmp, readbytes, 0, FILE_CUR);
-					}
-					else
-					{
-						memset(tmp, 0, tmpmem + 1);
-						readbytes = io.fileLength_() - io.filePosition_();
-						io.WinReadAuto(tmp, readbytes, 0, FILE_CUR);
-					}
+		// File non-existed (or not a regular file), otherwise get its stat tuple
+		if (filestat(filepath, record) == false)
+		{
+			return false;
+		}
 
-					// Update Hash
-					crc64_update(tmp, readbytes, &state);
-				}
-				io.Close_();
-				delete[] tmp;
-				tmp = nullptr;
+		// Metadata fast path, the same stat tuple means the same contents
+		// Note not used on a full verification pass or if the last hash was racy (or of another algorithm)
+		if (keepable == true && this->_verifying == false && filestat_same(record, last_record) == true)
+		{
+			record.hash = last_record.hash;
+			record.blocks = last_record.blocks;
+			this->_kernel_thread_registercrc(id, compare, record, last_record, last_existed);
+			return false;
+		}
 
-				uint64_t hash = crc64_final(&state);
-				return hash;
-			}
+		return true;
+	}
 
-			return 0ULL;
-		};
-		unsigned long long crc = __crccal__(filepath.c_str());
+	// Kernel - Thread, register the record of a given file (path id) and compare it with the last one (write to its slots)
+	void AutoFileSynchonizor::_kernel_thread_registercrc(unsigned int id, bool compare,
+		const AutoFileSyncRecord& record, const AutoFileSyncRecord& last_record, bool last_existed)
+	{
+		// Register the record to the current generation
+		this->current_monitored.set(id, record);
 
-		// Register the crc to the current_map
-		this->map_mutex.lock();
-		this->current_monitored[filepath] = crc;
-		this->map_mutex.unlock();
+		// The record itself has changed (to be persisted)
+		if (last_existed == false || record.hash != last_record.hash || record.racy != last_record.racy ||
+			filestat_same(record, last_record) == false)
+		{
+			this->dirty_monitored[id] = 1;
+		}
 
 		// If we need to compare, let's compare
-		if (compare)
+		// A new file, or modified
+		if (compare && (last_existed == false || record.hash != last_record.hash))
 		{
-			this->map_mutex.lock();
-			auto it = this->last_monitored.find(filepath);
-
-			// A new file
-			if (it == this->last_monitored.end())
-			{
-				different_count++;
-				this->map_mutex.unlock();
-				return;
-			}
-
-			// Get the crc
-			unsigned long long last_crc = this->last_monitored[filepath];
-
-			// Pop back the last_mointored
-			this->last_monitored.erase(filepath);
-			this->map_mutex.unlock();
-
-			// The same
-			if (crc == last_crc)
-			{
-				return;
-			}
-
-			// Modified
-			else
-			{
-				different_count++;
-				return;
-			}
+			this->changed_monitored[id] = 1;
 		}
 
 		return;
 	}
 
-	// Kernel - Once, checking synchronizable (called by gotosync)
-	bool AutoFileSynchonizor::_kernel_once_chksync() noexcept
+	// Kernel - Thread, whether a file stated by statcrc is copied to the staging folder while hashed
+	// Note only files suspected changed (new, or another stat tuple) are, and only for snapshots of plain copies
+	// (delta candidates are patched from the last version, compressed and chunked snapshots read them on their own)
+	bool AutoFileSynchonizor::_kernel_thread_stagecrc(bool compare, const AutoFileSyncRecord& record,
+		const AutoFileSyncRecord& last_record, bool last_existed) const noexcept
 	{
-		if (this->_valid == false)
+		return this->_confg_stage == true && compare == true && this->store == nullptr && this->_confg_codec == AFSYNC_CODEC_NONE &&
+			(this->_confg_delta <= 0 || record.size < (unsigned long long)this->_confg_delta) &&
+			(last_existed == false || filestat_same(record, last_record) == false);
+	}
+
+	// Kernel - Thread, whether a file of a size is hashed in ranges by the workers of the hashing pass
+	bool AutoFileSynchonizor::_kernel_thread_splitcrc(unsigned long long size) const noexcept
+	{
+		return this->_scheduler != nullptr && this->_scheduler->workers() > 1 &&
+			size >= (unsigned long long)this->_settings_split_bytes && AutoFileSyncSplitHash::splittable(this->_confg_hash) == true;
+	}
+
+	// Kernel - Thread, hash a given file (path id) stated by statcrc, then register it (write to its slots)
+	void AutoFileSynchonizor::_kernel_thread_hashcrc(unsigned int id, const std::string& filepath, bool compare,
+		AutoFileSyncRecord& record, const AutoFileSyncRecord& last_record, bool last_existed)
+	{
+		// Read and hash the contents, with the readahead depth of its device
+		long long depth = this->_confg_readahead;
+		auto device = this->_confg_readahead_devices.find(record.dev);
+		if (device != this->_confg_readahead_devices.end())
 		{
-			return false;
+			depth = device->second;
 		}
 
-		// Update fileinfo
-		if (_kernel_once_updfileinfo() == false)
+		// Large files get their block sums in the same pass, for delta snapshots
+		std::shared_ptr<AutoFileSyncBlockSums> blocks;
+		if (this->_confg_delta > 0 && record.size >= (unsigned long long)this->_confg_delta)
 		{
-			return false;
+			blocks = std::make_shared<AutoFileSyncBlockSums>();
+			blocks->blocksize = this->_settings_delta_blocksize;
 		}
 
-		// Ptr transformation
-		tpool::ThreadPool* this_chck_nptr = _afsync_util_threadpool_ptr(chck);
-		tpool::ThreadPool* this_sync_nptr = _afsync_util_threadpool_ptr(sync);
-
-		// ǵһμ(Ҫ)
-		if (_file_tochk.size() > 0 && last_monitored.size() == 0)
+		long long hashstart = _afsync_util_now_ns();
+		bool hashed = false;
+		if (this->_kernel_thread_stagecrc(compare, record, last_record, last_existed) == true)
 		{
-			// Initials
-			this->different_count = 0;
-			this->map_mutex.lock();
-			this->current_monitored.clear();
-			this->map_mutex.unlock();
-
-			// Lambda
-			auto __ = [this](const std::string& filepath, bool compare) -> void
-			{
-				this->_kernel_thread_computecrc(filepath, compare);
-				return;
-			};
-
-			// ѭеcrc
-			for (const std::string& it : _file_tochk)
+			// Suspected changed, copied to the staging folder from the same reads (then moved into the snapshot)
+			const std::string staged = this->_kernel_stagepath(id);
+			hashed = hash_copy_file(this->_confg_hash, filepath, staged, record.hash,
+				_afsync_util_buffers_ptr(this->buffers), record.size, depth);
+			if (hashed == true && last_existed == true && record.hash == last_record.hash)
 			{
-				this_chck_nptr->Invoke(__, it, true);
+				// The same contents after all
+				std::error_code ec;
+				std::filesystem::remove(staged, ec);
 			}
-			this_chck_nptr->WaitTillAll();
-
-			// Poplast_monitorļôdifferent_count+=.size()
-			this->map_mutex.lock();
-			if (this->last_monitored.size() > 0)
+			else if (hashed == true)
 			{
-				this->different_count += this->last_monitored.size();
+				this->staged_monitored[id] = 1;
 			}
-			
-			// currentŲlast
-			this->last_monitored = this->current_monitored;
-			this->map_mutex.unlock();
-
-			// Ҫ
-			return true;
+		}
+		else if (this->_kernel_thread_splitcrc(record.size) == true)
+		{
+			// Huge files are hashed in ranges, by this worker and the idle ones
+			std::shared_ptr<AutoFileSyncSplitHash> split = std::make_shared<AutoFileSyncSplitHash>(filepath, record.size,
+				(unsigned long long)this->_settings_split_range, *_afsync_util_buffers_ptr(this->buffers), blocks != nullptr ? blocks->blocksize : 0);
+			std::shared_ptr<AutoFileSyncHelp> help = std::make_shared<AutoFileSyncHelp>([split]() -> bool { return split->help(); });
+			this->_scheduler->offer(help);
+			hashed = split->finish(record.hash, blocks.get());
+			this->_scheduler->withdraw(help);
+		}
+		if (hashed == false)
+		{
+			hashed = hash_file(this->_confg_hash, filepath, record.hash, _afsync_util_buffers_ptr(this->buffers), record.size, depth, blocks.get());
+		}
+		record.racy = record.mtime >= hashstart - _afsync_racy_window;
+		if (hashed == true)
+		{
+			record.blocks = blocks;
 		}
 
-		// ǵһμ
-		else if (_file_tochk.size() > 0 && last_monitored.size() > 0)
+		// Changed blocks since the last version (both trusted, contents changed)
+		if (record.blocks != nullptr && last_existed == true && last_record.blocks != nullptr &&
+			record.racy == false && last_record.racy == false && record.hash != last_record.hash)
 		{
-			// Initials
-			this->different_count = 0;
+			AutoFileSyncDelta delta;
+			delta.blocksize = record.blocks->blocksize;
+			delta.blocks = blocks_changed(*last_record.blocks, *record.blocks);
+			delta.size = record.size;
+			delta.mtime = record.mtime;
+			delta.basesize = last_record.size;
+			delta.basemtime = last_record.mtime;
 			this->map_mutex.lock();
-			this->current_monitored.clear();
+			this->delta_monitored[id] = std::move(delta);
 			this->map_mutex.unlock();
+		}
 
-			// Lambda
-			auto __ = [this](const std::string& filepath, bool compare) -> void
-			{
-				this->_kernel_thread_computecrc(filepath, compare);
-				return;
-			};
-
-			// ļб䣬ֱҪ
-			this->map_mutex.lock_shared();
-			if (_file_tochk.size() != last_monitored.size())
-			{
-				this->map_mutex.unlock_shared();
-
-				// ѭеcrc
-				for (const std::string& it : _file_tochk)
-				{
-					this_chck_nptr->Invoke(__, it, true);
-				}
-				this_chck_nptr->WaitTillAll();
+		++this->_status_hashed;
+		this->_kernel_thread_registercrc(id, compare, record, last_record, last_existed);
+		return;
+	}
 
-				// Poplast_monitorļôdifferent_count+=.size()
-				this->map_mutex.lock();
-				if (this->last_monitored.size() > 0)
-				{
-					this->different_count += this->last_monitored.size();
-				}
+	// Kernel - Thread, compute crc of a given file (path id, and its fullpath) (write to its slots)
+	void AutoFileSynchonizor::_kernel_thread_computecrc(unsigned int id, const std::string& filepath, bool compare)
+	{
+		AutoFileSyncRecord record;
+		AutoFileSyncRecord last_record;
+		bool last_existed = false;
+		if (this->_kernel_thread_statcrc(id, filepath, compare, record, last_record, last_existed) == false)
+		{
+			return;
+		}
 
-				// currentŲlast
-				this->last_monitored = this->current_monitored;
-				this->map_mutex.unlock();
+		this->_kernel_thread_hashcrc(id, filepath, compare, record, last_record, last_existed);
+		return;
+	}
 
-				// ֱҪ
-				return true;
+	// Kernel - Thread, compute crc of files [begin, end) of _file_tohash in io_uring batches on the ring of a worker (write to their slots)
+	void AutoFileSynchonizor::_kernel_thread_computecrcs(size_t begin, size_t end, AutoFileSyncUring& ring, bool compare)
+	{
+		// File by file if the ring cannot be set up (or was dropped)
+		if (ring.ready() == false)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				const unsigned int id = this->_file_tohash[i];
+				this->_kernel_thread_computecrc(id, this->_kernel_fullpath(id), compare);
 			}
+			return;
+		}
 
-			// crcб䣬Ҫ
-			else
+		// Batches bound the hash states alive at once
+		constexpr size_t batchsize = 1024;
+		std::vector<AutoFileSyncHashJob> jobs;
+		std::vector<unsigned int> ids;
+		std::vector<AutoFileSyncRecord> records;
+		std::vector<AutoFileSyncRecord> last_records;
+		std::vector<bool> last_existeds;
+		size_t i = begin;
+		while (i < end)
+		{
+			jobs.clear();
+			ids.clear();
+			records.clear();
+			last_records.clear();
+			last_existeds.clear();
+
+			// Files whose contents have to be hashed
+			for (; i < end && jobs.size() < batchsize; ++i)
 			{
-				this->map_mutex.unlock_shared();
-
-				// ѭеcrc
-				for (const std::string& it : _file_tochk)
+				const unsigned int id = this->_file_tohash[i];
+				const std::string filepath = this->_kernel_fullpath(id);
+				AutoFileSyncRecord record;
+				AutoFileSyncRecord last_record;
+				bool last_existed = false;
+				if (this->_kernel_thread_statcrc(id, filepath, compare, record, last_record, last_existed) == false)
 				{
-					this_chck_nptr->Invoke(__, it, true);
+					continue;
 				}
-				this_chck_nptr->WaitTillAll();
 
-				// Poplast_monitorļôdifferent_count+=.size()
-				this->map_mutex.lock();
-				if (this->last_monitored.size() > 0)
+				// Files for delta snapshots need their block sums, huge files are split and suspected changes staged,
+				// so they go file by file
+				if ((this->_confg_delta > 0 && record.size >= (unsigned long long)this->_confg_delta) ||
+					this->_kernel_thread_splitcrc(record.size) == true ||
+					this->_kernel_thread_stagecrc(compare, record, last_record, last_existed) == true)
 				{
-					this->different_count += this->last_monitored.size();
+					this->_kernel_thread_hashcrc(id, filepath, compare, record, last_record, last_existed);
 				}
-
-				// currentŲlast
-				this->last_monitored = this->current_monitored;
-				this->map_mutex.unlock();
-
-				// Ƿcrcһ
-				if (this->different_count > 0)
+				else
 				{
-					return true;
+					AutoFileSyncHashJob job;
+					job.filepath = filepath;
+					jobs.push_back(job);
+					ids.push_back(id);
+					records.push_back(record);
+					last_records.push_back(last_record);
+					last_existeds.push_back(last_existed);
 				}
-				else
+			}
+
+			// Hash them in one batch (a modification during the batch is after its start)
+			long long hashstart = _afsync_util_now_ns();
+			hash_files(this->_confg_hash, jobs, ring);
+			for (size_t j = 0; j < jobs.size(); ++j)
+			{
+				// Retry the unread ones file by file (the ring may have failed)
+				if (jobs[j].succeeded == false)
 				{
-					return false;
+					hash_file(this->_confg_hash, jobs[j].filepath, jobs[j].digest, _afsync_util_buffers_ptr(this->buffers), records[j].size);
 				}
+				records[j].hash = jobs[j].digest;
+				records[j].racy = records[j].mtime >= hashstart - _afsync_racy_window;
+				this->_kernel_thread_registercrc(ids[j], compare, records[j], last_records[j], last_existeds[j]);
 			}
+			this->_status_hashed += jobs.size();
 		}
-
-		// ܣûļҪ
-		return false;
+		return;
 	}
 
-	// Kernel - Once, go to synchronize (calling check and maybe copy files)
+	// Kernel - Once, compute crc of the files left to hash by the walk on the checking threadpool, then merge (write to map)
+	// Note every file has its own slots (by path id), so the checking threads share no lock and no counter
+	void AutoFileSynchonizor::_kernel_once_computeall(bool compare) noexcept
+	{
+		const size_t count = this->_file_tohash.size();
+		this->_status_phase = AFSYNC_PHASE_HASHING;
+		this->_status_files = this->_file_tochk.size();
+		if (count == 0)
+		{
+			this->_kernel_once_mergeall(compare);
+			return;
+		}
+
+		// Estimated cost of every file, its last size plus the cost of opening it
+		// Note new files count as opening only, stealing evens out a wrong guess
+		std::vector<unsigned long long> weights(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const unsigned int id = this->_file_tohash[i];
+			weights[i] = this->_settings_batch_overhead + (this->last_monitored.has(id) == true ? this->last_monitored.size_of(id) : 0);
+		}
+
+		// Batches, small files coalesced (io_uring batches take whole rings of files)
+		const bool uring = this->_confg_uring > 0;
+		size_t threads = (size_t)(uring ? this->_confg_uring : this->_confg_cores);
+		const size_t maxitems = (uring ? 1024 : (size_t)this->_settings_batch_files);
+		if (threads > (count + maxitems - 1) / maxitems)
+		{
+			threads = (count + maxitems - 1) / maxitems;
+		}
+		AutoFileSyncScheduler scheduler(threads);
+		scheduler.plan(weights, maxitems, (unsigned long long)this->_settings_batch_bytes);
+
+		// Lambda to get the io_uring ring of a worker, set up on its first batch then kept for the others
+		// Note a worker runs one batch at a time, so its ring is never shared
+		std::vector<std::unique_ptr<AutoFileSyncUring>> rings(uring ? scheduler.workers() : 0);
+		auto ringer = [this, &rings](size_t worker) -> AutoFileSyncUring&
+		{
+			if (rings[worker] == nullptr)
+			{
+				rings[worker] = std::make_unique<AutoFileSyncUring>(*_afsync_util_buffers_ptr(this->buffers));
+			}
+			return *rings[worker];
+		};
+
+		// Lambda, one per worker, running batches until none is left anywhere
+		std::latch done((std::ptrdiff_t)scheduler.workers());
+		auto __ = [this, &scheduler, &done, &ringer, uring](size_t worker, bool compare) -> void
+		{
+			scheduler.enter();
+			AutoFileSyncBatch batch;
+			while (scheduler.next(worker, batch) == true)
+			{
+				if (uring == true)
+				{
+					this->_kernel_thread_computecrcs(batch.begin, batch.end, ringer(worker), compare);
+				}
+				else
+				{
+					for (size_t i = batch.begin; i < batch.end; ++i)
+					{
+						const unsigned int id = this->_file_tohash[i];
+						this->_kernel_thread_computecrc(id, this->_kernel_fullpath(id), compare);
+					}
+				}
+				this->_status_checked += batch.end - batch.begin;
+			}
+			scheduler.idle();
+			done.count_down();
+			return;
+		};
+
+		// Lambda, one per worker on the shared pool, running one batch (or a piece of a help) per task then queuing
+		// itself again, so the jobs sharing the pool get their turns in between
+		// Note a task never waits for another one (it leaves instead of idling), the pool may be too busy to run it,
+		// and a batch takes its turn on the device of the src with the hashing and copies of the other jobs
+		unsigned long long srcdev = 0;
+		filedevice(this->_src, srcdev);
+		std::function<void(size_t)> step;
+		step = [this, &scheduler, &done, &step, &ringer, uring, compare, srcdev](size_t worker) -> void
+		{
+			AutoFileSyncBatch batch;
+			if (scheduler.next(worker, batch) == true)
+			{
+				this->_shared->devices.enter(srcdev);
+				if (uring == true)
+				{
+					this->_kernel_thread_computecrcs(batch.begin, batch.end, ringer(worker), compare);
+				}
+				else
+				{
+					for (size_t i = batch.begin; i < batch.end; ++i)
+					{
+						const unsigned int id = this->_file_tohash[i];
+						this->_kernel_thread_computecrc(id, this->_kernel_fullpath(id), compare);
+					}
+				}
+				this->_shared->devices.leave(srcdev);
+				this->_status_checked += batch.end - batch.begin;
+			}
+			else if (scheduler.help() == false)
+			{
+				scheduler.leave();
+				done.count_down();
+				return;
+			}
+			this->_kernel_invoke(true, [&step, worker]() { step(worker); });
+			return;
+		};
+
+		// ѭеcrc (waiting for these workers only, not the whole threadpool)
+		this->_scheduler = &scheduler;
+		for (size_t k = 0; k < scheduler.workers(); ++k)
+		{
+			if (this->_shared != nullptr)
+			{
+				scheduler.enter();
+				this->_kernel_invoke(true, [&step, k]() { step(k); });
+				continue;
+			}
+			this->_kernel_invoke(true, [&__, k, compare]() { __(k, compare); });
+		}
+		done.wait();
+		this->_scheduler = nullptr;
+		this->_kernel_once_mergeall(compare);
+		return;
+	}
+
+	// Kernel - Once, count the changes found by the checking threads, then swap the generations (write to map)
+	// Note files of the last generation missing from the current one are the deleted files
+	void AutoFileSynchonizor::_kernel_once_mergeall(bool compare) noexcept
+	{
+		this->map_mutex.lock();
+		if (compare)
+		{
+			this->different_count += std::count(this->changed_monitored.begin(), this->changed_monitored.end(), (unsigned char)1);
+		}
+		for (unsigned int id = 0; id < (unsigned int)this->last_monitored.size(); ++id)
+		{
+			if (this->last_monitored.has(id) == true && this->current_monitored.has(id) == false)
+			{
+				this->deleted_monitored.push_back(id);
+				this->different_count++;
+			}
+		}
+
+		// currentlast
+		// Note the generation before stays in current until the next check, to roll back to
+		this->last_monitored.swap(this->current_monitored);
+		this->map_mutex.unlock();
+		return;
+	}
+
+	// Kernel - Once, swap the generations back once the snapshot of a check failed, so the next check finds its changes again
+	// Note nothing of the check is persisted, and the watched paths it took are gone, so the next check stats every file
+	void AutoFileSynchonizor::_kernel_once_rollback() noexcept
+	{
+		this->map_mutex.lock();
+		this->last_monitored.swap(this->current_monitored);
+		this->current_monitored.clear();
+		std::fill(this->dirty_monitored.begin(), this->dirty_monitored.end(), 0);
+		this->deleted_monitored.clear();
+		this->map_mutex.unlock();
+		this->_watched_lost = true;
+		return;
+	}
+
+	// Kernel - Once, checking synchronizable (called by gotosync)
+	bool AutoFileSynchonizor::_kernel_once_chksync() noexcept
+	{
+		if (this->_valid == false)
+		{
+			return false;
+		}
+
+		// Status of a new synchronization
+		this->_status_phase = AFSYNC_PHASE_SCANNING;
+		this->_status_files = 0;
+		this->_status_checked = 0;
+		this->_status_hashed = 0;
+		this->_status_copies = 0;
+		this->_status_copied = 0;
+		this->_status_bytes = 0;
+
+		// Drop the paths of files long gone once they outnumber the live ones (ids are renumbered)
+		// Note the index is unaffected, it keeps whole paths, but nothing may be left to persist
+		if (this->monitored_paths.size() > 2 * this->last_monitored.count() + 65536 && this->deleted_monitored.empty() == true &&
+			std::find(this->dirty_monitored.begin(), this->dirty_monitored.end(), (unsigned char)1) == this->dirty_monitored.end())
+		{
+			std::vector<unsigned char> keep(this->monitored_paths.size(), 0);
+			for (unsigned int id = 0; id < (unsigned int)keep.size(); ++id)
+			{
+				keep[id] = this->last_monitored.has(id) ? 1 : 0;
+			}
+			std::vector<unsigned int> remap = this->monitored_paths.compact(keep);
+			this->last_monitored.remap(remap, this->monitored_paths.size());
+		}
+
+		// Decide whether this check is a full verification pass (no metadata fast path)
+		this->_verifying = false;
+		if (this->_confg_verify > 0 && ++this->_verify_checks >= this->_confg_verify)
+		{
+			this->_verifying = true;
+			this->_verify_checks = 0;
+		}
+
+		// Take the files touched since the last check from the watcher, before the walk checks the first files
+		// Note only trusted if no event was lost and there is a last check to compare with,
+		// and lost if the check ends early (the next one stats every file)
+		AutoFileSyncWatcher* watcher_nptr = _afsync_util_watcher_ptr(watcher);
+		this->_watched = false;
+		if (watcher_nptr != nullptr)
+		{
+			this->_watched = watcher_nptr->take(this->watched_dirty) == true && this->last_monitored.count() > 0 &&
+				this->_watched_lost == false;
+		}
+		this->_watched_lost = false;
+
+		// Initials, slots for every path interned so far (ids never move while checking)
+		// Note the files listed with these ids are checked during the walk, the slots of new ones are made after it
+		this->different_count = 0;
+		this->map_mutex.lock();
+		const size_t known = this->monitored_paths.size();
+		this->current_monitored.clear();
+		this->current_monitored.resize(known);
+		this->last_monitored.resize(known);
+		this->changed_monitored.assign(known, 0);
+		this->staged_monitored.assign(known, 0);
+		this->dirty_monitored.assign(known, 0);
+		this->delta_monitored.clear();
+		this->deleted_monitored.clear();
+		this->map_mutex.unlock();
+
+		// Staging folder, emptied of what an interrupted snapshot left
+		this->_kernel_once_unstage();
+		if (this->_confg_stage == true)
+		{
+			std::error_code ec;
+			std::filesystem::create_directories(this->_stage, ec);
+		}
+
+		// Update fileinfo
+		if (_kernel_once_updfileinfo(known) == false)
+		{
+			this->_watched_lost = true;
+			return false;
+		}
+
+		// Ptr transformation
+		tpool::ThreadPool* this_sync_nptr = _afsync_util_threadpool_ptr(sync);
+
+		// ܣûļҪ
+		if (this->_file_tochk.size() == 0)
+		{
+			this->_watched_lost = true;
+			return false;
+		}
+
+		// ǵһμ(Ҫ)ļб䣬ֱҪ
+		const bool firstcheck = this->last_monitored.count() == 0;
+		const bool recounted = this->_file_tochk.size() != this->last_monitored.count();
+
+		// Slots for the paths interned by the walk (nothing is checking now)
+		this->map_mutex.lock();
+		const size_t ids = this->monitored_paths.size();
+		this->current_monitored.resize(ids);
+		this->last_monitored.resize(ids);
+		this->changed_monitored.resize(ids, 0);
+		this->staged_monitored.resize(ids, 0);
+		this->dirty_monitored.resize(ids, 0);
+		this->map_mutex.unlock();
+
+		// ѭеcrc (then merged into last)
+		this->_kernel_once_computeall();
+
+		// Ƿcrcһ
+		if (firstcheck == true || recounted == true || this->different_count > 0)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	// Kernel - Once, persist the records of the last check to the index
+	bool AutoFileSynchonizor::_kernel_once_persist() noexcept
+	{
+		AutoFileSyncIndex* index_nptr = _afsync_util_index_ptr(index);
+		if (index_nptr == nullptr)
+		{
+			return false;
+		}
+
+		// Append the dirty and deleted records, which are cleared once persisted
+		this->map_mutex.lock();
+		std::vector<unsigned int> puts;
+		for (unsigned int id = 0; id < (unsigned int)this->dirty_monitored.size(); ++id)
+		{
+			if (this->dirty_monitored[id] != 0)
+			{
+				puts.push_back(id);
+			}
+		}
+		bool persisted = index_nptr->commit(this->monitored_paths, this->last_monitored, puts, this->deleted_monitored, this->_last_snapshot);
+		if (persisted == true)
+		{
+			std::fill(this->dirty_monitored.begin(), this->dirty_monitored.end(), 0);
+			this->deleted_monitored.clear();
+		}
+		this->map_mutex.unlock();
+
+		return persisted;
+	}
+
+	// Kernel - Once, drop the staged copies not moved into a snapshot
+	void AutoFileSynchonizor::_kernel_once_unstage() noexcept
+	{
+		std::error_code ec;
+		if (std::filesystem::exists(this->_stage, ec) == true)
+		{
+			std::filesystem::remove_all(this->_stage, ec);
+		}
+		std::fill(this->staged_monitored.begin(), this->staged_monitored.end(), 0);
+		return;
+	}
+
+	// Kernel - Once, copy the scheduled snapshot files on the synchronizor threadpool, largest first,
+	// into the mirror roots given as well ("" for a mirror left out)
+	// Note the longest copies start first so none is left alone at the end (LPT order),
+	// and writes to the same device are capped by _confg_copy_writes
+	// Note a file copied from the src goes to every destination from the same reads (AutoFileSyncFanout),
+	// a mirror left behind there (or given a file linked, moved, patched or compressed in the snapshot)
+	// copies the snapshot file afterwards, so the src is read once whatever the mirrors
+	void AutoFileSynchonizor::_kernel_once_copyall(std::vector<AutoFileSyncCopyTask>& tasks, const std::vector<std::string>& mirrors) noexcept
+	{
+		AutoFileSyncBufferPool* buffers_nptr = _afsync_util_buffers_ptr(buffers);
+		AutoFileSyncCopyGate owngate(this->_confg_copy_writes);
+		AutoFileSyncCopyGate& gate = (this->_shared != nullptr ? this->_shared->devices : owngate);
+
+		this->linked_count = 0;
+		for (std::atomic<long long>& count : this->copied_count)
+		{
+			count = 0;
+		}
+		this->mirrored_count = 0;
+		this->_status_phase = AFSYNC_PHASE_COPYING;
+		this->_status_copies = tasks.size();
+
+		// Writers of every destination, if any mirror takes the snapshot
+		const std::string root = abspath(this->_dest);
+		std::unique_ptr<AutoFileSyncFanout> fanout;
+		if (std::count(mirrors.begin(), mirrors.end(), std::string("")) < (long long)mirrors.size())
+		{
+			fanout = std::make_unique<AutoFileSyncFanout>(mirrors.size() + 1, (size_t)this->_settings_fanout_writers,
+				(unsigned long long)this->_settings_fanout_budget);
+		}
+
+		// Mirror files to copy from the snapshot files afterwards
+		std::mutex behind_mutex;
+		std::vector<std::pair<std::string, std::string>> behind;
+
+		// Hard links cost nothing, so they go after the copies
+		std::stable_sort(tasks.begin(), tasks.end(), [](const AutoFileSyncCopyTask& x, const AutoFileSyncCopyTask& y) -> bool
+			{
+				bool xlink = x.origin != "";
+				bool ylink = y.origin != "";
+				if (xlink != ylink)
+				{
+					return ylink;
+				}
+				return x.size > y.size;
+			});
+
+		// Lambda to get the path of a file of the dest in a mirror, "" if not in the dest
+		auto mirrored = [&root, &mirrors](const std::string& path, size_t m) -> std::string
+		{
+			if (path.compare(0, root.size(), root) != 0)
+			{
+				return "";
+			}
+			return mirrors[m] + path.substr(root.size());
+		};
+
+		// Lambda to materialize the file of a task in the snapshot, and in the mirrors (targets 1...) from the same reads
+		auto materialize = [this, buffers_nptr, &gate, &fanout](AutoFileSyncCopyTask* task, std::vector<std::string>& targets) -> bool
+		{
+			// unchanged (as compressed as it was)
+			if (task->origin != "")
+			{
+				std::error_code ec;
+				std::filesystem::create_hard_link(task->origin, task->to, ec);
+				if (!ec)
+				{
+					task->codec = (task->origincodec != nullptr ? task->origincodec->codec : (unsigned char)AFSYNC_CODEC_NONE);
+					task->size = (task->origincodec != nullptr ? task->origincodec->size : task->size);
+					++this->linked_count;
+					return true;
+				}
+			}
+
+			// changed or new, read once while hashed, so only moved in place
+			if (task->staged != "")
+			{
+				std::error_code ec;
+				std::filesystem::rename(task->staged, task->to, ec);
+				if (!ec)
+				{
+					++this->copied_count[AFSYNC_COPY_STAGED];
+					this->_status_bytes += task->size;
+					return true;
+				}
+			}
+
+			// changed, new, or failed to link (a delta is copied whole if the last version does not fit)
+			gate.enter(task->dev);
+			AutoFileSyncCopyPath path = AFSYNC_COPY_FAILED;
+			if (task->delta != nullptr)
+			{
+				path = copy_delta(task->from, task->to, task->base, *task->delta, buffers_nptr);
+			}
+			if (path == AFSYNC_COPY_FAILED && task->codec != AFSYNC_CODEC_NONE)
+			{
+				// Already compressed formats are stored as they are
+				unsigned long long size = 0;
+				if (compressed_format(task->from) == false &&
+					compress_file(task->from, task->to, (AutoFileSyncCodec)task->codec, (int)this->_confg_codec_level,
+						(int)this->_settings_compress_threads, *buffers_nptr, size) == true)
+				{
+					path = AFSYNC_COPY_COMPRESSED;
+					task->size = size;
+				}
+				else
+				{
+					task->codec = AFSYNC_CODEC_NONE;
+				}
+			}
+			if (path == AFSYNC_COPY_FAILED && fanout != nullptr &&
+				std::count(targets.begin() + 1, targets.end(), std::string("")) < (long long)targets.size() - 1)
+			{
+				// The snapshot and the mirrors at once, the snapshot copied from a mirror if left behind
+				std::vector<char> written;
+				targets[0] = task->to;
+				fanout->copy(task->from, targets, *buffers_nptr, written);
+				targets[0] = "";
+				std::string copied = "";
+				for (size_t d = 1; d < targets.size(); ++d)
+				{
+					if (written[d] != 0)
+					{
+						copied = targets[d];
+						targets[d] = "";
+						++this->mirrored_count;
+					}
+				}
+				if (written[0] != 0)
+				{
+					path = AFSYNC_COPY_FANOUT;
+				}
+				else if (copied != "")
+				{
+					path = copy_file(copied, task->to, buffers_nptr);
+				}
+			}
+			if (path == AFSYNC_COPY_FAILED)
+			{
+				path = copy_file(task->from, task->to, buffers_nptr);
+			}
+			++this->copied_count[path];
+			gate.leave(task->dev);
+			if (path != AFSYNC_COPY_FAILED)
+			{
+				this->_status_bytes += task->size;
+			}
+			return path != AFSYNC_COPY_FAILED;
+		};
+
+		// Lambda
+		auto __ = [this, &mirrors, &mirrored, &materialize, &behind_mutex, &behind](AutoFileSyncCopyTask* task) -> void
+		{
+			// Mirror files, unchanged ones hard-linked from the last snapshot of their mirror
+			std::vector<std::string> targets(mirrors.size() + 1, "");
+			for (size_t m = 0; m < mirrors.size(); ++m)
+			{
+				if (mirrors[m] == "")
+				{
+					continue;
+				}
+				targets[m + 1] = mirrored(task->to, m);
+				if (task->origin != "")
+				{
+					std::error_code ec;
+					std::filesystem::create_hard_link(mirrored(task->origin, m), targets[m + 1], ec);
+					if (!ec)
+					{
+						targets[m + 1] = "";
+						++this->mirrored_count;
+					}
+				}
+			}
+
+			// The mirror files left are copies of the snapshot file (as compressed as it is)
+			// Note a file failed part-way is removed, rather than left truncated for the next snapshots to link
+			if (materialize(task, targets) == false)
+			{
+				std::error_code ec;
+				std::filesystem::remove(task->to, ec);
+				task->failed = true;
+			}
+			else
+			{
+				std::lock_guard<std::mutex> lock(behind_mutex);
+				for (size_t d = 1; d < targets.size(); ++d)
+				{
+					if (targets[d] != "")
+					{
+						behind.emplace_back(task->to, targets[d]);
+					}
+				}
+			}
+			++this->_status_copied;
+			return;
+		};
+
+		// Waiting for these copies only, not the whole threadpool
+		std::latch copied((std::ptrdiff_t)tasks.size());
+		for (AutoFileSyncCopyTask& task : tasks)
+		{
+			this->_kernel_invoke(false, [&__, &copied, &task]() { __(&task); copied.count_down(); });
+		}
+		copied.wait();
+		fanout.reset();
+
+		// Lambda to catch a mirror file up, from the snapshot file
+		auto catchup = [this, buffers_nptr](std::pair<std::string, std::string>* copy) -> void
+		{
+			if (copy_file(copy->first, copy->second, buffers_nptr) != AFSYNC_COPY_FAILED)
+			{
+				++this->mirrored_count;
+			}
+			return;
+		};
+
+		std::latch caughtup((std::ptrdiff_t)behind.size());
+		for (std::pair<std::string, std::string>& copy : behind)
+		{
+			this->_kernel_invoke(false, [&catchup, &caughtup, &copy]() { catchup(&copy); caughtup.count_down(); });
+		}
+		caughtup.wait();
+		return;
+	}
+
+	// Kernel - Once, chunk the checked files into the chunk store on the synchronizor threadpool, then write a manifest
+	// Note unchanged files keep their chunks from the last manifest, so only changed and new files are read,
+	// the largest first, and a file that cannot be read is left out of the manifest
+	bool AutoFileSynchonizor::_kernel_once_storeall(const std::string& manifest) noexcept
+	{
+		AutoFileSyncBufferPool* buffers_nptr = _afsync_util_buffers_ptr(buffers);
+		AutoFileSyncChunkStore* store_nptr = _afsync_util_store_ptr(store);
+
+		this->chunked_count = 0;
+		this->chunked_failed = 0;
+		this->chunked_bytes = 0;
+		this->_status_phase = AFSYNC_PHASE_STORING;
+
+		// Files of the manifest, relative to the src
+		std::vector<AutoFileSyncManifestFile> files;
+		std::vector<std::string> sources;
+		std::vector<size_t> tochunk;
+		this->map_mutex.lock_shared();
+		for (unsigned int id : this->_file_tochk)
+		{
+			if (this->last_monitored.has(id) == false)
+			{
+				continue;
+			}
+
+			AutoFileSyncManifestFile file;
+			file.path = this->monitored_paths.path(id);
+			file.size = this->last_monitored.size_of(id);
+			file.mtime = this->last_monitored.mtime_of(id);
+
+			// unchanged since the last manifest, or changed and new
+			auto last = this->last_manifest.find(file.path);
+			if (this->changed_monitored[id] == 0 && last != this->last_manifest.end() &&
+				last->second.size == file.size && last->second.mtime == file.mtime)
+			{
+				file.chunks = last->second.chunks;
+			}
+			else
+			{
+				tochunk.push_back(files.size());
+			}
+			files.emplace_back(std::move(file));
+			sources.push_back(this->_kernel_fullpath(id));
+		}
+		this->map_mutex.unlock_shared();
+
+		this->_status_copies = tochunk.size();
+		std::stable_sort(tochunk.begin(), tochunk.end(), [&files](size_t x, size_t y) -> bool
+			{
+				return files[x].size > files[y].size;
+			});
+
+		// Lambda
+		std::vector<char> failed(files.size(), 0);
+		auto __ = [this, store_nptr, buffers_nptr, &files, &sources, &failed](size_t i) -> void
+		{
+			unsigned long long size = 0;
+			unsigned long long stored = 0;
+			bool put = store_nptr->put_file(sources[i], files[i].chunks, buffers_nptr, size, stored);
+			++this->_status_copied;
+			if (put == false)
+			{
+				failed[i] = 1;
+				++this->chunked_failed;
+				return;
+			}
+			files[i].size = size;
+			++this->chunked_count;
+			this->chunked_bytes += stored;
+			this->_status_bytes += stored;
+			return;
+		};
+
+		std::latch chunked((std::ptrdiff_t)tochunk.size());
+		for (size_t i : tochunk)
+		{
+			this->_kernel_invoke(false, [&__, &chunked, i]() { __(i); chunked.count_down(); });
+		}
+		chunked.wait();
+
+		// The chunks must be on disk before the manifest refers to them
+		if (store_nptr->flush() == false)
+		{
+			return false;
+		}
+		std::vector<AutoFileSyncManifestFile> written;
+		written.reserve(files.size());
+		for (size_t i = 0; i < files.size(); ++i)
+		{
+			if (failed[i] == 0)
+			{
+				written.emplace_back(std::move(files[i]));
+			}
+		}
+		if (write_manifest(manifest, written) == false)
+		{
+			return false;
+		}
+
+		// Register the manifest as the base of the next one
+		this->last_manifest.clear();
+		for (AutoFileSyncManifestFile& file : written)
+		{
+			this->last_manifest[file.path] = std::move(file);
+		}
+		return true;
+	}
+
+	// Kernel - Once, go to synchronize (calling check and maybe copy files)
 	bool AutoFileSynchonizor::_kernel_once_gotosync() noexcept
 	{
 		if (this->_valid == false)
@@ -549,38 +1494,265 @@ namespace AutoFileSync
 				}
 			};
 
+			// Snapshot files to materialize, scheduled after the walk
+			std::vector<AutoFileSyncCopyTask> tasks;
+			unsigned long long destdev = 0;
+
+			// Mirror roots given the snapshot folder, "" for those it cannot be made in
+			std::vector<std::string> mirrors;
+			const std::string root = abspath(this->_dest);
+
+			// Lambda to create a folder of the snapshot (fullpath), in the mirrors as well
+			auto dirmaker = [&](const std::string& folder) -> bool
+			{
+				std::error_code ec;
+				std::filesystem::create_directories(folder, ec);
+				for (const std::string& mirror : mirrors)
+				{
+					if (mirror != "")
+					{
+						std::error_code mec;
+						std::filesystem::create_directories(mirror + folder.substr(root.size()), mec);
+					}
+				}
+				return !ec;
+			};
+
+			// Lambda to schedule a file copy (or a hard link from origin)
+			auto copier = [&](const std::string& from, const std::string& to, unsigned long long size, const std::string& origin = "") -> void
+			{
+				AutoFileSyncCopyTask task;
+				task.from = from;
+				task.to = to;
+				task.origin = origin;
+				task.size = size;
+				task.dev = destdev;
+				task.codec = this->_confg_codec;
+				tasks.emplace_back(std::move(task));
+			};
+
+			// Lambda to get the staged copy of a file (path id), "" if not staged
+			auto stager = [&](unsigned int id) -> std::string
+			{
+				if (id >= this->staged_monitored.size() || this->staged_monitored[id] == 0)
+				{
+					return "";
+				}
+				return this->_kernel_stagepath(id);
+			};
+
+			// Lambda to schedule a folder file by file, creating it and its subfolders now
+			// Note excluded files and folders are left out (the folder itself is at the top level of the src)
+			auto foldercopier = [&](const std::string& from, const std::string& to) -> void
+			{
+				std::error_code ec;
+				dirmaker(to);
+				const std::string relbase = filenamer(from) + "/";
+				for (std::filesystem::recursive_directory_iterator it(from, std::filesystem::directory_options::skip_permission_denied, ec), end;
+					!ec && it != end; it.increment(ec))
+				{
+					std::filesystem::path relative = it->path().lexically_relative(from);
+					std::filesystem::path target = std::filesystem::path(to) / relative;
+					std::error_code tec;
+					bool isdir = it->is_directory(tec);
+					if (this->_src_excluder.excluded(relbase + relative.generic_string(), isdir) == true)
+					{
+						if (isdir == true)
+						{
+							it.disable_recursion_pending();
+						}
+						continue;
+					}
+					if (isdir == true)
+					{
+						dirmaker(target.string());
+					}
+					else if (it->is_regular_file(tec) == true)
+					{
+						copier(it->path().string(), target.string(), it->file_size(tec));
+						tasks.back().id = this->monitored_paths.find(relbase + relative.generic_string());
+						tasks.back().staged = stager(tasks.back().id);
+					}
+				}
+			};
+
 			// Create new sync folder name and folder
 			std::string folder_name = filenamer(this->_src) + " " + curtime();
-			std::string folder_path = abspath(this->_dest) + "/" + folder_name;
+			std::string folder_path = root + "/" + folder_name;
+
+			// Deduplicated snapshot, a manifest of chunks in the chunk store
+			if (this->store != nullptr)
+			{
+				std::string manifest_path = folder_path + ".afsmanifest";
+				if (this->_kernel_once_storeall(manifest_path) == false)
+				{
+					this->_kernel_once_rollback();
+					return false;
+				}
+
+				// Register the new manifest as the last snapshot, then persist
+				this->_last_snapshot = manifest_path;
+				this->_kernel_once_persist();
+
+				return true;
+			}
+
 			if (makedirs(folder_path) == false)
 			{
+				this->_kernel_once_rollback();
 				return false;
 			}
+			filedevice(folder_path, destdev);
+			for (const std::string& mirror : this->_dest_mirrors)
+			{
+				mirrors.push_back(makedirs(mirror + "/" + folder_name) == true ? mirror : "");
+			}
 
-			// Copy files into the new folder
-			for (const std::string& it : this->_file_sub_tocopy)
+			// Incremental snapshot, based on the last one (if it still exists)
+			std::vector<AutoFileSyncCompressedFile> lastcodecs;
+			if (this->_confg_incremental == true && this->_last_snapshot != "" && direxist(this->_last_snapshot) == true)
 			{
-				// file
-				if (fileexist(it) == true)
+				// Files compressed in the last snapshot, linked as they are
+				std::unordered_map<std::string, const AutoFileSyncCompressedFile*> lastcompressed;
+				read_codecs(this->_last_snapshot + ".afscodecs", lastcodecs);
+				for (const AutoFileSyncCompressedFile& file : lastcodecs)
 				{
-					copy(it, folder_path + "/" + filenamer(it), true);
+					lastcompressed[file.path] = &file;
 				}
 
-				// folder
-				else if(direxist(it) == true)
+				// Materialize every checked file: changed or new files are copied,
+				// unchanged files are hard-linked from the last snapshot
+				// Note a failed link (cross-device, link count limit, ...) falls back to a copy,
+				// and files gone since the scan (no record) are left out rather than linked back
+				this->map_mutex.lock_shared();
+				for (unsigned int id : this->_file_tochk)
 				{
-					copyAll(it, folder_path + "/" + filenamer(it), true);
+					if (this->last_monitored.has(id) == false)
+					{
+						continue;
+					}
+					std::string relpath = this->monitored_paths.path(id);
+					std::string source = this->_kernel_fullpath(id);
+					std::string target = folder_path + "/" + relpath;
+					std::string origin = this->_last_snapshot + "/" + relpath;
+					dirmaker(target.substr(0, target.find_last_of('/')));
+					unsigned long long size = this->last_monitored.size_of(id);
+
+					// unchanged, or changed and new
+					auto compressed = lastcompressed.find(relpath);
+					if (this->changed_monitored[id] == 0)
+					{
+						copier(source, target, size, origin);
+						tasks.back().id = id;
+						tasks.back().origincodec = (compressed != lastcompressed.end() ? compressed->second : nullptr);
+					}
+					else
+					{
+						copier(source, target, size);
+						tasks.back().id = id;
+						tasks.back().staged = stager(id);
+
+						// large and modified, patch the last version with the changed blocks (both raw)
+						auto delta = this->delta_monitored.find(id);
+						if (delta != this->delta_monitored.end() && this->_confg_codec == AFSYNC_CODEC_NONE &&
+							compressed == lastcompressed.end())
+						{
+							unsigned long long patched = (unsigned long long)delta->second.blocks.size() * delta->second.blocksize;
+							tasks.back().base = origin;
+							tasks.back().delta = &delta->second;
+							tasks.back().size = (patched < size ? patched : size);
+						}
+					}
 				}
+				this->map_mutex.unlock_shared();
+			}
 
-				// Invalid, maybe deleted, ignore it
+			// Full snapshot
+			else
+			{
+				// Copy files into the new folder
+				for (const std::string& it : this->_file_sub_tocopy)
+				{
+					// file
+					if (fileexist(it) == true)
+					{
+						std::error_code ec;
+						copier(it, folder_path + "/" + filenamer(it), std::filesystem::file_size(it, ec));
+						tasks.back().id = this->monitored_paths.find(filenamer(it));
+						tasks.back().staged = stager(tasks.back().id);
+					}
+
+					// folder
+					else if (direxist(it) == true)
+					{
+						foldercopier(it, folder_path + "/" + filenamer(it));
+					}
+
+					// Invalid, maybe deleted, ignore it
+				}
 			}
 
+			// Copy them all, then drop the staged copies left (failed to move)
+			this->_kernel_once_copyall(tasks, mirrors);
+			this->_kernel_once_unstage();
+
+			// Forget the records of the files that failed, so the next check finds them new and copies them
+			// Note their last persisted records are kept in the index, not the ones never snapshot
+			this->map_mutex.lock();
+			for (const AutoFileSyncCopyTask& task : tasks)
+			{
+				if (task.failed == true && task.id < this->last_monitored.size())
+				{
+					this->last_monitored.erase(task.id);
+					this->dirty_monitored[task.id] = 0;
+				}
+			}
+			this->map_mutex.unlock();
+
+			// Record the compressed files next to the snapshot, for restoring and for the next snapshot
+			std::vector<AutoFileSyncCompressedFile> codecs;
+			for (const AutoFileSyncCopyTask& task : tasks)
+			{
+				if (task.failed == false && task.codec != AFSYNC_CODEC_NONE)
+				{
+					AutoFileSyncCompressedFile file;
+					file.path = task.to.substr(folder_path.size() + 1);
+					file.codec = task.codec;
+					file.size = task.size;
+					codecs.emplace_back(std::move(file));
+				}
+			}
+			if (codecs.empty() == false && write_codecs(folder_path + ".afscodecs", codecs) == false)
+			{
+				this->_kernel_once_rollback();
+				return false;
+			}
+			for (const std::string& mirror : mirrors)
+			{
+				if (mirror != "" && codecs.empty() == false)
+				{
+					write_codecs(mirror + "/" + folder_name + ".afscodecs", codecs);
+				}
+			}
+
+			// Register the new snapshot as the base of the next one
+			this->_last_snapshot = folder_path;
+
+			// Persist the records now covered by the snapshot
+			this->_kernel_once_persist();
+
 			return true;
 		}
 
 		// No need~
 		else
 		{
+			// Nothing staged is needed (metadata changed only)
+			this->_kernel_once_unstage();
+
+			// Persist the records (contents unchanged, stat tuples may have)
+			this->_kernel_once_persist();
+
 			return true;
 		}
 	}
@@ -621,22 +1793,87 @@ namespace AutoFileSync
 		{
 			std::cout << curtime() << " : " << "Synchonization starts!" << std::endl;
 			std::cout << curtime() << " : " << "Mointering at directory " + this->_src << std::endl;
+			std::cout << curtime() << " : " << "Hashing with " << hash_name(this->_confg_hash);
+			if (this->_confg_hash == AFSYNC_HASH_CRC64)
+			{
+				std::cout << " (kernel " << crc64_fast_kernel() << ")";
+			}
+			std::cout << std::endl;
+			if (this->watcher != nullptr)
+			{
+				std::cout << curtime() << " : " << "Watching file system events with " << _afsync_util_watcher_ptr(watcher)->backend() << std::endl;
+			}
+			else if (this->_confg_watch == true)
+			{
+				std::cout << curtime() << " : " << "File system events unavailable, polling instead" << std::endl;
+			}
 			std::cout << std::endl;
 		}
 
+		// First change seen of the next snapshot (steady ns), 0 if none
+		long long firstseen = 0;
+
 		// While stop signal is not sent
 		while (this->_worker_control_tostop == false)
 		{
 			// ʱʱԤ裬
-			if (clock_nptr->elapse() * 1000 > this->_confg_interval)
+			// Or once the changes the watcher has seen have settled, or when asked to (even if paused)
+			AutoFileSyncWatcher* watcher_nptr = _afsync_util_watcher_ptr(watcher);
+			bool touched = watcher_nptr != nullptr && watcher_nptr->pending() == true;
+			bool syncnow = this->_worker_control_syncnow.exchange(false);
+			unsigned long long asked = this->_worker_syncs_asked;
+			bool paused = this->_worker_control_paused;
+			long long elapsed = clock_nptr->elapse() * 1000;
+			long long wait = this->_confg_interval - elapsed + 1;
+			bool settled = false;
+			if (touched == true)
+			{
+				// Quiet since the last event, and waited since the first change
+				long long now = _afsync_util_steady_now_ns();
+				firstseen = (firstseen == 0 ? now : firstseen);
+				long long quiet = (now - watcher_nptr->touched()) / 1000000;
+				long long waited = (now - firstseen) / 1000000;
+				settled = (this->_confg_settle <= 0 || quiet >= this->_confg_settle);
+				if (this->_confg_max_latency > 0 && waited >= this->_confg_max_latency)
+				{
+					settled = true;
+				}
+
+				// Otherwise wake up when it would be
+				if (settled == false)
+				{
+					wait = std::min(wait, this->_confg_settle - quiet);
+					if (this->_confg_max_latency > 0)
+					{
+						wait = std::min(wait, this->_confg_max_latency - waited);
+					}
+				}
+			}
+			if (paused == true)
+			{
+				wait = this->_confg_interval + 1;
+			}
+			if (((elapsed > this->_confg_interval || settled == true) && paused == false) || syncnow == true)
 			{
 				// ʱ
 				clock_nptr->end();
 				clock_nptr->start();
+				firstseen = 0;
+				wait = this->_confg_interval + 1;
 
 				// Call  _kernel_once_gotosync()
 				bool syncresl = this->_kernel_once_gotosync();
 
+				// Status, and the synchronizations asked for until now are done
+				{
+					std::lock_guard<std::mutex> lock(this->_worker_mutex);
+					this->_status_phase = AFSYNC_PHASE_IDLE;
+					this->_status_succeeded = syncresl;
+					++this->_status_synced;
+					this->_worker_syncs_done = asked;
+					this->_worker_cv.notify_all();
+				}
+
 				// Verbosity - sync result print
 				if (this->_confg_verbosity >= 1)
 				{
@@ -645,6 +1882,37 @@ namespace AutoFileSync
 					{
 						std::cout << curtime() << " : " << "A new synchonization successfully created!";
 						std::cout << ", " << this->different_count << " files are updated!" << std::endl;
+
+						// Paths the snapshot files took
+						std::cout << curtime() << " : " << "Snapshot files";
+						if (this->linked_count > 0)
+						{
+							std::cout << ", hardlink " << this->linked_count;
+						}
+						for (int path = AFSYNC_COPY_REFLINK; path < AFSYNC_COPY_PATHS; ++path)
+						{
+							if (this->copied_count[path] > 0)
+							{
+								std::cout << ", " << copy_name((AutoFileSyncCopyPath)path) << " " << this->copied_count[path];
+							}
+						}
+						if (this->copied_count[AFSYNC_COPY_FAILED] > 0)
+						{
+							std::cout << ", failed " << this->copied_count[AFSYNC_COPY_FAILED];
+						}
+						if (this->mirrored_count > 0)
+						{
+							std::cout << ", mirrored " << this->mirrored_count;
+						}
+						if (this->store != nullptr)
+						{
+							std::cout << ", chunked " << this->chunked_count << " (" << this->chunked_bytes << " new bytes)";
+							if (this->chunked_failed > 0)
+							{
+								std::cout << ", failed " << this->chunked_failed;
+							}
+						}
+						std::cout << std::endl;
 					}
 					else if (syncresl == true && diffcnt == 0)
 					{
@@ -661,34 +1929,27 @@ namespace AutoFileSync
 				{
 					const std::string spaces = "      ";
 					
-					this->map_mutex.lock_shared();
-
-					// Copy of Last - monitored files (fullpath) and hashes
-					std::unordered_map<std::string, unsigned long long> lm = this->last_monitored;
-					// Copy of Current - mointored files (fullpath) and hashes
-					std::unordered_map<std::string, unsigned long long> cm = this->current_monitored;
-
-					this->map_mutex.unlock_shared();
-
 					// Print file existance and crcs
-					for (const auto& it : cm)
+					this->map_mutex.lock_shared();
+					for (unsigned int id : this->_file_tochk)
 					{
-						// Variable preps
-						const std::string& filepath = it.first;
-						const unsigned long long cur_hash = it.second;
-						const bool fileexistance = lm.find(filepath) != lm.end();
-						const unsigned long long las_hash = (fileexistance ? lm[filepath] : 0);
+						if (this->last_monitored.has(id) == false)
+						{
+							continue;
+						}
 
 						// Print
-						if (fileexistance == true)
+						const std::string filepath = this->_kernel_fullpath(id);
+						if (this->changed_monitored[id] == 0)
 						{
 							std::cout << spaces << "An existing file " << filepath << std::endl;
 						}
 						else
 						{
-							std::cout << spaces << "An updated file  " << filepath << " : current hash " << cur_hash << std::endl;
+							std::cout << spaces << "An updated file  " << filepath << " : current hash " << this->last_monitored.get(id).hash.hex() << std::endl;
 						}
 					}
+					this->map_mutex.unlock_shared();
 				}
 
 				// Verbosity - endl print
@@ -698,8 +1959,17 @@ namespace AutoFileSync
 				}
 			}
 
-			// 
-			Sleep(this->_settings_sleepinterval);
+			// , until due or woken up (stop, synchronize now, or an event unless settling)
+			{
+				std::unique_lock<std::mutex> lock(this->_worker_mutex);
+				this->_worker_listening = (paused == false && (touched == false || settled == true));
+				this->_worker_cv.wait_for(lock, std::chrono::milliseconds(std::max(wait, 1LL)), [&]()
+					{
+						return this->_worker_control_tostop == true || this->_worker_control_syncnow == true || this->_worker_woken == true
+							|| (this->_worker_listening == true && watcher_nptr != nullptr && watcher_nptr->pending() == true);
+					});
+				this->_worker_woken = false;
+			}
 		}
 
 		// ʱ
@@ -713,8 +1983,24 @@ namespace AutoFileSync
 		}
 
 		// Send stop working feedback
-		this->_worker_feedback_stopped = true;
+		{
+			std::lock_guard<std::mutex> lock(this->_worker_mutex);
+			this->_worker_feedback_stopped = true;
+			this->_worker_cv.notify_all();
+		}
+
+		return;
+	}
 
+	// Kernel - Once, wake the working thread up (for an event, only if it listens to them)
+	void AutoFileSynchonizor::_kernel_once_wakeup(bool event) noexcept
+	{
+		std::lock_guard<std::mutex> lock(this->_worker_mutex);
+		if (event == false || this->_worker_listening == true)
+		{
+			this->_worker_woken = true;
+			this->_worker_cv.notify_all();
+		}
 		return;
 	}
 
@@ -740,6 +2026,40 @@ namespace AutoFileSync
 		// Refresh variables
 		this->_worker_control_tostop = false;
 		this->_worker_feedback_stopped = false;
+		this->_worker_control_syncnow = false;
+		this->_worker_control_paused = false;
+		this->_status_synced = 0;
+		this->_worker_woken = false;
+		this->_worker_listening = true;
+
+		// Start the watcher if wanted, falling back to polling if no backend works
+		if (this->_confg_watch == true && this->watcher == nullptr)
+		{
+			AutoFileSyncWatcher* watcher_nptr = new AutoFileSyncWatcher(this->_src, this->_src_has_subfolders);
+			watcher_nptr->onevent([this]() { this->_kernel_once_wakeup(true); });
+			if (watcher_nptr->start() == true)
+			{
+				this->watcher = watcher_nptr;
+			}
+			else
+			{
+				delete watcher_nptr;
+			}
+		}
+
+		// Open the chunk store if wanted, falling back to full snapshots if it cannot be used
+		if (this->_confg_store == true && this->store == nullptr)
+		{
+			AutoFileSyncChunkStore* store_nptr = new AutoFileSyncChunkStore(this->_store);
+			if (store_nptr->valid() == true)
+			{
+				this->store = store_nptr;
+			}
+			else
+			{
+				delete store_nptr;
+			}
+		}
 
 		// Start the new thread
 		auto __ = [this]() -> void
@@ -772,23 +2092,283 @@ namespace AutoFileSync
 			return false;
 		}
 
-		// Sending the stop signal
-		this->_worker_control_tostop = true;
-
-		// Wait until stop
-		while (this->_worker_feedback_stopped == false)
+		// Sending the stop signal, and wait until stop
 		{
-			// 
-			Sleep(this->_settings_sleepinterval);
+			std::unique_lock<std::mutex> lock(this->_worker_mutex);
+			this->_worker_control_tostop = true;
+			this->_worker_cv.notify_all();
+			this->_worker_cv.wait(lock, [this]() { return this->_worker_feedback_stopped == true; });
 		}
 
 		// Release the resources of the worker thread
 		delete this->_worker;
 		this->_worker = nullptr;
 
+		// Stop the watcher
+		if (this->watcher != nullptr)
+		{
+			AutoFileSyncWatcher* watcher_nptr = _afsync_util_watcher_ptr(watcher);
+			delete watcher_nptr;
+			watcher_nptr = nullptr;
+			watcher = nullptr;
+		}
+
+		return true;
+	}
+
+	// API - Once, set incremental snapshots (before starting)
+	bool AutoFileSynchonizor::api_set_incremental(bool incremental) noexcept
+	{
+		if (this->_worker != nullptr)
+		{
+			return false;
+		}
+
+		this->_confg_incremental = incremental;
+		return true;
+	}
+
+	// API - Once, set full crc verification every N checks, 0 for never (before starting)
+	bool AutoFileSynchonizor::api_set_verification(long long every) noexcept
+	{
+		if (this->_worker != nullptr || every < 0)
+		{
+			return false;
+		}
+
+		this->_confg_verify = every;
+		this->_verify_checks = 0;
+		return true;
+	}
+
+	// API - Once, set event-driven change detection, polling if unavailable (before starting)
+	bool AutoFileSynchonizor::api_set_watching(bool watching) noexcept
+	{
+		if (this->_worker != nullptr)
+		{
+			return false;
+		}
+
+		this->_confg_watch = watching;
+		return true;
+	}
+
+	// API - Once, set the hash algorithm ("crc64", "xxh3", "blake3", "sha256") (before starting)
+	bool AutoFileSynchonizor::api_set_hash(const std::string& algo) noexcept
+	{
+		AutoFileSyncHashAlgo parsed = hash_parse(algo);
+		if (this->_worker != nullptr || hash_available(parsed) == false)
+		{
+			return false;
+		}
+
+		this->_confg_hash = parsed;
+		return true;
+	}
+
+	// API - Once, set reads in flight while hashing, for the device holding path or by default if "" (before starting)
+	bool AutoFileSynchonizor::api_set_readahead(long long depth, const std::string& path) noexcept
+	{
+		if (this->_worker != nullptr || depth < 1)
+		{
+			return false;
+		}
+
+		if (path == "")
+		{
+			this->_confg_readahead = depth;
+			return true;
+		}
+
+		unsigned long long dev = 0;
+		if (filedevice(path, dev) == false)
+		{
+			return false;
+		}
+		this->_confg_readahead_devices[dev] = depth;
+		return true;
+	}
+
+	// API - Once, set io_uring threads hashing in batches, 0 for off, false if unavailable (before starting)
+	bool AutoFileSynchonizor::api_set_uring(long long threads) noexcept
+	{
+		if (this->_worker != nullptr || threads < 0 || (threads > 0 && uring_available() == false))
+		{
+			return false;
+		}
+
+		this->_confg_uring = threads;
 		return true;
 	}
 
+	// API - Once, set copies writing to the same device at once, 0 for no cap (before starting)
+	bool AutoFileSynchonizor::api_set_copy_writes(long long writes) noexcept
+	{
+		if (this->_worker != nullptr || writes < 0)
+		{
+			return false;
+		}
+
+		this->_confg_copy_writes = writes;
+		return true;
+	}
+
+	// API - Once, set delta snapshots of files from minsize bytes, 0 for off (before starting)
+	bool AutoFileSynchonizor::api_set_delta(long long minsize) noexcept
+	{
+		if (this->_worker != nullptr || minsize < 0)
+		{
+			return false;
+		}
+
+		this->_confg_delta = minsize;
+		return true;
+	}
+
+	// API - Once, set snapshots as manifests of deduplicated chunks, full snapshots if unavailable (before starting)
+	bool AutoFileSynchonizor::api_set_store(bool store) noexcept
+	{
+		if (this->_worker != nullptr)
+		{
+			return false;
+		}
+
+		this->_confg_store = store;
+		return true;
+	}
+
+	// API - Once, set compressed snapshots with a codec ("zstd", "lz4", "none") and its level, false if unavailable (before starting)
+	bool AutoFileSynchonizor::api_set_compression(const std::string& codec, long long level) noexcept
+	{
+		AutoFileSyncCodec parsed = codec_parse(codec);
+		if (this->_worker != nullptr || (parsed == AFSYNC_CODEC_NONE && codec != "none") ||
+			(parsed != AFSYNC_CODEC_NONE && codec_available(parsed) == false))
+		{
+			return false;
+		}
+
+		this->_confg_codec = parsed;
+		this->_confg_codec_level = level;
+		return true;
+	}
+
+	// API - Once, set whether changed files are copied while hashed, read once for the check and the snapshot (before starting)
+	bool AutoFileSynchonizor::api_set_staging(bool staging) noexcept
+	{
+		if (this->_worker != nullptr)
+		{
+			return false;
+		}
+
+		this->_confg_stage = staging;
+		return true;
+	}
+
+	// API - Once, set the snapshot of watched changes after settle ms without events, no later than maxlatency ms after the first change (before starting)
+	bool AutoFileSynchonizor::api_set_settle(long long settle, long long maxlatency) noexcept
+	{
+		if (this->_worker != nullptr || settle < 0 || maxlatency < 0)
+		{
+			return false;
+		}
+
+		this->_confg_settle = settle;
+		this->_confg_max_latency = maxlatency;
+		return true;
+	}
+
+	// API - Once, add a mirror destination given every snapshot folder as well, false if it cannot be made (before starting)
+	// Note changed files are read once for all destinations, and manifest snapshots are not mirrored
+	bool AutoFileSynchonizor::api_add_mirror(const std::string& dest) noexcept
+	{
+		if (this->_worker != nullptr)
+		{
+			return false;
+		}
+
+		// Neither the dest itself nor a mirror already added
+		std::string mirror = abspath(dest);
+		std::replace(mirror.begin(), mirror.end(), '\\', '/');
+		while (mirror.size() > 1 && mirror.back() == '/')
+		{
+			mirror.pop_back();
+		}
+		std::string root = abspath(this->_dest);
+		std::replace(root.begin(), root.end(), '\\', '/');
+		while (root.size() > 1 && root.back() == '/')
+		{
+			root.pop_back();
+		}
+		if (dest == "" || mirror == root ||
+			std::find(this->_dest_mirrors.begin(), this->_dest_mirrors.end(), mirror) != this->_dest_mirrors.end())
+		{
+			return false;
+		}
+		if (direxist(mirror) == false && makedirs(mirror) == false)
+		{
+			return false;
+		}
+
+		this->_dest_mirrors.push_back(mirror);
+		return true;
+	}
+
+	// API - Once, add an exclusion rule with the gitignore syntax, false if it holds none (before starting)
+	bool AutoFileSynchonizor::api_add_exclusion(const std::string& rule) noexcept
+	{
+		if (this->_worker != nullptr)
+		{
+			return false;
+		}
+
+		return this->_src_excluder.add(rule);
+	}
+
+	// API - Once, add the exclusion rules of a file with the gitignore syntax, false if unreadable (before starting)
+	bool AutoFileSynchonizor::api_load_exclusions(const std::string& path) noexcept
+	{
+		if (this->_worker != nullptr)
+		{
+			return false;
+		}
+
+		return this->_src_excluder.load(path);
+	}
+
+	// API - Once, restore a manifest snapshot (or the codec manifest of a compressed snapshot) into a folder, false if any file failed
+	// Note it can run while working, the chunk store is shared with the synchronizor
+	bool AutoFileSynchonizor::api_restore(const std::string& manifest, const std::string& target) noexcept
+	{
+		if (this->_valid == false)
+		{
+			return false;
+		}
+
+		// A compressed snapshot, its folder is next to its codec manifest
+		std::vector<AutoFileSyncCompressedFile> compressed;
+		if (manifest.ends_with(".afscodecs") == true && read_codecs(manifest, compressed) == true)
+		{
+			if (direxist(target) == false && makedirs(target) == false)
+			{
+				return false;
+			}
+			return restore_compressed(manifest.substr(0, manifest.size() - strlen(".afscodecs")), compressed, target,
+				*_afsync_util_buffers_ptr(this->buffers));
+		}
+
+		std::vector<AutoFileSyncManifestFile> files;
+		if (read_manifest(manifest, files) == false || (direxist(target) == false && makedirs(target) == false))
+		{
+			return false;
+		}
+		if (this->store != nullptr)
+		{
+			return _afsync_util_store_ptr(store)->restore(files, target);
+		}
+		AutoFileSyncChunkStore store_local(this->_store);
+		return store_local.restore(files, target);
+	}
+
 	// API - Once, start monitoring (on the working thread)
 	bool AutoFileSynchonizor::api_start_working() noexcept
 	{
@@ -801,5 +2381,59 @@ namespace AutoFileSync
 		return this->_kernel_once_stopworking();
 	}
 
+	// API - Once, synchronize at once (while working), false if not working
+	// Note if wait, returns when it is done, whether it succeeded (false if stopped meanwhile)
+	bool AutoFileSynchonizor::api_sync_now(bool wait) noexcept
+	{
+		if (this->_worker_feedback_stopped == true)
+		{
+			return false;
+		}
+		unsigned long long asked = ++this->_worker_syncs_asked;
+		this->_worker_control_syncnow = true;
+		this->_kernel_once_wakeup(false);
+		if (wait == false)
+		{
+			return true;
+		}
+
+		std::unique_lock<std::mutex> lock(this->_worker_mutex);
+		this->_worker_cv.wait(lock, [this, asked]()
+			{
+				return this->_worker_syncs_done >= asked || this->_worker_feedback_stopped == true;
+			});
+		return this->_worker_syncs_done >= asked && this->_status_succeeded == true;
+	}
+
+	// API - Once, hold (or resume) the synchronizations of the interval and of the watcher, api_sync_now still runs, false if not working
+	bool AutoFileSynchonizor::api_pause(bool paused) noexcept
+	{
+		if (this->_worker_feedback_stopped == true)
+		{
+			return false;
+		}
+		this->_worker_control_paused = paused;
+		this->_kernel_once_wakeup(false);
+		return true;
+	}
+
+	// API - Once, status of the synchronizor, read without waiting for the working threads
+	AutoFileSyncStatus AutoFileSynchonizor::api_status() const noexcept
+	{
+		AutoFileSyncStatus status;
+		status.working = (this->_worker_feedback_stopped == false);
+		status.paused = this->_worker_control_paused;
+		status.phase = (AutoFileSyncPhase)this->_status_phase.load();
+		status.files = this->_status_files;
+		status.checked = this->_status_checked;
+		status.hashed = this->_status_hashed;
+		status.copies = this->_status_copies;
+		status.copied = this->_status_copied;
+		status.bytes = this->_status_bytes;
+		status.synced = this->_status_synced;
+		status.succeeded = this->_status_succeeded;
+		return status;
+	}
+
 }
 // Namespace AutoFileSync ends
@@ -5,13 +5,26 @@
 // Opensourced with Apache 2.0 License
 //
 
+#include <atomic>
 #include <string>
 #include <vector>
 #include <thread>
+#include <mutex>
 #include <shared_mutex>
+#include <condition_variable>
 #include <unordered_set>
 #include <unordered_map>
 
+#include "AutoFileSyncChunks.hpp"
+#include "AutoFileSyncCompressor.hpp"
+#include "AutoFileSyncCopier.hpp"
+#include "AutoFileSyncExcluder.hpp"
+#include "AutoFileSyncFilestat.hpp"
+#include "AutoFileSyncPool.hpp"
+#include "AutoFileSyncScheduler.hpp"
+#include "AutoFileSyncTable.hpp"
+#include "AutoFileSyncUring.hpp"
+
 #pragma once
 
 #pragma warning (disable: 4018)
@@ -53,6 +66,54 @@
 // Namespace AutoFileSync starts
 namespace AutoFileSync
 {
+	// Phases of a synchronization
+	enum AutoFileSyncPhase : unsigned char
+	{
+		AFSYNC_PHASE_IDLE = 0,       // waiting for the next one
+		AFSYNC_PHASE_SCANNING = 1,   // listing the files of the src
+		AFSYNC_PHASE_HASHING = 2,    // checking the files, hashing those that may have changed
+		AFSYNC_PHASE_COPYING = 3,    // materializing the snapshot files (and the mirrors)
+		AFSYNC_PHASE_STORING = 4,    // chunking the changed files into the chunk store
+	};
+
+	// Phase name
+	const char* phase_name(AutoFileSyncPhase phase) noexcept;
+
+	// struct AutoFileSyncStatus
+	// Status of a synchronizor, and the progress of the synchronization running (or of the last one)
+	struct AutoFileSyncStatus
+	{
+		bool working = false;
+		bool paused = false;
+		AutoFileSyncPhase phase = AFSYNC_PHASE_IDLE;
+		long long files = 0;                     // files to check
+		long long checked = 0;                   // files checked
+		long long hashed = 0;                    // files whose contents were hashed
+		long long copies = 0;                    // snapshot files to write (or to chunk)
+		long long copied = 0;                    // snapshot files written
+		unsigned long long bytes = 0;            // bytes written (new bytes of the chunk store)
+		long long synced = 0;                    // synchronizations done since starting
+		bool succeeded = false;                  // whether the last one succeeded
+	};
+
+	// struct AutoFileSyncCopyTask
+	// A snapshot file to materialize, hard-linked from origin if set (copied if that fails)
+	struct AutoFileSyncCopyTask
+	{
+		std::string from = "";
+		std::string to = "";
+		std::string origin = "";
+		unsigned long long size = 0;
+		unsigned long long dev = 0;
+		std::string base = "";                   // last version to patch with delta (copied whole if that fails)
+		const AutoFileSyncDelta* delta = nullptr;
+		unsigned char codec = AFSYNC_CODEC_NONE;  // codec to compress with, then the codec written
+		const AutoFileSyncCompressedFile* origincodec = nullptr; // origin if compressed in the last snapshot
+		std::string staged = "";                 // copy made while hashing, moved in place (copied if that fails)
+		unsigned int id = AutoFileSyncPaths::npos; // path id of the file, npos if not checked
+		bool failed = false;                     // not materialized, the target removed
+	};
+
 	// class AutoFileSynchonizor
 	// Զжָļнб
 	// ݣÿһʱ䣬
@@ -66,46 +127,150 @@ namespace AutoFileSync
 	private:
 		// Srouce to be mointored
 		std::string _src = "";
+		// Prefix of the monitored files (src with forward slashes, ending with one)
+		std::string _src_prefix = "";
 		// Including subfolders
 		bool _src_has_subfolders = false;
 		// Excluding subfolder names
 		std::vector<std::string> _src_except_subfolders;
-		std::unordered_set<std::string> _src_set_except_subfolders;
+		// Exclusion rules (gitignore syntax), the subfolder names above included
+		AutoFileSyncExcluder _src_excluder;
 
 	private:
 		// Destination to copy
 		std::string _dest = "";
 
-		// Files to check crc
-		std::vector<std::string> _file_tochk;
+		// Mirror destinations (fullpath), given every snapshot folder as well from the same reads of the src
+		std::vector<std::string> _dest_mirrors;
+
+		// Files to check crc (path ids)
+		std::vector<unsigned int> _file_tochk;
+
+		// Files of them left to hash once the walk is done (path ids), new ones and those not checked while walking
+		std::vector<unsigned int> _file_tohash;
 
 		// File and subfolder names to copy
 		std::vector<std::string> _file_sub_tocopy;
 
+		// Last snapshot folder created (fullpath), the base of incremental snapshots, or the last manifest
+		std::string _last_snapshot = "";
+
+		// Chunk store folder of the src kept in the dest (fullpath)
+		std::string _store = "";
+
+		// Staging folder of the src kept in the dest (fullpath), changed files copied while hashed
+		std::string _stage = "";
+
 	private:
 		// Different crc count
 		long long different_count = 0;
 		// Accessory shared_mutex (shared_lock for readers and unique_lock for writers)
 		std::shared_mutex map_mutex;
-		// Last - monitored files (fullpath) and hashes
-		std::unordered_map<std::string, unsigned long long> last_monitored;
-		// Current - mointored files (fullpath) and hashes
-		std::unordered_map<std::string, unsigned long long> current_monitored;
+		// Paths - monitored files (relative to the src) interned to dense ids, shared by both generations
+		AutoFileSyncPaths monitored_paths;
+		// Last - monitored files (path ids) and records (hashes and stat tuples), swapped with current after a check
+		AutoFileSyncFileTable last_monitored;
+		// Current - mointored files (path ids) and records (hashes and stat tuples)
+		AutoFileSyncFileTable current_monitored;
+		// Changed - files (1 by path id) found new or modified in the current check
+		std::vector<unsigned char> changed_monitored;
+		// Staged - files (1 by path id) changed and copied to the staging folder while hashed in the current check
+		std::vector<unsigned char> staged_monitored;
+		// Dirty - files (1 by path id) whose records changed in the current check, and deleted ones (path ids)
+		std::vector<unsigned char> dirty_monitored;
+		std::vector<unsigned int> deleted_monitored;
+		// Delta - changed blocks of large files (path ids) found modified in the current check
+		std::unordered_map<unsigned int, AutoFileSyncDelta> delta_monitored;
+		// Watched - files (fullpath, forward slashes) touched since the last check, whether to trust them,
+		// and whether they were taken by a check rolled back (then lost for the next one)
+		std::unordered_set<std::string> watched_dirty;
+		bool _watched = false;
+		bool _watched_lost = false;
+		// Manifest - files (relative path) of the last manifest snapshot and their chunks
+		std::unordered_map<std::string, AutoFileSyncManifestFile> last_manifest;
 		// Note: unordered_map is NOT thread-safe, so use a mutex to avoid concurrency errors
+		// Note: checking threads only read last_monitored and write the slots of their own path ids
+		// (delta_monitored, written for large files only, still takes the mutex)
+
+		// Snapshot files hard-linked and copied through each copy path, and mirror files written, in the last synchronization
+		std::atomic<long long> linked_count = 0;
+		std::atomic<long long> copied_count[AFSYNC_COPY_PATHS] = {};
+		std::atomic<long long> mirrored_count = 0;
+
+		// Snapshot files chunked (and failed), and bytes of new chunks, in the last synchronization
+		std::atomic<long long> chunked_count = 0;
+		std::atomic<long long> chunked_failed = 0;
+		std::atomic<unsigned long long> chunked_bytes = 0;
+
+		// Status, read by other threads while working (see api_status)
+		std::atomic<unsigned char> _status_phase = AFSYNC_PHASE_IDLE;
+		std::atomic<long long> _status_files = 0;
+		std::atomic<long long> _status_checked = 0;
+		std::atomic<long long> _status_hashed = 0;
+		std::atomic<long long> _status_copies = 0;
+		std::atomic<long long> _status_copied = 0;
+		std::atomic<unsigned long long> _status_bytes = 0;
+		std::atomic<long long> _status_synced = 0;
+		std::atomic<bool> _status_succeeded = false;
 
 	private:
 		// Crc-checking threadpool ptr
 		void* chck = nullptr;
+		// Crc-checking I/O buffer pool ptr (one buffer per checking thread)
+		void* buffers = nullptr;
 		// Synchonizor threadpool ptr
 		void* sync = nullptr;
+		// Resources of a daemon shared with other synchronizors, used instead of the three above (not owned),
+		// and the lane of this one in each of its pools
+		AutoFileSyncShared* _shared = nullptr;
+		size_t _shared_chck_lane = 0;
+		size_t _shared_sync_lane = 0;
+		// Persistent index ptr
+		void* index = nullptr;
+		// Watcher ptr (event-driven change detection), nullptr when polling
+		void* watcher = nullptr;
+		// Chunk store ptr (deduplicated snapshots), nullptr when copying
+		void* store = nullptr;
 
 	private:
 		// Configurations
 		long long _confg_verbosity = 2;             // ӡϵͳ־0,1,2
 		long long _confg_interval = 5 * 60 * 1000;  // ͬļʱ
+		long long _confg_cores = 20;                // threads of each threadpool
+		bool _confg_incremental = false;            // hard-link unchanged files from the last snapshot
+		long long _confg_verify = 0;                // full crc verification every N checks, 0 for never
+		bool _confg_watch = false;                  // watch file system events instead of only polling
+		AutoFileSyncHashAlgo _confg_hash = AFSYNC_HASH_CRC64; // hash algorithm of new digests
+		long long _confg_readahead = 2;             // reads in flight while hashing a large file
+		std::unordered_map<unsigned long long, long long> _confg_readahead_devices; // the same, per device
+		long long _confg_uring = 0;                 // io_uring threads hashing in batches (linux), 0 for off
+		long long _confg_copy_writes = 0;           // copies writing to the same device at once, 0 for no cap
+		long long _confg_delta = 0;                 // files from this size get block sums for delta snapshots, 0 for off
+		bool _confg_store = false;                  // snapshots as manifests of deduplicated chunks
+		AutoFileSyncCodec _confg_codec = AFSYNC_CODEC_NONE; // codec of compressed snapshots, none for raw copies
+		long long _confg_codec_level = 0;           // its level, 0 for the default of the codec
+		bool _confg_stage = false;                  // changed files copied while hashed, read once for both
+		long long _confg_settle = 0;                // ms without events after a change before its snapshot (watching), 0 for at once
+		long long _confg_max_latency = 0;           // ms from a change to its snapshot at most while settling, 0 for no cap
 
 		// Default settings
-		long long _settings_sleepinterval = 200;    // ߳߼ʱ
+		unsigned int _settings_delta_blocksize = 1024 * 1024; // block size of delta snapshots
+		long long _settings_batch_files = 64;       // files coalesced into a hashing batch at most
+		long long _settings_batch_bytes = 8 * 1024 * 1024; // bytes (estimated) of a hashing batch at most
+		long long _settings_batch_overhead = 64 * 1024; // estimated cost of opening a file, in bytes
+		long long _settings_split_bytes = 256 * 1024 * 1024; // files from this size are hashed in ranges by idle workers
+		long long _settings_split_range = 32 * 1024 * 1024; // bytes of such a range
+		long long _settings_compress_threads = 4;   // threads compressing the blocks of a snapshot file
+		long long _settings_fanout_writers = 2;     // writers of each destination while copying to mirrors
+		long long _settings_fanout_budget = 64 * 1024 * 1024; // bytes queued to a destination before it is left behind
+		long long _settings_shared_scanners = 2;    // threads scanning the src when sharing the pools of a daemon
+
+		// Full verification pass (checks since the last one, and whether the current check is one)
+		long long _verify_checks = 0;
+		bool _verifying = false;
+
+		// Scheduler of the hashing pass running, whose idle workers help with huge files (nullptr between passes)
+		AutoFileSyncScheduler* _scheduler = nullptr;
 
 		// Validity
 		bool _valid = false;
@@ -117,8 +282,20 @@ namespace AutoFileSync
 		void* clock = nullptr;
 
 		// Working Stop signal
-		bool _worker_control_tostop = false;   // send stop signal
-		bool _worker_feedback_stopped = false; // the thread has stopped
+		std::atomic<bool> _worker_control_tostop = false;   // send stop signal
+		std::atomic<bool> _worker_feedback_stopped = true;  // the thread has stopped (or not started)
+		std::atomic<bool> _worker_control_syncnow = false;  // send synchronize-now signal
+		std::atomic<bool> _worker_control_paused = false;   // send pause signal, automatic synchronizations held
+
+		// Synchronizations asked for (api_sync_now) and done, the latter under the mutex below
+		std::atomic<unsigned long long> _worker_syncs_asked = 0;
+		unsigned long long _worker_syncs_done = 0;
+
+		// Working wakeup, by the signals above and by the events of the watcher (while listening to them)
+		std::mutex _worker_mutex;
+		std::condition_variable _worker_cv;
+		bool _worker_woken = false;
+		bool _worker_listening = true;
 
 	public:
 		// Constructor
@@ -126,6 +303,11 @@ namespace AutoFileSync
 			bool has_subfolders = false, const std::vector<std::string>& excluded_subfolders = {},
 			long long interval = 5 * 60 * 1000, long long verbosity = 2, int cores = 20) noexcept;
 
+		// Constructor, sharing the pools and device caps of a daemon with its other synchronizors (jobs)
+		AutoFileSynchonizor(const std::string& src, const std::string& dest, AutoFileSyncShared& shared,
+			bool has_subfolders = false, const std::vector<std::string>& excluded_subfolders = {},
+			long long interval = 5 * 60 * 1000, long long verbosity = 2) noexcept;
+
 		// Destructor
 		~AutoFileSynchonizor() noexcept;
 
@@ -141,18 +323,79 @@ namespace AutoFileSync
 		bool valid() const noexcept;
 
 	private:
-		// Kernel - Once, update file info
-		bool _kernel_once_updfileinfo() noexcept;
+		// Kernel - Once, set up everything but the threadpools (called by the constructors)
+		void _kernel_once_construct(const std::string& src, const std::string& dest,
+			bool has_subfolders, const std::vector<std::string>& excluded_subfolders,
+			long long interval, long long verbosity, int cores) noexcept;
+
+		// Kernel - Run a task on the checking threadpool (or the synchronizor one), in the lane of this synchronizor if shared
+		void _kernel_invoke(bool checking, AutoFileSyncTask&& task) noexcept;
+
+		// Kernel - Fullpath of a monitored file (path id)
+		std::string _kernel_fullpath(unsigned int id) const noexcept;
+
+		// Kernel - Fullpath of the staged copy of a monitored file (path id)
+		std::string _kernel_stagepath(unsigned int id) const noexcept;
+
+		// Kernel - Once, update file info, checking the files of known paths (ids below known, with slots) as they are listed
+		bool _kernel_once_updfileinfo(size_t known) noexcept;
+
+		// Kernel - Thread, stat a given file (path id) and fetch its last record, true if its contents have to be hashed
+		bool _kernel_thread_statcrc(unsigned int id, const std::string& filepath, bool compare,
+			AutoFileSyncRecord& record, AutoFileSyncRecord& last_record, bool& last_existed);
+
+		// Kernel - Thread, register the record of a given file (path id) and compare it with the last one (write to its slots)
+		void _kernel_thread_registercrc(unsigned int id, bool compare,
+			const AutoFileSyncRecord& record, const AutoFileSyncRecord& last_record, bool last_existed);
+
+		// Kernel - Thread, whether a file stated by statcrc is copied to the staging folder while hashed
+		bool _kernel_thread_stagecrc(bool compare, const AutoFileSyncRecord& record,
+			const AutoFileSyncRecord& last_record, bool last_existed) const noexcept;
+
+		// Kernel - Thread, whether a file of a size is hashed in ranges by the workers of the hashing pass
+		bool _kernel_thread_splitcrc(unsigned long long size) const noexcept;
+
+		// Kernel - Thread, hash a given file (path id) stated by statcrc, then register it (write to its slots)
+		void _kernel_thread_hashcrc(unsigned int id, const std::string& filepath, bool compare,
+			AutoFileSyncRecord& record, const AutoFileSyncRecord& last_record, bool last_existed);
 
-		// Kernel - Thread, compute crc of a given file (write to map)
-		void _kernel_thread_computecrc(const std::string& filepath, bool compare = true);
+		// Kernel - Thread, compute crc of a given file (path id, and its fullpath) (write to its slots)
+		void _kernel_thread_computecrc(unsigned int id, const std::string& filepath, bool compare = true);
+
+		// Kernel - Thread, compute crc of files [begin, end) of _file_tohash in io_uring batches on the ring of a worker (write to their slots)
+		void _kernel_thread_computecrcs(size_t begin, size_t end, AutoFileSyncUring& ring, bool compare = true);
+
+		// Kernel - Once, compute crc of the files left to hash by the walk on the checking threadpool, then merge (write to map)
+		void _kernel_once_computeall(bool compare = true) noexcept;
+
+		// Kernel - Once, count the changes found by the checking threads, then swap the generations (write to map)
+		void _kernel_once_mergeall(bool compare) noexcept;
+
+		// Kernel - Once, swap the generations back once the snapshot of a check failed, so the next check finds its changes again
+		void _kernel_once_rollback() noexcept;
 
 		// Kernel - Once, checking synchronizable (called by gotosync)
 		bool _kernel_once_chksync() noexcept;
 
+		// Kernel - Once, persist the records of the last check to the index
+		bool _kernel_once_persist() noexcept;
+
+		// Kernel - Once, drop the staged copies not moved into a snapshot
+		void _kernel_once_unstage() noexcept;
+
+		// Kernel - Once, copy the scheduled snapshot files on the synchronizor threadpool, largest first,
+		// into the mirror roots given as well ("" for a mirror left out)
+		void _kernel_once_copyall(std::vector<AutoFileSyncCopyTask>& tasks, const std::vector<std::string>& mirrors) noexcept;
+
+		// Kernel - Once, chunk the checked files into the chunk store on the synchronizor threadpool, then write a manifest
+		bool _kernel_once_storeall(const std::string& manifest) noexcept;
+
 		// Kernel - Once, go to synchronize (calling check and maybe copy files)
 		bool _kernel_once_gotosync() noexcept;
 
+		// Kernel - Once, wake the working thread up (for an event, only if it listens to them)
+		void _kernel_once_wakeup(bool event) noexcept;
+
 		// Kernel - Thread, Loop, continuously monitoring (working thread)
 		void _kernel_thread_loop_workingthread() noexcept;
 
@@ -163,11 +406,70 @@ namespace AutoFileSync
 		bool _kernel_once_stopworking() noexcept;
 
 	public:
+		// API - Once, set incremental snapshots (before starting)
+		bool api_set_incremental(bool incremental) noexcept;
+
+		// API - Once, set full crc verification every N checks, 0 for never (before starting)
+		bool api_set_verification(long long every) noexcept;
+
+		// API - Once, set event-driven change detection, polling if unavailable (before starting)
+		bool api_set_watching(bool watching) noexcept;
+
+		// API - Once, set the hash algorithm ("crc64", "xxh3", "blake3", "sha256") (before starting)
+		bool api_set_hash(const std::string& algo) noexcept;
+
+		// API - Once, set reads in flight while hashing, for the device holding path or by default if "" (before starting)
+		bool api_set_readahead(long long depth, const std::string& path = "") noexcept;
+
+		// API - Once, set io_uring threads hashing in batches, 0 for off, false if unavailable (before starting)
+		bool api_set_uring(long long threads) noexcept;
+
+		// API - Once, set copies writing to the same device at once, 0 for no cap (before starting)
+		bool api_set_copy_writes(long long writes) noexcept;
+
+		// API - Once, set delta snapshots of files from minsize bytes, 0 for off (before starting)
+		bool api_set_delta(long long minsize) noexcept;
+
+		// API - Once, set snapshots as manifests of deduplicated chunks, full snapshots if unavailable (before starting)
+		bool api_set_store(bool store) noexcept;
+
+		// API - Once, set compressed snapshots with a codec ("zstd", "lz4", "none") and its level, false if unavailable (before starting)
+		bool api_set_compression(const std::string& codec, long long level = 0) noexcept;
+
+		// API - Once, set whether changed files are copied while hashed, read once for the check and the snapshot (before starting)
+		bool api_set_staging(bool staging) noexcept;
+
+		// API - Once, set the snapshot of watched changes after settle ms without events, no later than maxlatency ms after the first change (before starting)
+		bool api_set_settle(long long settle, long long maxlatency = 0) noexcept;
+
+		// API - Once, add a mirror destination given every snapshot folder as well, false if it cannot be made (before starting)
+		// Note changed files are read once for all destinations, and manifest snapshots are not mirrored
+		bool api_add_mirror(const std::string& dest) noexcept;
+
+		// API - Once, add an exclusion rule with the gitignore syntax, false if it holds none (before starting)
+		bool api_add_exclusion(const std::string& rule) noexcept;
+
+		// API - Once, add the exclusion rules of a file with the gitignore syntax, false if unreadable (before starting)
+		bool api_load_exclusions(const std::string& path) noexcept;
+
+		// API - Once, restore a manifest snapshot (or the codec manifest of a compressed snapshot) into a folder, false if any file failed
+		bool api_restore(const std::string& manifest, const std::string& target) noexcept;
+
 		// API - Once, start monitoring (on the working thread)
 		bool api_start_working() noexcept;
 
 		// API - Once, stop monitoring (on the working thread)
 		bool api_stop_working() noexcept;
+
+		// API - Once, synchronize at once (while working), false if not working
+		// Note if wait, returns when it is done, whether it succeeded (false if stopped meanwhile)
+		bool api_sync_now(bool wait = false) noexcept;
+
+		// API - Once, hold (or resume) the synchronizations of the interval and of the watcher, api_sync_now still runs, false if not working
+		bool api_pause(bool paused) noexcept;
+
+		// API - Once, status of the synchronizor, read without waiting for the working threads
+		AutoFileSyncStatus api_status() const noexcept;
 	};
 
 }